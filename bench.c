@@ -0,0 +1,437 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// nanosleep
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "myassert.h"
+#include "frame.h"
+
+#include "client_master.h"
+
+
+/************************************************************************
+ * Banc de mesure (make bench)
+ *
+ * Pour chaque taille N, le banc lance un master, y charge N éléments
+ * (insertmany, distribution et graine choisies, dans [0, RANGE_FACTOR*N[),
+ * relève la forme de l'arbre (nombre d'éléments distincts, profondeur)
+ * puis chronomètre chaque type d'ordre, répété dans autant de sessions
+ * (la latence est celle que voit un client : ouverture de la session,
+ * ordre, réponse, fermeture). Il arrête enfin le master.
+ *
+ * Une ligne CSV par (taille, ordre) : percentiles de latence et ordres par
+ * seconde. Le fichier est complété d'une exécution à l'autre (l'en-tête
+ * n'est écrit que s'il est vide) : l'étiquette (--label, la version par
+ * exemple) et les options du master (le moteur) distinguent les séries.
+ *
+ * Les éléments chargés sont ceux de
+ *     ./client insertmany N 0 <RANGE_FACTOR*N> <distribution> <graine>
+ ************************************************************************/
+
+#define MASTER          "./master"
+#define RANGE_FACTOR    10              // valeurs dans [0, RANGE_FACTOR * N[
+#define MAX_SIZES       16
+#define MAX_MASTER_ARGS 32
+#define START_TIMEOUT   10.0            // secondes pour que le master crée son tube
+
+#define DEFAULT_SIZES   "100,1000,10000,100000,1000000"
+#define DEFAULT_OPS     200
+#define DEFAULT_BUDGET  2.0
+#define DEFAULT_CSV     "bench.csv"
+
+#define CSV_HEADER "label,master_options,distribution,seed,size,distinct,depth,order," \
+                   "nb_ops,ops_per_s,p50_us,p90_us,p99_us,max_us\n"
+
+// ordres mesurés
+typedef enum
+{
+    BENCH_INSERT,
+    BENCH_EXIST,
+    BENCH_MINIMUM,
+    BENCH_MAXIMUM,
+    BENCH_SUM,
+    BENCH_HOW_MANY,
+    BENCH_PRINT,
+    BENCH_NB_ORDERS
+} BenchOrder;
+
+static const struct
+{
+    const char *name;
+    int order;
+} orders[BENCH_NB_ORDERS] =
+{
+    { "insert",  CM_ORDER_INSERT },
+    { "exist",   CM_ORDER_EXIST },
+    { "min",     CM_ORDER_MINIMUM },
+    { "max",     CM_ORDER_MAXIMUM },
+    { "sum",     CM_ORDER_SUM },
+    { "howmany", CM_ORDER_HOW_MANY },
+    { "print",   CM_ORDER_PRINT },
+};
+
+typedef struct
+{
+    int sizes[MAX_SIZES];
+    int nbSizes;
+    UtDistribution dist;
+    uint64_t seed;
+    int nbOps;              // répétitions de chaque ordre, au plus
+    double budget;          // secondes par ordre, au plus (au moins une répétition)
+    const char *csv;
+    const char *label;
+    char *masterArgs[MAX_MASTER_ARGS + 2];      // argv du master (NULL à la fin)
+    char masterOptions[1024];                   // les mêmes, pour le CSV
+} Bench;
+
+
+/************************************************************************
+ * Usage
+ ************************************************************************/
+static void usage(const char *exeName, const char *message)
+{
+    fprintf(stderr, "usage : %s [--sizes <n1,n2,...>] [--dist <distribution>] [--seed <graine>]\n"
+            "           [--ops <n>] [--budget <secondes>] [--csv <fichier>] [--label <texte>]\n"
+            "           [-- <options du master>]\n", exeName);
+    fprintf(stderr, "   --sizes : tailles chargées (défaut " DEFAULT_SIZES ")\n");
+    fprintf(stderr, "   --dist : uniform (défaut), zipf, normal, sorted, reverse ou few\n");
+    fprintf(stderr, "   --seed : graine des éléments chargés et des paramètres des ordres (défaut 1)\n");
+    fprintf(stderr, "   --ops, --budget : chaque ordre est répété <n> fois (défaut %d), dans la limite\n"
+            "                     de <secondes> (défaut %g)\n", DEFAULT_OPS, DEFAULT_BUDGET);
+    fprintf(stderr, "   --csv : fichier complété (défaut " DEFAULT_CSV ")\n");
+    fprintf(stderr, "   --label : première colonne du CSV (version, machine, ...)\n");
+    fprintf(stderr, "   après -- : options passées au master (--engine arena, --shards 0, ...)\n");
+    if (message != NULL)
+        fprintf(stderr, "message :\n    %s\n", message);
+    exit(EXIT_FAILURE);
+}
+
+static void parseArgs(int argc, char * argv[], Bench *bench)
+{
+    const char *sizes = DEFAULT_SIZES;
+    bench->dist = UT_UNIFORM;
+    bench->seed = 1;
+    bench->nbOps = DEFAULT_OPS;
+    bench->budget = DEFAULT_BUDGET;
+    bench->csv = DEFAULT_CSV;
+    bench->label = "";
+
+    int i = 1;
+    for (; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--") == 0)
+        {
+            i++;
+            break;
+        }
+        if (i + 1 >= argc)
+            usage(argv[0], "argument incorrect");
+        if (strcmp(argv[i], "--sizes") == 0)
+            sizes = argv[++i];
+        else if (strcmp(argv[i], "--dist") == 0)
+        {
+            int dist = ut_distributionFromName(argv[++i]);
+            if (dist < 0)
+                usage(argv[0], "distribution inconnue");
+            bench->dist = dist;
+        }
+        else if (strcmp(argv[i], "--seed") == 0)
+            bench->seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--ops") == 0)
+            bench->nbOps = strtol(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--budget") == 0)
+            bench->budget = strtod(argv[++i], NULL);
+        else if (strcmp(argv[i], "--csv") == 0)
+            bench->csv = argv[++i];
+        else if (strcmp(argv[i], "--label") == 0)
+            bench->label = argv[++i];
+        else
+            usage(argv[0], "argument incorrect");
+    }
+    if (bench->nbOps < 1)
+        usage(argv[0], "--ops doit être strictement positif");
+
+    // tailles
+    bench->nbSizes = 0;
+    for (const char *p = sizes; *p != '\0'; )
+    {
+        char *end;
+        long size = strtol(p, &end, 10);
+        if (end == p || size < 1 || size > 1000000000 / RANGE_FACTOR || bench->nbSizes == MAX_SIZES)
+            usage(argv[0], "--sizes : tailles incorrectes");
+        bench->sizes[bench->nbSizes++] = size;
+        p = (*end == ',') ? end + 1 : end;
+        if (*end != ',' && *end != '\0')
+            usage(argv[0], "--sizes : tailles séparées par des virgules");
+    }
+
+    // options du master
+    if (argc - i > MAX_MASTER_ARGS)
+        usage(argv[0], "trop d'options pour le master");
+    bench->masterArgs[0] = MASTER;
+    bench->masterOptions[0] = '\0';
+    int nb = 1;
+    for (; i < argc; i++, nb++)
+    {
+        bench->masterArgs[nb] = argv[i];
+        if (nb > 1)
+            strncat(bench->masterOptions, " ", sizeof(bench->masterOptions) - strlen(bench->masterOptions) - 1);
+        strncat(bench->masterOptions, argv[i], sizeof(bench->masterOptions) - strlen(bench->masterOptions) - 1);
+    }
+    bench->masterArgs[nb] = NULL;
+}
+
+
+/************************************************************************
+ * Master
+ ************************************************************************/
+// lancement du master (sorties jetées : print y affiche tout l'ensemble) ;
+// il est prêt quand son tube d'enregistrement existe
+static pid_t startMaster(const Bench *bench)
+{
+    struct stat st;
+    myassert(stat(REGISTRATION, &st) == -1, "un master tourne déjà dans ce répertoire");
+
+    pid_t pid = fork();
+    myassert(pid != -1, "Erreur");
+    if (pid == 0)
+    {
+        int null = open("/dev/null", O_WRONLY);
+        myassert(null != -1, "Erreur");
+        int ret = dup2(null, STDOUT_FILENO);
+        myassert(ret != -1, "Erreur");
+        ret = dup2(null, STDERR_FILENO);
+        myassert(ret != -1, "Erreur");
+        execv(MASTER, bench->masterArgs);
+        myassert(false, "exec " MASTER);
+    }
+
+    double start = ut_now();
+    while (stat(REGISTRATION, &st) == -1)
+    {
+        int status;
+        myassert(waitpid(pid, &status, WNOHANG) == 0, "le master s'est arrêté au démarrage");
+        myassert(ut_now() - start < START_TIMEOUT, "le master ne démarre pas");
+        struct timespec pause = { 0, 1000000 };
+        nanosleep(&pause, NULL);
+    }
+    return pid;
+}
+
+
+/************************************************************************
+ * Sessions
+ ************************************************************************/
+// une session par ordre, comme un client : l'ordre est tramé entre
+// beginSession et endSession, qui l'envoie et lit la réponse en entier
+typedef struct
+{
+    int clientToMaster;
+    int masterToClient;
+} Session;
+
+static void beginSession(Session *session)
+{
+    sessionOpen(&session->masterToClient, &session->clientToMaster);
+}
+
+// renvoie le code réponse ; les <nbAnswers> premiers entiers du corps
+// sont copiés dans <answers>
+static int endSession(Session *session, int *answers, int nbAnswers)
+{
+    fr_flush(session->clientToMaster);
+
+    FrameHeader header;
+    bool ok = fr_next(session->masterToClient, &header);
+    myassert(ok, "le master a fermé la session");
+    char *body = malloc(header.length + 1);
+    myassert(body != NULL, "Erreur");
+    fr_get(session->masterToClient, body, header.length);
+    if (header.length >= nbAnswers * (int) sizeof(int))
+        memcpy(answers, body, nbAnswers * sizeof(int));
+    free(body);
+
+    fr_close(session->clientToMaster);
+    fr_close(session->masterToClient);
+    return header.opcode;
+}
+
+// ordre sans paramètre
+static int simpleOrder(int order, int *answers, int nbAnswers)
+{
+    Session session;
+    beginSession(&session);
+    fr_begin(session.clientToMaster, order, 0);
+    fr_end(session.clientToMaster);
+    return endSession(&session, answers, nbAnswers);
+}
+
+// ordre avec un float (insert, exist)
+static int floatOrder(int order, float elt)
+{
+    Session session;
+    beginSession(&session);
+    fr_begin(session.clientToMaster, order, 0);
+    fr_putFloat(session.clientToMaster, elt);
+    fr_end(session.clientToMaster);
+    return endSession(&session, NULL, 0);
+}
+
+// chargement des éléments, comme le client (cf. client.c, sendData) : par
+// un segment partagé au-delà de PAYLOAD_THRESHOLD
+static void load(const Bench *bench, int size)
+{
+    UtRandom g;
+    ut_randomSeed(&g, bench->seed, 0);
+    float max = (float) size * RANGE_FACTOR;
+
+    Session session;
+    beginSession(&session);
+    size_t bytes = (size_t) size * sizeof(float);
+    bool payload = bytes >= PAYLOAD_THRESHOLD;
+    fr_begin(session.clientToMaster, payload ? CM_ORDER_INSERT_MANY_SHM : CM_ORDER_INSERT_MANY, 0);
+    fr_putInt(session.clientToMaster, size);
+    if (payload)
+    {
+        float *tab = payloadCreate(getpid(), bytes);
+        ut_fillDist(&g, bench->dist, tab, size, 0, max, 0);
+        payloadClose(tab, bytes);
+        fr_end(session.clientToMaster);
+    }
+    else
+    {
+        float *tab = ut_generateDist(&g, bench->dist, size, 0, max, 0);
+        fr_endLarge(session.clientToMaster, tab, bytes);
+        free(tab);
+    }
+    int ack = endSession(&session, NULL, 0);
+    myassert(ack == CM_ANSWER_INSERT_MANY_OK, "chargement refusé");
+    if (payload)
+        payloadDestroy(getpid());
+}
+
+
+/************************************************************************
+ * Mesures
+ ************************************************************************/
+static int cmpDouble(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// percentile <q> (rang le plus proche) de lat[0..nb[, trié
+static double percentile(const double *lat, int nb, double q)
+{
+    int rank = (int) ceil(q * nb);
+    return lat[(rank < 1) ? 0 : rank - 1];
+}
+
+// répétitions de l'ordre <o> ; les paramètres (insert, exist) suivent la
+// distribution du chargement, tirés d'un autre flux de la graine
+static void measure(const Bench *bench, int size, int distinct, int depth, BenchOrder o, FILE *csv)
+{
+    UtRandom g;
+    ut_randomSeed(&g, bench->seed, 1 + o);
+    float *params = ut_generateDist(&g, bench->dist, bench->nbOps, 0, (float) size * RANGE_FACTOR, 0);
+    double *lat = malloc(bench->nbOps * sizeof(double));
+    myassert(lat != NULL, "Erreur");
+
+    int nb = 0;
+    double start = ut_now();
+    double elapsed = 0;
+    while (nb < bench->nbOps && (nb == 0 || elapsed < bench->budget))
+    {
+        double before = ut_now();
+        if (o == BENCH_INSERT || o == BENCH_EXIST)
+            floatOrder(orders[o].order, params[nb]);
+        else
+            simpleOrder(orders[o].order, NULL, 0);
+        double after = ut_now();
+        lat[nb++] = (after - before) * 1e6;
+        elapsed = after - start;
+    }
+
+    qsort(lat, nb, sizeof(double), cmpDouble);
+    fprintf(csv, "\"%s\",\"%s\",%s,%llu,%d,%d,%d,%s,%d,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+            bench->label, bench->masterOptions, ut_distributionName(bench->dist),
+            (unsigned long long) bench->seed, size, distinct, depth, orders[o].name,
+            nb, nb / elapsed, percentile(lat, nb, 0.50), percentile(lat, nb, 0.90),
+            percentile(lat, nb, 0.99), lat[nb - 1]);
+    fflush(csv);
+    printf("  %-8s %6d ops, %10.1f ops/s, p50 %9.1f us, p99 %9.1f us\n", orders[o].name, nb,
+           nb / elapsed, percentile(lat, nb, 0.50), percentile(lat, nb, 0.99));
+
+    free(lat);
+    free(params);
+}
+
+static void runSize(const Bench *bench, int size, FILE *csv)
+{
+    pid_t master = startMaster(bench);
+
+    double start = ut_now();
+    load(bench, size);
+    double loadSeconds = ut_now() - start;
+
+    // forme de l'arbre après chargement (howmany : total puis distincts)
+    int howMany[2], depth;
+    int ack = simpleOrder(CM_ORDER_HOW_MANY, howMany, 2);
+    myassert(ack == CM_ANSWER_HOW_MANY_OK, "howmany");
+    int distinct = howMany[1];
+    ack = simpleOrder(CM_ORDER_DEPTH, &depth, 1);
+    myassert(ack == CM_ANSWER_DEPTH_OK, "depth");
+
+    printf("N = %d (%s) : chargé en %.3f s, %d distincts, profondeur %d\n", size,
+           ut_distributionName(bench->dist), loadSeconds, distinct, depth);
+    for (int o = 0; o < BENCH_NB_ORDERS; o++)
+        measure(bench, size, distinct, depth, o, csv);
+
+    ack = simpleOrder(CM_ORDER_STOP, NULL, 0);
+    myassert(ack == CM_ANSWER_STOP_OK, "stop");
+    int status;
+    pid_t ret = waitpid(master, &status, 0);
+    myassert(ret == master, "Erreur");
+}
+
+
+/************************************************************************
+ * Fonction principale
+ ************************************************************************/
+int main(int argc, char * argv[])
+{
+    Bench bench;
+    parseArgs(argc, argv, &bench);
+
+    FILE *csv = fopen(bench.csv, "a");
+    myassert(csv != NULL, "ouverture du fichier CSV");
+    int ret = fseek(csv, 0, SEEK_END);
+    myassert(ret == 0, "Erreur");
+    if (ftell(csv) == 0)
+        fputs(CSV_HEADER, csv);
+
+    for (int i = 0; i < bench.nbSizes; i++)
+        runSize(&bench, bench.sizes[i], csv);
+
+    ret = fclose(csv);
+    myassert(ret == 0, "Erreur");
+    printf("résultats ajoutés à %s\n", bench.csv);
+
+    return EXIT_SUCCESS;
+}
@@ -4,11 +4,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
-#include <pthread.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/wait.h>
@@ -20,6 +21,9 @@
 
 #include "utils.h"
 #include "myassert.h"
+#include "frame.h"
+#include "count.h"
+#include "stats.h"
 
 #include "client_master.h"
 
@@ -37,6 +41,16 @@
 #define TK_INSERT_MANY "insertmany"       // insertions de plusieurs éléments aléatoires
 #define TK_PRINT       "print"            // debug : demande aux master/workers d'afficher les éléments
 #define TK_LOCAL       "local"            // lancer un calcul local (sans master) en multi-thread
+#define TK_LOCAL_STREAM "localstream"     // idem, éléments générés à la volée (sans tableau), graine fixée
+#define TK_DEPTH       "depth"            // profondeur de l'arbre (vérification de l'équilibrage)
+#define TK_RANGE       "range"            // nombre et somme des éléments d'un intervalle
+#define TK_KTH         "kth"              // k-ième plus petit élément
+#define TK_RANK        "rank"             // nombre d'éléments inférieurs à un élément
+#define TK_PERCENTILE  "percentile"       // percentile (50 : médiane)
+#define TK_EXPORT      "export"           // paires (élément, cardinalité) triées, affichées ou dans un fichier
+#define TK_SCAN        "scan"             // une page de paires triées à partir d'un élément
+#define TK_SNAPSHOT    "snapshot"         // écriture de l'ensemble dans un fichier (cf. master --load)
+#define TK_STATS       "stats"            // latences du master par type d'ordre
 
 
 /************************************************************************
@@ -56,11 +70,16 @@ typedef struct
 
     // infos pour le travail à faire (récupérées sur la ligne de commande)
     int order;     // ordre de l'utilisateur (cf. CM_ORDER_* dans client_master.h)
-    float elt;     // pour CM_ORDER_EXIST, CM_ORDER_INSERT, CM_ORDER_LOCAL
-    int nb;        // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL
-    float min;     // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL
-    float max;     // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL
-    int nbThreads; // pour CM_ORDER_LOCAL
+    float elt;     // pour CM_ORDER_EXIST, CM_ORDER_INSERT, CM_ORDER_LOCAL(_STREAM), CM_ORDER_RANK,
+                   // CM_ORDER_PERCENTILE, CM_ORDER_SCAN
+    int nb;        // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL, CM_ORDER_KTH, CM_ORDER_SCAN
+    long total;    // pour CM_ORDER_LOCAL_STREAM (rien n'est alloué : peut dépasser INT_MAX)
+    int dist;      // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL (cf. UtDistribution)
+    uint64_t seed; // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL(_STREAM)
+    float min;     // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL(_STREAM), CM_ORDER_RANGE
+    float max;     // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL(_STREAM), CM_ORDER_RANGE
+    int nbThreads; // pour CM_ORDER_LOCAL(_STREAM)
+    const char *file; // pour CM_ORDER_EXPORT (NULL : affichage), CM_ORDER_SNAPSHOT
 } Data;
 
 
@@ -84,13 +103,39 @@ static void usage(const char *exeName, const char *message)
     fprintf(stderr, "           somme des éléments de l'ensemble\n");
     fprintf(stderr, "   $ %s " TK_INSERT " <elt>\n", exeName);
     fprintf(stderr, "          ajout de l'élement <elt> dans l'ensemble\n");
-    fprintf(stderr, "   $ %s " TK_INSERT_MANY " <nb> <min> <max>\n", exeName);
+    fprintf(stderr, "   $ %s " TK_INSERT_MANY " <nb> <min> <max> [<distribution> [<graine>]]\n", exeName);
     fprintf(stderr, "          ajout de <nb> élements (dans [<min>,<max>[) aléatoires dans l'ensemble\n");
     fprintf(stderr, "   $ %s " TK_PRINT "\n", exeName);
     fprintf(stderr, "          affichage trié (dans la console du master)\n");
-    fprintf(stderr, "   $ %s " TK_LOCAL " <nbThreads> <elt> <nb> <min> <max>\n", exeName);
+    fprintf(stderr, "   $ %s " TK_DEPTH "\n", exeName);
+    fprintf(stderr, "          profondeur de l'arbre qui stocke l'ensemble\n");
+    fprintf(stderr, "   $ %s " TK_RANGE " <a> <b>\n", exeName);
+    fprintf(stderr, "          nombre et somme des éléments de l'intervalle [<a>,<b>[\n");
+    fprintf(stderr, "   $ %s " TK_KTH " <k>\n", exeName);
+    fprintf(stderr, "          <k>-ième plus petit élément (1 : le minimum), doublons compris\n");
+    fprintf(stderr, "   $ %s " TK_RANK " <elt>\n", exeName);
+    fprintf(stderr, "          nombre d'éléments strictement inférieurs à <elt>\n");
+    fprintf(stderr, "   $ %s " TK_PERCENTILE " <p>\n", exeName);
+    fprintf(stderr, "          percentile <p> (dans [0,100], 50 : la médiane)\n");
+    fprintf(stderr, "   $ %s " TK_EXPORT " [<fichier>]\n", exeName);
+    fprintf(stderr, "          éléments triés et leurs cardinalités, affichés ou écrits en binaire\n"
+            "          (float, int) dans <fichier>\n");
+    fprintf(stderr, "   $ %s " TK_SCAN " <after> <limit>\n", exeName);
+    fprintf(stderr, "          au plus <limit> éléments (et cardinalités) strictement supérieurs à <after>\n"
+            "          (-inf pour commencer), et le curseur de la page suivante\n");
+    fprintf(stderr, "   $ %s " TK_SNAPSHOT " <fichier>\n", exeName);
+    fprintf(stderr, "          instantané binaire de l'ensemble (chemin relatif au répertoire du master),\n"
+            "          rechargé par master --load <fichier>\n");
+    fprintf(stderr, "   $ %s " TK_STATS "\n", exeName);
+    fprintf(stderr, "          latences du master par type d'ordre (attente, traitement, écriture)\n");
+    fprintf(stderr, "   $ %s " TK_LOCAL " <nbThreads> <elt> <nb> <min> <max> [<distribution> [<graine>]]\n", exeName);
     fprintf(stderr, "          combien d'exemplaires de <elt> dans <nb> éléments (dans [<min>,<max>[)\n"
             "          aléatoires avec <nbThreads> threads\n");
+    fprintf(stderr, "   $ %s " TK_LOCAL_STREAM " <nbThreads> <elt> <nb> <min> <max> <graine>\n", exeName);
+    fprintf(stderr, "          idem, mais chaque thread génère et compte ses éléments au fur et à mesure\n"
+            "          (aucun tableau) ; même résultat pour une même <graine> quel que soit <nbThreads>\n");
+    fprintf(stderr, "   <distribution> : uniform (défaut), zipf, normal, sorted, reverse ou few ;\n"
+            "   <graine> : même graine, mêmes éléments (défaut : le pid)\n");
 
     if (message != NULL)
         fprintf(stderr, "message :\n    %s\n", message);
@@ -102,6 +147,35 @@ static void usage(const char *exeName, const char *message)
 /************************************************************************
  * Analyse des arguments passés en ligne de commande
  ************************************************************************/
+// réel fini obligatoire : sinon NaN ou inf casseraient l'ordre côté master
+// et workers, et une saisie invalide serait lue silencieusement comme 0
+static float parseFloat(const char *exeName, const char *arg, const char *message)
+{
+    char *end;
+    float value = strtof(arg, &end);
+    if (end == arg || *end != '\0' || ! isfinite(value))
+        usage(exeName, message);
+    return value;
+}
+
+// distribution et graine facultatives, à partir de argv[first]
+static void parseWorkload(int argc, char * argv[], int first, Data *data)
+{
+    data->dist = UT_UNIFORM;
+    data->seed = getpid();
+    if (argc > first)
+    {
+        data->dist = ut_distributionFromName(argv[first]);
+        if (data->dist < 0)
+            usage(argv[0], "distribution inconnue");
+    }
+    if (argc > first + 1)
+        data->seed = strtoull(argv[first + 1], NULL, 10);
+    // éléments entiers (précision 0, cf. sendData et lauchThreads)
+    if (! ut_gridHasValue(data->min, data->max, 0))
+        usage(argv[0], "aucun entier dans [min,max[");
+}
+
 static void parseArgs(int argc, char * argv[], Data *data)
 {
     data->order = CM_ORDER_NONE;
@@ -130,6 +204,26 @@ static void parseArgs(int argc, char * argv[], Data *data)
         data->order = CM_ORDER_PRINT;
     else if (strcmp(argv[1], TK_LOCAL) == 0)
         data->order = CM_ORDER_LOCAL;
+    else if (strcmp(argv[1], TK_LOCAL_STREAM) == 0)
+        data->order = CM_ORDER_LOCAL_STREAM;
+    else if (strcmp(argv[1], TK_DEPTH) == 0)
+        data->order = CM_ORDER_DEPTH;
+    else if (strcmp(argv[1], TK_RANGE) == 0)
+        data->order = CM_ORDER_RANGE;
+    else if (strcmp(argv[1], TK_KTH) == 0)
+        data->order = CM_ORDER_KTH;
+    else if (strcmp(argv[1], TK_RANK) == 0)
+        data->order = CM_ORDER_RANK;
+    else if (strcmp(argv[1], TK_PERCENTILE) == 0)
+        data->order = CM_ORDER_PERCENTILE;
+    else if (strcmp(argv[1], TK_EXPORT) == 0)
+        data->order = CM_ORDER_EXPORT;
+    else if (strcmp(argv[1], TK_SCAN) == 0)
+        data->order = CM_ORDER_SCAN;
+    else if (strcmp(argv[1], TK_SNAPSHOT) == 0)
+        data->order = CM_ORDER_SNAPSHOT;
+    else if (strcmp(argv[1], TK_STATS) == 0)
+        data->order = CM_ORDER_STATS;
     else
         usage(argv[0], "commande inconnue");
 
@@ -148,45 +242,129 @@ static void parseArgs(int argc, char * argv[], Data *data)
         usage(argv[0], TK_SUM " : il ne faut pas d'argument après la commande");
     if ((data->order == CM_ORDER_INSERT) && (argc != 3))
         usage(argv[0], TK_INSERT " : il faut un et un seul argument après la commande");
-    if ((data->order == CM_ORDER_INSERT_MANY) && (argc != 5))
+    if ((data->order == CM_ORDER_INSERT_MANY) && ((argc < 5) || (argc > 7)))
         usage(argv[0], TK_INSERT_MANY " : il faut 3 arguments après la commande");
     if ((data->order == CM_ORDER_PRINT) && (argc != 2))
         usage(argv[0], TK_PRINT " : il ne faut pas d'argument après la commande");
-    if ((data->order == CM_ORDER_LOCAL) && (argc != 7))
-        usage(argv[0], TK_LOCAL " : il faut 5 arguments après la commande");
+    if ((data->order == CM_ORDER_DEPTH) && (argc != 2))
+        usage(argv[0], TK_DEPTH " : il ne faut pas d'argument après la commande");
+    if ((data->order == CM_ORDER_RANGE) && (argc != 4))
+        usage(argv[0], TK_RANGE " : il faut 2 arguments après la commande");
+    if ((data->order == CM_ORDER_KTH) && (argc != 3))
+        usage(argv[0], TK_KTH " : il faut un et un seul argument après la commande");
+    if ((data->order == CM_ORDER_RANK) && (argc != 3))
+        usage(argv[0], TK_RANK " : il faut un et un seul argument après la commande");
+    if ((data->order == CM_ORDER_PERCENTILE) && (argc != 3))
+        usage(argv[0], TK_PERCENTILE " : il faut un et un seul argument après la commande");
+    if ((data->order == CM_ORDER_EXPORT) && (argc != 2) && (argc != 3))
+        usage(argv[0], TK_EXPORT " : il faut au plus un argument après la commande");
+    if ((data->order == CM_ORDER_SCAN) && (argc != 4))
+        usage(argv[0], TK_SCAN " : il faut 2 arguments après la commande");
+    if ((data->order == CM_ORDER_STATS) && (argc != 2))
+        usage(argv[0], TK_STATS " : il ne faut pas d'argument après la commande");
+    if ((data->order == CM_ORDER_SNAPSHOT) && (argc != 3))
+        usage(argv[0], TK_SNAPSHOT " : il faut un et un seul argument après la commande");
+    if ((data->order == CM_ORDER_LOCAL) && ((argc < 7) || (argc > 9)))
+        usage(argv[0], TK_LOCAL " : il faut 5 à 7 arguments après la commande");
+    if ((data->order == CM_ORDER_LOCAL_STREAM) && (argc != 8))
+        usage(argv[0], TK_LOCAL_STREAM " : il faut 6 arguments après la commande");
 
     // extraction des arguments
+    data->file = NULL;
     if (data->order == CM_ORDER_EXIST)
     {
-        data->elt = strtof(argv[2], NULL);
+        data->elt = parseFloat(argv[0], argv[2], TK_EXIST " : elt doit être un réel fini");
     }
     else if (data->order == CM_ORDER_INSERT)
     {
-        data->elt = strtof(argv[2], NULL);
+        data->elt = parseFloat(argv[0], argv[2], TK_INSERT " : elt doit être un réel fini");
     }
     else if (data->order == CM_ORDER_INSERT_MANY)
     {
         data->nb = strtol(argv[2], NULL, 10);
-        data->min = strtof(argv[3], NULL);
-        data->max = strtof(argv[4], NULL);
+        data->min = parseFloat(argv[0], argv[3], TK_INSERT_MANY " : min doit être un réel fini");
+        data->max = parseFloat(argv[0], argv[4], TK_INSERT_MANY " : max doit être un réel fini");
         if (data->nb < 1)
             usage(argv[0], TK_INSERT_MANY " : nb doit être strictement positif");
         if (data->max < data->min)
             usage(argv[0], TK_INSERT_MANY " : max ne doit pas être inférieur à min");
+        parseWorkload(argc, argv, 5, data);
+    }
+    else if (data->order == CM_ORDER_KTH)
+    {
+        data->nb = strtol(argv[2], NULL, 10);
+        if (data->nb < 1)
+            usage(argv[0], TK_KTH " : k doit être strictement positif");
+    }
+    else if (data->order == CM_ORDER_RANK)
+    {
+        data->elt = parseFloat(argv[0], argv[2], TK_RANK " : elt doit être un réel fini");
+    }
+    else if (data->order == CM_ORDER_PERCENTILE)
+    {
+        data->elt = parseFloat(argv[0], argv[2], TK_PERCENTILE " : p doit être un nombre");
+        if (data->elt < 0 || data->elt > 100)
+            usage(argv[0], TK_PERCENTILE " : p doit être dans [0,100]");
+    }
+    else if (data->order == CM_ORDER_SCAN)
+    {
+        // seule exception : -inf, curseur de la première page (cf. usage)
+        if (strcmp(argv[2], "-inf") == 0)
+            data->elt = -INFINITY;
+        else
+            data->elt = parseFloat(argv[0], argv[2], TK_SCAN " : after doit être un réel fini ou -inf");
+        long limit = strtol(argv[3], NULL, 10);
+        if (limit < 1 || limit > CM_MAX_SCAN_LIMIT)
+            usage(argv[0], TK_SCAN " : limit doit être dans [1, 2^20]");
+        data->nb = limit;
+    }
+    else if (data->order == CM_ORDER_EXPORT)
+    {
+        if (argc == 3)
+            data->file = argv[2];
+    }
+    else if (data->order == CM_ORDER_SNAPSHOT)
+    {
+        data->file = argv[2];
+        if (strlen(data->file) == 0 || strlen(data->file) >= CM_PATH_SIZE)
+            usage(argv[0], TK_SNAPSHOT " : chemin vide ou trop long");
+    }
+    else if (data->order == CM_ORDER_RANGE)
+    {
+        data->min = parseFloat(argv[0], argv[2], TK_RANGE " : a doit être un réel fini");
+        data->max = parseFloat(argv[0], argv[3], TK_RANGE " : b doit être un réel fini");
+        if (data->max < data->min)
+            usage(argv[0], TK_RANGE " : b ne doit pas être inférieur à a");
     }
     else if (data->order == CM_ORDER_LOCAL)
     {
         data->nbThreads = strtol(argv[2], NULL, 10);
-        data->elt = strtof(argv[3], NULL);
+        data->elt = parseFloat(argv[0], argv[3], TK_LOCAL " : elt doit être un réel fini");
         data->nb = strtol(argv[4], NULL, 10);
-        data->min = strtof(argv[5], NULL);
-        data->max = strtof(argv[6], NULL);
+        data->min = parseFloat(argv[0], argv[5], TK_LOCAL " : min doit être un réel fini");
+        data->max = parseFloat(argv[0], argv[6], TK_LOCAL " : max doit être un réel fini");
         if (data->nbThreads < 1)
             usage(argv[0], TK_LOCAL " : nbThreads doit être strictement positif");
         if (data->nb < 1)
             usage(argv[0], TK_LOCAL " : nb doit être strictement positif");
         if (data->max <= data->min)
             usage(argv[0], TK_LOCAL " : max ne doit être strictement supérieur à min");
+        parseWorkload(argc, argv, 7, data);
+    }
+    else if (data->order == CM_ORDER_LOCAL_STREAM)
+    {
+        data->nbThreads = strtol(argv[2], NULL, 10);
+        data->elt = parseFloat(argv[0], argv[3], TK_LOCAL_STREAM " : elt doit être un réel fini");
+        data->total = strtol(argv[4], NULL, 10);
+        data->min = parseFloat(argv[0], argv[5], TK_LOCAL_STREAM " : min doit être un réel fini");
+        data->max = parseFloat(argv[0], argv[6], TK_LOCAL_STREAM " : max doit être un réel fini");
+        data->seed = strtoull(argv[7], NULL, 10);
+        if (data->nbThreads < 1)
+            usage(argv[0], TK_LOCAL_STREAM " : nbThreads doit être strictement positif");
+        if (data->total < 1)
+            usage(argv[0], TK_LOCAL_STREAM " : nb doit être strictement positif");
+        if (data->max <= data->min)
+            usage(argv[0], TK_LOCAL_STREAM " : max ne doit être strictement supérieur à min");
     }
 }
 
@@ -198,85 +376,48 @@ static void parseArgs(int argc, char * argv[], Data *data)
 
 //TODO
 // Code commun à tous les threads
-// Un thread s'occupe d'une portion du tableau et compte en interne le nombre de fois
-// où l'élément recherché est présent dans cette portion. On ajoute alors,
-// en section critique, ce nombre au compteur partagé par tous les threads.
-// Le compteur partagé est la variable "result" de "lauchThreads".
-// A vous de voir les paramètres nécessaires  (aucune variable globale autorisée)
+// Le tableau est découpé en morceaux de LOCAL_CHUNK éléments, pris à la
+// demande par les threads (cf. ut_parallelFor) : un thread retardé par
+// l'ordonnanceur en traite simplement moins. Chaque thread compte dans son
+// propre accumulateur ; ils ne sont additionnés qu'une fois, à la fin
+// (pas de section critique pendant le calcul).
+// Le compteur final est la variable "result" de "lauchThreads".
 //END TODO
 
-// Structure pour les arguments à passer à un thread
+// éléments par morceau : assez pour amortir la prise d'un morceau, assez
+// peu pour équilibrer la fin du calcul
+#define LOCAL_CHUNK (64 * 1024)
+
+// Structure pour les arguments communs à tous les threads
 typedef struct
 {
-    float *tab;    // Pointeur vers le tableau
-    int startIdx;  // Indice de début de la portion du tableau à traiter
-    int endIdx;    // Indice de fin de la portion du tableau à traiter
-    float elt;     // Elément recherché
-    int *result;   // Compteur partagé par tous les threads
-    pthread_mutex_t *mutex;  // Mutex pour la section critique
-} ThreadArgs;
+    const float *tab;   // Pointeur vers le tableau
+    float elt;          // Elément recherché
+} CountArgs;
 
-// Code commun à tous les threads
-void *threadFunction(void *args)
+// Code commun à tous les threads : comptage d'un morceau (noyau
+// vectoriel, cf. count.h)
+static void countChunk(int begin, int end, long *local, void *arg)
 {
-    ThreadArgs *threadArgs = (ThreadArgs *)args;
-    int localCount = 0;
-
-    // Parcours de la portion du tableau assignée au thread
-    for (int i = threadArgs->startIdx; i < threadArgs->endIdx; ++i)
-    {
-        if (threadArgs->tab[i] == threadArgs->elt)
-        {
-            localCount++;
-        }
-    }
-
-    // Section critique : ajout du résultat local au compteur partagé
-    pthread_mutex_lock(threadArgs->mutex);
-    *(threadArgs->result) += localCount;
-    pthread_mutex_unlock(threadArgs->mutex);
-
-    pthread_exit(NULL);
+    const CountArgs *args = arg;
+    *local += ct_count(args->tab + begin, end - begin, args->elt);
 }
 
 
 void lauchThreads(const Data *data)
 {
     //TODO déclarations nécessaires : mutex, ...
-    int result = 0;
-    float * tab = ut_generateTab(data->nb, data->min, data->max, 0);
-
-    // Initialisation du mutex
-    pthread_mutex_t mutex;
-    pthread_mutex_init(&mutex, NULL);
-
-    //TODO lancement des threads
-    pthread_t *threads = malloc(data->nbThreads * sizeof(pthread_t));
-    ThreadArgs *threadArgsArray = malloc(data->nbThreads * sizeof(ThreadArgs));
-
-    int portionSize = data->nb / data->nbThreads;
-    int remainder = data->nb % data->nbThreads;
-    int currentIndex = 0;
-
-    for (int i = 0; i < data->nbThreads; ++i)
-    {
-        threadArgsArray[i].tab = tab;
-        threadArgsArray[i].startIdx = currentIndex;
-        threadArgsArray[i].endIdx = currentIndex + portionSize + (i < remainder ? 1 : 0);
-        threadArgsArray[i].elt = data->elt;
-        threadArgsArray[i].result = &result;
-        threadArgsArray[i].mutex = &mutex;
-
-        pthread_create(&threads[i], NULL, threadFunction, (void *)&threadArgsArray[i]);
-
-        currentIndex = threadArgsArray[i].endIdx;
-    }
-
-    //TODO attente de la fin des threads
-    for (int i = 0; i < data->nbThreads; ++i)
-    {
-        pthread_join(threads[i], NULL);
-    }
+    UtRandom g;
+    ut_randomSeed(&g, data->seed, 0);
+    float * tab = ut_generateDist(&g, data->dist, data->nb, data->min, data->max, 0);
+    CountArgs args = { tab, data->elt };
+    UtThreadStats *stats = malloc(data->nbThreads * sizeof(UtThreadStats));
+    myassert(stats != NULL, "Erreur");
+
+    //TODO lancement des threads, attente de leur fin
+    double start = ut_now();
+    long result = ut_parallelFor(data->nb, LOCAL_CHUNK, data->nbThreads, countChunk, &args, stats);
+    double seconds = ut_now() - start;
 
     // résultat (result a été rempli par les threads)
     // affichage du tableau si pas trop gros
@@ -298,23 +439,149 @@ void lauchThreads(const Data *data)
         if (tab[i] == data->elt)
             nbVerif ++;
     }
-    printf("Elément %g présent %d fois (%d attendu)\n", data->elt, result, nbVerif);
+    // débit de chaque thread (octets du tableau lus par seconde), puis
+    // débit global
+    printf("Noyau de comptage : %s\n", ct_kernelName());
+    for (int i = 0; i < data->nbThreads; ++i)
+    {
+        double bytes = (double) stats[i].nbIndices * sizeof(float);
+        printf("thread %d : %d éléments (%d morceaux) en %.6f s, %.2f Go/s\n", i, stats[i].nbIndices,
+               stats[i].nbChunks, stats[i].seconds, bytes / ((stats[i].seconds > 0) ? stats[i].seconds : 1e-9) / 1e9);
+    }
+    printf("total : %.6f s, %.2f Go/s\n", seconds,
+           (double) data->nb * sizeof(float) / ((seconds > 0) ? seconds : 1e-9) / 1e9);
+    printf("Elément %g présent %ld fois (%d attendu)\n", data->elt, result, nbVerif);
     if (result == nbVerif)
         printf("=> ok ! le résultat calculé par les threads est correct\n");
     else
         printf("=> PB ! le résultat calculé par les threads est incorrect\n");
 
     //TODO libération des ressources
-    free(threads);
-    free(threadArgsArray);
+    free(stats);
     free(tab);
-    pthread_mutex_destroy(&mutex);
+}
+
+
+// Version sans tableau : les éléments sont générés par blocs de
+// STREAM_BLOCK floats, comptés aussitôt, pendant qu'ils sont encore en
+// cache L1. Le bloc b est tiré du flux b de la graine (cf. UtRandom) : la
+// suite des éléments, donc le résultat, ne dépend que de la graine, pas du
+// nombre de threads ni de quel thread a pris quel bloc.
+#define STREAM_BLOCK 4096        // 16 Ko
+#define STREAM_CHUNK 16          // blocs par morceau (autant d'éléments que LOCAL_CHUNK)
+#define STREAM_VERIFY_MAX 100000000L   // au-delà, la vérification séquentielle serait trop longue
+
+typedef struct
+{
+    long nb;            // nombre total d'éléments
+    float elt;          // Elément recherché
+    float min;
+    float max;
+    uint64_t seed;
+} StreamArgs;
+
+// taille du bloc b (seul le dernier est incomplet)
+static int streamBlockSize(const StreamArgs *args, int b)
+{
+    long left = args->nb - (long) b * STREAM_BLOCK;
+    return (left < STREAM_BLOCK) ? left : STREAM_BLOCK;
+}
+
+// Code commun à tous les threads : génération et comptage des blocs
+// [begin, end[ ; le générateur et le bloc sont propres au thread
+static void streamChunk(int begin, int end, long *local, void *arg)
+{
+    const StreamArgs *args = arg;
+    float block[STREAM_BLOCK];
+    UtRandom g;
+    for (int b = begin; b < end; b++)
+    {
+        int size = streamBlockSize(args, b);
+        ut_randomSeed(&g, args->seed, b);
+        ut_randomFillTab(&g, block, size, args->min, args->max, 0);
+        *local += ct_count(block, size, args->elt);
+    }
+}
+
+void lauchStreamThreads(const Data *data)
+{
+    StreamArgs args = { data->total, data->elt, data->min, data->max, data->seed };
+    long nbBlocks = (data->total + STREAM_BLOCK - 1) / STREAM_BLOCK;
+    if (nbBlocks > INT_MAX)
+    {
+        fprintf(stderr, TK_LOCAL_STREAM " : nb trop grand (au plus %ld)\n", (long) INT_MAX * STREAM_BLOCK);
+        exit(EXIT_FAILURE);
+    }
+    UtThreadStats *stats = malloc(data->nbThreads * sizeof(UtThreadStats));
+    myassert(stats != NULL, "Erreur");
+
+    double start = ut_now();
+    long result = ut_parallelFor((int) nbBlocks, STREAM_CHUNK, data->nbThreads, streamChunk, &args, stats);
+    double seconds = ut_now() - start;
+
+    // vérification : même suite, régénérée séquentiellement élément par
+    // élément et comparée sans le noyau vectoriel
+    long nbVerif = -1;
+    if (data->total <= STREAM_VERIFY_MAX)
+    {
+        nbVerif = 0;
+        if (data->total <= 20)
+            printf("[");
+        UtRandom g;
+        for (int b = 0; b < nbBlocks; b++)
+        {
+            ut_randomSeed(&g, data->seed, b);
+            for (int i = 0; i < streamBlockSize(&args, b); i++)
+            {
+                float r = ut_randomFloat(&g, data->min, data->max, 0);
+                if (r == data->elt)
+                    nbVerif ++;
+                if (data->total <= 20)
+                    printf((i != 0) ? " %g" : "%g", r);
+            }
+        }
+        if (data->total <= 20)
+            printf("]\n");
+    }
+
+    // débit de chaque thread (éléments générés et comptés par seconde),
+    // puis débit global
+    printf("Noyau de comptage : %s\n", ct_kernelName());
+    for (int i = 0; i < data->nbThreads; ++i)
+    {
+        double nb = (double) stats[i].nbIndices * STREAM_BLOCK;
+        printf("thread %d : %d blocs (%d morceaux) en %.6f s, %.1f M éléments/s\n", i, stats[i].nbIndices,
+               stats[i].nbChunks, stats[i].seconds, nb / ((stats[i].seconds > 0) ? stats[i].seconds : 1e-9) / 1e6);
+    }
+    printf("total : %.6f s, %.1f M éléments/s\n", seconds,
+           (double) data->total / ((seconds > 0) ? seconds : 1e-9) / 1e6);
+    if (nbVerif < 0)
+    {
+        printf("Elément %g présent %ld fois (graine %llu, pas de vérification au-delà de %ld éléments)\n",
+               data->elt, result, (unsigned long long) data->seed, STREAM_VERIFY_MAX);
+    }
+    else
+    {
+        printf("Elément %g présent %ld fois (%ld attendu)\n", data->elt, result, nbVerif);
+        if (result == nbVerif)
+            printf("=> ok ! le résultat calculé par les threads est correct\n");
+        else
+            printf("=> PB ! le résultat calculé par les threads est incorrect\n");
+    }
+
+    free(stats);
 }
 
 
 /************************************************************************
  * Partie communication avec le master
  ************************************************************************/
+// gros tableau : il passe par un segment partagé (cf. client_master.h)
+static bool usePayload(const Data *data)
+{
+    return data->order == CM_ORDER_INSERT_MANY && (size_t) data->nb * sizeof(float) >= PAYLOAD_THRESHOLD;
+}
+
 // envoi des données au master
 void sendData(const Data *data)
 {
@@ -324,37 +591,184 @@ void sendData(const Data *data)
     //   CM_ORDER_INSERT et CM_ORDER_INSERT_MANY)
     //END TODO
 
-    int ret;
+    // un ordre est une seule trame (cf. frame.h) : en-tête et paramètres
+    // partent en un seul appel système
+    // range : deux ordres (nombre puis somme), envoyés ensemble
+    if (data->order == CM_ORDER_RANGE)
+    {
+        fr_begin(data->clientToMaster, CM_ORDER_RANGE_COUNT, 0);
+        fr_putFloat(data->clientToMaster, data->min);
+        fr_putFloat(data->clientToMaster, data->max);
+        fr_end(data->clientToMaster);
+        fr_begin(data->clientToMaster, CM_ORDER_RANGE_SUM, 0);
+        fr_putFloat(data->clientToMaster, data->min);
+        fr_putFloat(data->clientToMaster, data->max);
+        fr_end(data->clientToMaster);
+        fr_flush(data->clientToMaster);
+        return;
+    }
 
-    // Envoi de l'ordre au master
-    ret = write(data->clientToMaster, &(data->order), sizeof(data->order));
-    myassert(ret == sizeof(int), "Erreur");
+    int order = usePayload(data) ? CM_ORDER_INSERT_MANY_SHM : data->order;
+    fr_begin(data->clientToMaster, order, 0);
 
     // Envoi des paramètres supplémentaires au master
     switch (data->order)
     {
     case CM_ORDER_EXIST:
-        ret = write(data->clientToMaster, &(data->elt), sizeof(data->elt));
-        myassert(ret == sizeof(int), "Erreur");
+        fr_putFloat(data->clientToMaster, data->elt);
+        fr_end(data->clientToMaster);
         break;
 
     case CM_ORDER_INSERT:
-        ret = write(data->clientToMaster, &(data->elt), sizeof(data->elt));
-        myassert(ret == sizeof(int), "Erreur");
+    case CM_ORDER_RANK:
+    case CM_ORDER_PERCENTILE:
+        fr_putFloat(data->clientToMaster, data->elt);
+        fr_end(data->clientToMaster);
+        break;
+
+    case CM_ORDER_KTH:
+        fr_putInt(data->clientToMaster, data->nb);
+        fr_end(data->clientToMaster);
+        break;
+
+    case CM_ORDER_SCAN:
+        fr_putFloat(data->clientToMaster, data->elt);
+        fr_putInt(data->clientToMaster, data->nb);
+        fr_end(data->clientToMaster);
+        break;
+
+    case CM_ORDER_SNAPSHOT:
+    {
+        int length = strlen(data->file);
+        fr_putInt(data->clientToMaster, length);
+        fr_endLarge(data->clientToMaster, data->file, length);
+    }
         break;
 
     case CM_ORDER_INSERT_MANY:
-        ret = write(data->clientToMaster, &(data->nb), sizeof(data->nb));
-        myassert(ret == sizeof(int), "Erreur");
-        ret = write(data->clientToMaster, &(data->min), sizeof(data->min));
-        myassert(ret == sizeof(int), "Erreur");
-        ret = write(data->clientToMaster, &(data->max), sizeof(data->max));
-        myassert(ret == sizeof(int), "Erreur");
+    {
+        // le client tire les éléments et envoie le tableau complet au master ;
+        // un gros tableau est tiré directement dans le segment partagé, seul
+        // le nombre d'éléments passe par le tube
+        UtRandom g;
+        ut_randomSeed(&g, data->seed, 0);
+        fr_putInt(data->clientToMaster, data->nb);
+        if (usePayload(data))
+        {
+            size_t size = (size_t) data->nb * sizeof(float);
+            float *tab = payloadCreate(getpid(), size);
+            ut_fillDist(&g, data->dist, tab, data->nb, data->min, data->max, 0);
+            payloadClose(tab, size);
+            fr_end(data->clientToMaster);
+        }
+        else
+        {
+            float *tab = ut_generateDist(&g, data->dist, data->nb, data->min, data->max, 0);
+            fr_endLarge(data->clientToMaster, tab, data->nb * sizeof(float));
+            free(tab);
+        }
+    }
         break;
 
     default:
+        fr_end(data->clientToMaster);
         break;
     }
+    fr_flush(data->clientToMaster);
+}
+
+// paires (élément, cardinalité) envoyées par le master : écrites telles
+// quelles dans le fichier demandé, ou affichées
+static void receiveExport(const Data *data)
+{
+    int nb = fr_getInt(data->masterToClient);
+    int size = nb * (sizeof(float) + sizeof(int));
+    char *pairs = malloc(size);
+    myassert(pairs != NULL || nb == 0, "Erreur");
+    fr_get(data->masterToClient, pairs, size);
+
+    if (data->file != NULL)
+    {
+        int fd = open(data->file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        myassert(fd != -1, "ouverture du fichier d'export");
+        int ret = write(fd, pairs, size);
+        myassert(ret == size, "Erreur");
+        ret = close(fd);
+        myassert(ret == 0, "Erreur");
+        printf("%d élément(s) distinct(s) écrit(s) dans %s\n", nb, data->file);
+    }
+    else
+    {
+        for (int i = 0; i < nb; i++)
+        {
+            float elt;
+            int cardinality;
+            memcpy(&elt, pairs + i * (sizeof(float) + sizeof(int)), sizeof(float));
+            memcpy(&cardinality, pairs + i * (sizeof(float) + sizeof(int)) + sizeof(float), sizeof(int));
+            printf("Element: %g, Cardinality: %d\n", elt, cardinality);
+        }
+    }
+    free(pairs);
+}
+
+// nom d'un ordre reçu par le master (cf. client_master.h)
+static const char * orderName(int order)
+{
+    switch (order)
+    {
+    case CM_ORDER_STOP:            return TK_STOP;
+    case CM_ORDER_HOW_MANY:        return TK_HOW_MANY;
+    case CM_ORDER_MINIMUM:         return TK_MINIMUM;
+    case CM_ORDER_MAXIMUM:         return TK_MAXIMUM;
+    case CM_ORDER_EXIST:           return TK_EXIST;
+    case CM_ORDER_SUM:             return TK_SUM;
+    case CM_ORDER_INSERT:          return TK_INSERT;
+    case CM_ORDER_INSERT_MANY:     return TK_INSERT_MANY;
+    case CM_ORDER_INSERT_MANY_SHM: return TK_INSERT_MANY "(shm)";
+    case CM_ORDER_PRINT:           return TK_PRINT;
+    case CM_ORDER_DEPTH:           return TK_DEPTH;
+    case CM_ORDER_RANGE_COUNT:     return TK_RANGE "(count)";
+    case CM_ORDER_RANGE_SUM:       return TK_RANGE "(sum)";
+    case CM_ORDER_KTH:             return TK_KTH;
+    case CM_ORDER_RANK:            return TK_RANK;
+    case CM_ORDER_PERCENTILE:      return TK_PERCENTILE;
+    case CM_ORDER_EXPORT:          return TK_EXPORT;
+    case CM_ORDER_SCAN:            return TK_SCAN;
+    case CM_ORDER_SNAPSHOT:        return TK_SNAPSHOT;
+    case CM_ORDER_STATS:           return TK_STATS;
+    default:                       return "?";
+    }
+}
+
+// histogrammes du master : pour chaque type d'ordre et chaque étape,
+// p50, p99 et maximum en microsecondes
+static void receiveStats(const Data *data)
+{
+    static const char * const phaseNames[ST_NB_PHASES] = { "attente", "traitement", "écriture" };
+
+    int nb = fr_getInt(data->masterToClient);
+    StOrderStats *orders = malloc(nb * sizeof(StOrderStats));
+    myassert(orders != NULL || nb == 0, "Erreur");
+    fr_get(data->masterToClient, orders, nb * sizeof(StOrderStats));
+
+    printf("%-18s %8s", "ordre", "nombre");
+    for (int p = 0; p < ST_NB_PHASES; p++)
+        printf("  %-28s", phaseNames[p]);
+    printf("\n%-18s %8s", "", "");
+    for (int p = 0; p < ST_NB_PHASES; p++)
+        printf("  %8s %8s %10s", "p50 µs", "p99 µs", "max µs");
+    printf("\n");
+    for (int i = 0; i < nb; i++)
+    {
+        printf("%-18s %8d", orderName(orders[i].order), orders[i].phases[ST_QUEUE].count);
+        for (int p = 0; p < ST_NB_PHASES; p++)
+        {
+            const StHistogram *h = &(orders[i].phases[p]);
+            printf("  %8.1f %8.1f %10.1f", st_percentile(h, 0.50), st_percentile(h, 0.99), h->maxUs);
+        }
+        printf("\n");
+    }
+    free(orders);
 }
 
 // attente de la réponse du master
@@ -366,11 +780,10 @@ void receiveAnswer(const Data *data)
     //      . récupération de données supplémentaires du master si nécessaire
     // - affichage du résultat
     //END TODO
-    int ret;
-
-    int ack;
-    ret = read(data->masterToClient, &ack, sizeof(int));
-    myassert(ret == sizeof(int), "Erreur");
+    FrameHeader header;
+    bool ok = fr_next(data->masterToClient, &header);
+    myassert(ok, "le master a fermé la session");
+    int ack = header.opcode;
 
     switch(ack)
     {
@@ -380,13 +793,8 @@ void receiveAnswer(const Data *data)
 
     case CM_ANSWER_HOW_MANY_OK:
     {
-        int res1, res2;
-
-        ret = read(data->masterToClient, &res1, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-
-        ret = read(data->masterToClient, &res2, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
+        int res1 = fr_getInt(data->masterToClient);
+        int res2 = fr_getInt(data->masterToClient);
 
         printf("nombre d'élement: %d\n", res1);
         printf("nombre d'element disttinc: %d \n", res2);
@@ -397,10 +805,8 @@ void receiveAnswer(const Data *data)
 
     case CM_ANSWER_MAXIMUM_OK:
     {
-        int max;
-        ret = read(data->masterToClient, &max, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-        printf("Max : %d\n", max);
+        float max = fr_getFloat(data->masterToClient);
+        printf("Max : %g\n", max);
     }
 
     break;
@@ -411,10 +817,8 @@ void receiveAnswer(const Data *data)
 
     case CM_ANSWER_MINIMUM_OK:
     {
-        int min;
-        ret = read(data->masterToClient, &min, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-        printf("Min: %d \n", min);
+        float min = fr_getFloat(data->masterToClient);
+        printf("Min: %g \n", min);
     }
     break;
 
@@ -423,24 +827,20 @@ void receiveAnswer(const Data *data)
         break;
 
     case CM_ANSWER_EXIST_NO:
-        printf("L'element %f n'existe pas\n", data->elt);
+        printf("L'element %g n'existe pas\n", data->elt);
         break;
 
     case CM_ANSWER_EXIST_YES:
     {
-        int nb;
-        ret = read(data->masterToClient, &nb, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-        printf("%f: %d \n", data->elt, nb);
+        int nb = fr_getInt(data->masterToClient);
+        printf("%g: %d \n", data->elt, nb);
     }
     break;
 
     case CM_ANSWER_SUM_OK:
     {
-        int sum;
-        ret = read(data->masterToClient, &sum, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-        printf("Sum: %d \n", sum);
+        float sum = fr_getFloat(data->masterToClient);
+        printf("Sum: %g \n", sum);
     }
     break;
 
@@ -448,12 +848,99 @@ void receiveAnswer(const Data *data)
         printf("c'est fait!\n");
         break;
 
+    case CM_ANSWER_INSERT_MANY_ERROR:
+        printf("Le master a refusé le tableau (nombre d'éléments ou segment partagé incorrect)\n");
+        break;
+
     case CM_ANSWER_INSERT_MANY_OK:
         printf("c'est fait!\n");
         break;
     case CM_ANSWER_PRINT_OK:
         break;
 
+    case CM_ANSWER_DEPTH_OK:
+    {
+        int depth = fr_getInt(data->masterToClient);
+        printf("Profondeur : %d\n", depth);
+    }
+    break;
+
+    case CM_ANSWER_KTH_OK:
+    {
+        float elt = fr_getFloat(data->masterToClient);
+        if (data->order == CM_ORDER_KTH)
+            printf("%d-ième élément : %g\n", data->nb, elt);
+        else
+            printf("percentile %g : %g\n", data->elt, elt);
+    }
+    break;
+
+    case CM_ANSWER_KTH_NONE:
+        printf("L'ensemble a moins d'éléments que demandé\n");
+        break;
+
+    case CM_ANSWER_RANK_OK:
+    {
+        int rank = fr_getInt(data->masterToClient);
+        printf("%d élément(s) inférieur(s) à %g\n", rank, data->elt);
+    }
+    break;
+
+    case CM_ANSWER_EXPORT_OK:
+        receiveExport(data);
+        break;
+
+    case CM_ANSWER_SNAPSHOT_OK:
+    {
+        int nb = fr_getInt(data->masterToClient);
+        printf("%d élément(s) distinct(s) écrit(s) dans %s\n", nb, data->file);
+    }
+    break;
+
+    case CM_ANSWER_SNAPSHOT_ERROR:
+        printf("Le master n'a pas pu écrire %s\n", data->file);
+        break;
+
+    case CM_ANSWER_STATS_OK:
+        receiveStats(data);
+        break;
+
+    case CM_ANSWER_SCAN_OK:
+    {
+        int nb = fr_getInt(data->masterToClient);
+        int more = fr_getInt(data->masterToClient);
+        float cursor = fr_getFloat(data->masterToClient);
+        for (int i = 0; i < nb; i++)
+        {
+            float elt = fr_getFloat(data->masterToClient);
+            int cardinality = fr_getInt(data->masterToClient);
+            printf("Element: %g, Cardinality: %d\n", elt, cardinality);
+        }
+        if (more)
+            printf("suite : %s %.9g %d\n", TK_SCAN, cursor, data->nb);
+        else
+            printf("fin de l'ensemble\n");
+    }
+    break;
+
+    case CM_ANSWER_SCAN_ERROR:
+        printf("Le master a refusé la taille de page\n");
+        break;
+
+    case CM_ANSWER_RANGE_COUNT_OK:
+    {
+        int nb = fr_getInt(data->masterToClient);
+        printf("[%g,%g[ : %d élément(s)\n", data->min, data->max, nb);
+    }
+    break;
+
+    case CM_ANSWER_RANGE_SUM_OK:
+    {
+        float sum = fr_getFloat(data->masterToClient);
+        printf("[%g,%g[ : somme %g\n", data->min, data->max, sum);
+    }
+    break;
+
     default:
         break;
 
@@ -468,54 +955,28 @@ int main(int argc, char * argv[])
 {
     Data data;
     parseArgs(argc, argv, &data);
-    int ret;
 
     if (data.order == CM_ORDER_LOCAL)
         lauchThreads(&data);
+    else if (data.order == CM_ORDER_LOCAL_STREAM)
+        lauchStreamThreads(&data);
     else
     {
-        //TODO
-        // - entrer en section critique :
-        //       . pour empêcher que 2 clients communiquent simultanément
-        //       . le mutex est déjà créé par le master
-        // - ouvrir les tubes nommés (ils sont déjà créés par le master)
-        //       . les ouvertures sont bloquantes, il faut s'assurer que
-        //         le master ouvre les tubes dans le même ordre
-        //END TODO
-
-        // Entrer en section critique
-        //data.semCM = recupSem();
-
-
-        // Ouvrir les tubes nommés
-        data.masterToClient = open(MASTER_TO_CLIENT, O_RDONLY);
-        myassert(data.masterToClient != -1,"Erreur");
-
-        data.clientToMaster = open(CLIENT_TO_MASTER, O_WRONLY);
-        myassert(data.clientToMaster != -1, "Erreur");
+        // Ouvrir une session dédiée avec le master : plusieurs clients
+        // peuvent communiquer simultanément, pas de section critique
+        sessionOpen(&data.masterToClient, &data.clientToMaster);
 
         sendData(&data);
         receiveAnswer(&data);
-
-        //TODO
-        // - sortir de la section critique
-        // - libérer les ressources (fermeture des tubes, ...)
-        // - débloquer le master grâce à un second sémaphore (cf. ci-dessous)
-        //
-        // Une fois que le master a envoyé la réponse au client, il se bloque
-        // sur un sémaphore ; le dernier point permet donc au master de continuer
-        //
-        // N'hésitez pas à faire des fonctions annexes ; si la fonction main
-        // ne dépassait pas une trentaine de lignes, ce serait bien.
-        //sortirSC(data.semCM);
-
-
-    // Fermeture des tubes
-    ret = close(data.clientToMaster);
-    myassert(ret == 0, "tubeClientToMaster n'est pas fermé");
-    ret = close(data.masterToClient);
-    myassert(ret == 0, "tubeMasterToClient n'est pas fermé");
-
+        if (data.order == CM_ORDER_RANGE)
+            receiveAnswer(&data);
+        if (usePayload(&data))
+            payloadDestroy(getpid());
+        TRACE1("[client] %ld appels système de lecture/écriture\n", fr_syscalls());
+
+        // Fermeture des tubes (le master voit la fin de la session)
+        fr_close(data.clientToMaster);
+        fr_close(data.masterToClient);
     }
 
     return EXIT_SUCCESS;
@@ -2,13 +2,18 @@
 #include "config.h"
 #endif
 
-#define _XOPEN_SOURCE
+// ftruncate
+#define _XOPEN_SOURCE 500
 
 //TODO include selon ce qu'il y a dans le .h
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/ipc.h>
 #include <sys/sem.h>
 
@@ -16,11 +21,133 @@
 
 #include "utils.h"
 #include "myassert.h"
+#include "frame.h"
 
 #include "client_master.h"
 
 //TODO fonctions selon ce qu'il y a dans le .h
 
+void sessionPipeNames(pid_t pid, char masterToClient[PIPE_NAME_SIZE], char clientToMaster[PIPE_NAME_SIZE])
+{
+    snprintf(masterToClient, PIPE_NAME_SIZE, "%s.%d", MASTER_TO_CLIENT, (int) pid);
+    snprintf(clientToMaster, PIPE_NAME_SIZE, "%s.%d", CLIENT_TO_MASTER, (int) pid);
+}
+
+// les tubes sont supprimés dès qu'ils sont ouverts des deux côtés ; un
+// processus peut ouvrir plusieurs sessions l'une après l'autre
+void sessionOpen(int *masterToClient, int *clientToMaster)
+{
+    int ret;
+    char masterToClientName[PIPE_NAME_SIZE], clientToMasterName[PIPE_NAME_SIZE];
+    sessionPipeNames(getpid(), masterToClientName, clientToMasterName);
+
+    ret = mkfifo(masterToClientName, 0600);
+    myassert(ret != -1, "Erreur");
+    ret = mkfifo(clientToMasterName, 0600);
+    myassert(ret != -1, "Erreur");
+
+    // non bloquant pour ne pas attendre le master, qui ouvrira ensuite ce
+    // tube en écriture ; les lectures suivantes sont bloquantes
+    *masterToClient = open(masterToClientName, O_RDONLY | O_NONBLOCK);
+    myassert(*masterToClient != -1, "Erreur");
+    ret = fcntl(*masterToClient, F_SETFL, 0);
+    myassert(ret != -1, "Erreur");
+
+    // annonce au master (écriture atomique)
+    int registration = open(REGISTRATION, O_WRONLY);
+    myassert(registration != -1, "le master n'est pas lancé");
+    pid_t pid = getpid();
+    ret = write(registration, &pid, sizeof(pid_t));
+    myassert(ret == sizeof(pid_t), "Erreur");
+    ret = close(registration);
+    myassert(ret == 0, "Erreur");
+
+    // réponse du master (accord ou refus) : poll, car un read sans
+    // écrivain renverrait tout de suite la fin du tube
+    struct pollfd pollfd = { *masterToClient, POLLIN, 0 };
+    ret = poll(&pollfd, 1, -1);
+    myassert(ret == 1, "Erreur");
+    FrameHeader header;
+    bool accepted = fr_next(*masterToClient, &header) && header.opcode == CM_ANSWER_SESSION_OK;
+    ret = unlink(masterToClientName);
+    myassert(ret != -1, "Erreur");
+    if (! accepted)
+    {
+        ret = unlink(clientToMasterName);
+        myassert(ret != -1, "Erreur");
+        myassert(false, "le master refuse la session (trop de clients)");
+    }
+
+    // bloquant jusqu'à ce que le master ouvre la session
+    *clientToMaster = open(clientToMasterName, O_WRONLY);
+    myassert(*clientToMaster != -1, "Erreur");
+    ret = unlink(clientToMasterName);
+    myassert(ret != -1, "Erreur");
+
+}
+
+void payloadName(pid_t pid, char name[PIPE_NAME_SIZE])
+{
+    snprintf(name, PIPE_NAME_SIZE, "/%s.%d", PAYLOAD, (int) pid);
+}
+
+// projection de tout le segment ; le descripteur n'est plus utile ensuite
+static void * payloadMap(int fd, size_t size)
+{
+    void *payload = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    myassert(payload != MAP_FAILED, "projection du segment");
+    int ret = close(fd);
+    myassert(ret == 0, "Erreur");
+    return payload;
+}
+
+void * payloadCreate(pid_t pid, size_t size)
+{
+    char name[PIPE_NAME_SIZE];
+    payloadName(pid, name);
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    myassert(fd != -1, "création du segment");
+    int ret = ftruncate(fd, size);
+    myassert(ret == 0, "Erreur");
+    return payloadMap(fd, size);
+}
+
+void * payloadOpen(pid_t pid, size_t size)
+{
+    char name[PIPE_NAME_SIZE];
+    payloadName(pid, name);
+
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+    int ret = fstat(fd, &st);
+    myassert(ret == 0, "Erreur");
+    if ((size_t) st.st_size < size)
+    {
+        ret = close(fd);
+        myassert(ret == 0, "Erreur");
+        return NULL;
+    }
+    return payloadMap(fd, size);
+}
+
+void payloadClose(void *payload, size_t size)
+{
+    int ret = munmap(payload, size);
+    myassert(ret == 0, "Erreur");
+}
+
+void payloadDestroy(pid_t pid)
+{
+    char name[PIPE_NAME_SIZE];
+    payloadName(pid, name);
+    int ret = shm_unlink(name);
+    myassert(ret == 0, "Erreur");
+}
+
 int creatSem(int ftok_param, int taille)
 {
    key_t key = ftok(SEM, ftok_param);
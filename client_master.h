@@ -1,6 +1,8 @@
 #ifndef CLIENT_MASTER_H
 #define CLIENT_MASTER_H
 
+#include <sys/types.h>
+
 // ordres possibles du client pour le master
 #define CM_ORDER_NONE         -1
 #define CM_ORDER_STOP          0
@@ -11,10 +13,31 @@
 #define CM_ORDER_SUM          50
 #define CM_ORDER_INSERT       60
 #define CM_ORDER_INSERT_MANY  70
+#define CM_ORDER_INSERT_MANY_SHM 71   // tableau dans un segment partagé (cf. payloadCreate)
 #define CM_ORDER_PRINT        80
 #define CM_ORDER_LOCAL        90      // ne concerne pas le master
+#define CM_ORDER_LOCAL_STREAM 91      // ne concerne pas le master
+#define CM_ORDER_DEPTH       100
+#define CM_ORDER_RANGE       110      // ne concerne pas le master : RANGE_COUNT puis RANGE_SUM
+#define CM_ORDER_RANGE_COUNT 111      // suivi des bornes <a> et <b> de l'intervalle [a,b[
+#define CM_ORDER_RANGE_SUM   112      // idem
+#define CM_ORDER_KTH         120      // suivi du rang <k> (1 : le minimum)
+#define CM_ORDER_RANK        130      // suivi de l'élément <x>
+#define CM_ORDER_PERCENTILE  140      // suivi du pourcentage <p> (50 : la médiane)
+#define CM_ORDER_EXPORT      150
+#define CM_ORDER_SCAN        160      // suivi de l'élément de départ <after> (exclu) et du nombre maximal de paires
+                                      // (dans [1, CM_MAX_SCAN_LIMIT])
+#define CM_ORDER_SNAPSHOT    170      // suivi de la longueur du chemin du fichier puis du chemin (sans '\0')
+#define CM_ORDER_STATS       180
+
+// taille maximale d'un chemin transmis au master ('\0' compris)
+#define CM_PATH_SIZE        4096
+// plus grande page d'un parcours
+#define CM_MAX_SCAN_LIMIT   (1 << 20)
 
 // réponses possibles du master pour le client
+#define CM_ANSWER_SESSION_OK          1       // à l'annonce du client : session ouverte (cf. sessionOpen)
+#define CM_ANSWER_SESSION_REFUSED     2       // à l'annonce du client : trop de clients, le master ferme le tube
 #define CM_ANSWER_STOP_OK             0       // pour ORDER_STOP : arrêt effectué
 #define CM_ANSWER_HOW_MANY_OK        10       // pour ORDER_HOW_MANY : la/les réponses suivent
 #define CM_ANSWER_MINIMUM_OK         20       // pour ORDER_MINIMUM : la/les réponses suivent
@@ -25,12 +48,57 @@
 #define CM_ANSWER_EXIST_NO           41       // pour ORDER_EXIST : l'élément n'est pas présent
 #define CM_ANSWER_SUM_OK             50       // pour ORDER_SUM : la/les réponses suivent
 #define CM_ANSWER_INSERT_OK          60       // pour ORDER_INSERT : insertion effectuée
-#define CM_ANSWER_INSERT_MANY_OK     70       // pour ORDER_INSERT_MANY : insertions effectuées
+#define CM_ANSWER_INSERT_MANY_OK     70       // pour ORDER_INSERT_MANY(_SHM) : insertions effectuées
+#define CM_ANSWER_INSERT_MANY_ERROR  71       // pour ORDER_INSERT_MANY(_SHM) : nombre d'éléments annoncé non
+                                              // positif, ou qui ne correspond pas au corps de la trame (ou
+                                              // au segment : absent ou trop petit) ; rien n'est inséré
 #define CM_ANSWER_PRINT_OK           80       // pour ORDER_PRINT : affichage effectué
+#define CM_ANSWER_DEPTH_OK          100       // pour ORDER_DEPTH : la réponse (profondeur de l'arbre) suit
+#define CM_ANSWER_RANGE_COUNT_OK    111       // pour ORDER_RANGE_COUNT : la réponse (nombre d'éléments dans [a,b[) suit
+#define CM_ANSWER_RANGE_SUM_OK      112       // pour ORDER_RANGE_SUM : la réponse (somme des éléments de [a,b[) suit
+#define CM_ANSWER_KTH_OK            120       // pour ORDER_KTH et ORDER_PERCENTILE : la réponse (l'élément) suit
+#define CM_ANSWER_KTH_NONE          121       // pour ORDER_KTH et ORDER_PERCENTILE : rang hors de l'ensemble (ou ensemble vide)
+#define CM_ANSWER_RANK_OK           130       // pour ORDER_RANK : la réponse (nombre d'éléments < x) suit
+#define CM_ANSWER_EXPORT_OK         150       // pour ORDER_EXPORT : le nombre de paires puis les paires
+                                              // (élément float, cardinalité int) triées suivent
+#define CM_ANSWER_SCAN_OK           160       // pour ORDER_SCAN : le nombre de paires, 1 s'il y a une suite (0 sinon),
+                                              // le curseur (dernier élément de la page) puis les paires suivent
+#define CM_ANSWER_SCAN_ERROR        161       // pour ORDER_SCAN : nombre de paires hors de [1, CM_MAX_SCAN_LIMIT]
+#define CM_ANSWER_SNAPSHOT_OK       170       // pour ORDER_SNAPSHOT : le nombre d'éléments distincts écrits suit
+#define CM_ANSWER_SNAPSHOT_ERROR    171       // pour ORDER_SNAPSHOT : chemin incorrect, ou le fichier n'a pas pu
+                                              // être écrit
+#define CM_ANSWER_STATS_OK          180       // pour ORDER_STATS : le nombre de types d'ordre puis, pour chacun,
+                                              // ses histogrammes de latence (StOrderStats, cf. stats.h) suivent
 
 
+// Chaque client a ses propres tubes, suffixés par son PID (cf.
+// sessionPipeNames) ; il les crée, puis s'annonce au master en écrivant son
+// PID dans le tube d'enregistrement. Le master ouvre alors les tubes du
+// client et gère toutes les sessions en même temps.
+// Ordre des ouvertures (aucune ne bloque le master) :
+// - client : masterToClient en lecture (non bloquant), PID dans le tube
+//   d'enregistrement, attente de la réponse du master, puis clientToMaster
+//   en écriture (attend le master)
+// - master : masterToClient en écriture, réponse CM_ANSWER_SESSION_OK, puis
+//   clientToMaster en lecture ; sans session libre, la réponse est
+//   CM_ANSWER_SESSION_REFUSED et le master n'ouvre pas clientToMaster
+#define REGISTRATION                 "tubeRegistration"
 #define MASTER_TO_CLIENT             "tubeMasterToClient"
 #define CLIENT_TO_MASTER             "tubeClientToMaster"
+#define PIPE_NAME_SIZE               64
+
+// Un gros tableau (insertmany) ne passe pas par le tube : le client le
+// range dans un segment de mémoire partagée POSIX nommé d'après son PID et
+// n'envoie que le nombre d'éléments (CM_ORDER_INSERT_MANY_SHM). Le master
+// projette le segment et insère les éléments sur place, sans copie : de
+// l'envoi de l'ordre à l'accusé, le segment appartient au master, qui le
+// trie. Le client le supprime à la réception de l'accusé.
+#define PAYLOAD                      "clientPayload"
+#define PAYLOAD_THRESHOLD            (64 * 1024)   // octets, en dessous : dans la trame
+// corps le plus long d'un ordre (insertmany dans la trame : le nombre puis
+// moins de PAYLOAD_THRESHOLD octets) ; le master ferme la session d'un
+// client qui annonce une autre longueur
+#define CM_MAX_ORDER_LENGTH          ((int) sizeof(int) + PAYLOAD_THRESHOLD)
 
 #define SEM                          "client_master.h"
 #define PROJ_ID                      2
@@ -43,6 +111,23 @@
 // . communications
 //END TODO
 
+void sessionPipeNames(pid_t pid, char masterToClient[PIPE_NAME_SIZE], char clientToMaster[PIPE_NAME_SIZE]);
+// côté client : ouverture d'une session (cf. ordre des ouvertures
+// ci-dessus) ; elle est fermée par fr_close des deux descripteurs. Un
+// refus du master termine le client en erreur
+void sessionOpen(int *masterToClient, int *clientToMaster);
+
+// segment du client <pid> (<size> octets) : création et suppression par le
+// client, ouverture par le master ; payloadClose retire la projection.
+// payloadOpen renvoie NULL si le segment n'existe pas ou est plus petit que
+// <size> : la taille vient du client, la projeter sans vérifier exposerait
+// le master à SIGBUS
+void payloadName(pid_t pid, char name[PIPE_NAME_SIZE]);
+void * payloadCreate(pid_t pid, size_t size);
+void * payloadOpen(pid_t pid, size_t size);
+void payloadClose(void *payload, size_t size);
+void payloadDestroy(pid_t pid);
+
 int creatSem(int ftok_param, int taille);
 int recupSem();
 void entrerSC(int semId);
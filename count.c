@@ -0,0 +1,141 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "myassert.h"
+
+#include "count.h"
+
+// les noyaux vectoriels sont compilés pour leur jeu d'instructions seul
+// (attribut target) : le reste du programme n'en dépend pas
+#if defined __x86_64__ || defined __i386__
+#define CT_X86
+#include <immintrin.h>
+#endif
+
+
+/************************************************************************
+ * Noyaux
+ ************************************************************************/
+typedef int (*Kernel)(const float *tab, int nb, float elt);
+
+static int countScalar(const float *tab, int nb, float elt)
+{
+    int count = 0;
+    for (int i = 0; i < nb; i++)
+        count += (tab[i] == elt);
+    return count;
+}
+
+#ifdef CT_X86
+// une comparaison donne -1 (tous les bits à 1) dans chaque voie égale :
+// soustraire le masque incrémente le compteur de la voie
+__attribute__((target("sse2")))
+static int countSse2(const float *tab, int nb, float elt)
+{
+    __m128 e = _mm_set1_ps(elt);
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 8 <= nb; i += 8)
+    {
+        acc0 = _mm_sub_epi32(acc0, _mm_castps_si128(_mm_cmpeq_ps(_mm_loadu_ps(tab + i), e)));
+        acc1 = _mm_sub_epi32(acc1, _mm_castps_si128(_mm_cmpeq_ps(_mm_loadu_ps(tab + i + 4), e)));
+    }
+
+    int lanes[4];
+    _mm_storeu_si128((__m128i *) lanes, _mm_add_epi32(acc0, acc1));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + countScalar(tab + i, nb - i, elt);
+}
+
+__attribute__((target("avx2")))
+static int countAvx2(const float *tab, int nb, float elt)
+{
+    __m256 e = _mm256_set1_ps(elt);
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 16 <= nb; i += 16)
+    {
+        __m256 eq0 = _mm256_cmp_ps(_mm256_loadu_ps(tab + i), e, _CMP_EQ_OQ);
+        __m256 eq1 = _mm256_cmp_ps(_mm256_loadu_ps(tab + i + 8), e, _CMP_EQ_OQ);
+        acc0 = _mm256_sub_epi32(acc0, _mm256_castps_si256(eq0));
+        acc1 = _mm256_sub_epi32(acc1, _mm256_castps_si256(eq1));
+    }
+
+    int lanes[8];
+    _mm256_storeu_si256((__m256i *) lanes, _mm256_add_epi32(acc0, acc1));
+    int count = 0;
+    for (int l = 0; l < 8; l++)
+        count += lanes[l];
+    return count + countScalar(tab + i, nb - i, elt);
+}
+
+// AVX-512 : la comparaison donne directement un masque de 16 bits
+__attribute__((target("avx512f")))
+static int countAvx512(const float *tab, int nb, float elt)
+{
+    __m512 e = _mm512_set1_ps(elt);
+    int count = 0;
+    int i = 0;
+    for (; i + 32 <= nb; i += 32)
+    {
+        __mmask16 eq0 = _mm512_cmp_ps_mask(_mm512_loadu_ps(tab + i), e, _CMP_EQ_OQ);
+        __mmask16 eq1 = _mm512_cmp_ps_mask(_mm512_loadu_ps(tab + i + 16), e, _CMP_EQ_OQ);
+        count += __builtin_popcount(eq0) + __builtin_popcount(eq1);
+    }
+    return count + countScalar(tab + i, nb - i, elt);
+}
+#endif
+
+
+/************************************************************************
+ * Choix à l'exécution
+ ************************************************************************/
+// résolu une seule fois (ct_count est appelé par bloc, depuis plusieurs threads)
+static pthread_once_t kernelOnce = PTHREAD_ONCE_INIT;
+static Kernel kernel = NULL;
+static const char *kernelName = NULL;
+
+static void selectKernel()
+{
+    kernel = countScalar;
+    kernelName = "scalaire";
+#ifdef CT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        kernel = countAvx512;
+        kernelName = "avx512f";
+    }
+    else if (__builtin_cpu_supports("avx2"))
+    {
+        kernel = countAvx2;
+        kernelName = "avx2";
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        kernel = countSse2;
+        kernelName = "sse2";
+    }
+#endif
+}
+
+int ct_count(const float *tab, int nb, float elt)
+{
+    myassert(nb >= 0, "taille négative");
+    int ret = pthread_once(&kernelOnce, selectKernel);
+    myassert(ret == 0, "pthread_once");
+    return kernel(tab, nb, elt);
+}
+
+const char * ct_kernelName()
+{
+    int ret = pthread_once(&kernelOnce, selectKernel);
+    myassert(ret == 0, "pthread_once");
+    return kernelName;
+}
@@ -0,0 +1,21 @@
+#ifndef COUNT_H
+#define COUNT_H
+
+/************************************************************************
+ * Comptage des occurrences d'un float dans un tableau (client local)
+ *
+ * Le noyau compare plusieurs floats par instruction (AVX-512 : 16, AVX2 :
+ * 8, SSE2 : 4, deux comparaisons par tour) et cumule les masques obtenus ;
+ * il est choisi à l'exécution d'après le processeur, avec une version
+ * scalaire sur les autres architectures. Tous donnent le même résultat
+ * que tab[i] == elt (NaN n'est égal à rien, -0 est égal à 0).
+ ************************************************************************/
+
+// nombre d'éléments de tab[0..nb[ égaux à <elt>
+int ct_count(const float *tab, int nb, float elt);
+
+// nom du noyau choisi sur cette machine ("avx512f", "avx2", "sse2" ou
+// "scalaire")
+const char * ct_kernelName();
+
+#endif
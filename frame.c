@@ -0,0 +1,880 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include "myassert.h"
+#include "ring.h"
+
+#include "frame.h"
+
+// plus grand numéro de descripteur géré
+#define MAX_FD          1024
+// descripteurs joints à un même envoi
+#define MAX_PASSED         4
+// descripteurs reçus et pas encore lus
+#define MAX_RECEIVED      16
+// tours d'attente active sur un anneau avant de dormir sur la socket
+#define SPIN            2000
+
+
+/************************************************************************
+ * Etat par descripteur (alloué à la première utilisation)
+ ************************************************************************/
+typedef struct
+{
+    char buffer[FR_BUFFER_SIZE];
+    int size;                   // octets en attente d'envoi
+    int frameStart;             // début de la trame en cours, -1 hors trame
+    int passed[MAX_PASSED];     // descripteurs à joindre au prochain envoi
+    int nbPassed;
+
+    // non bloquant : octets qui n'ont pas pu partir, dans l'ordre
+    char *queue;
+    int queueStart;
+    int queueEnd;
+    int queueCapacity;
+    bool broken;                // lecteur parti : tout est jeté
+} Writer;
+
+typedef struct
+{
+    char small[FR_BUFFER_SIZE];
+    char *buffer;               // small, ou agrandi pour une grosse trame
+    int capacity;               // (non bloquant, cf. fr_receive)
+    int maxLength;              // non bloquant : corps le plus long accepté
+    int start;                  // octets lus du tampon
+    int end;                    // octets reçus dans le tampon
+    int remaining;              // corps de la trame courante restant à lire
+    int received[MAX_RECEIVED]; // descripteurs reçus (file)
+    int nbReceived;
+    bool notSocket;             // tube : read au lieu de recvmsg
+} Reader;
+
+static Writer *writers[MAX_FD];
+static Reader *readers[MAX_FD];
+// transport en mémoire partagée (NULL : les données passent par fd)
+static Ring *rings[MAX_FD];
+static bool nonBlocking[MAX_FD];
+static int maxFd = -1;
+static long nbSyscalls = 0;
+
+static Writer * getWriter(int fd)
+{
+    myassert(fd >= 0 && fd < MAX_FD, "descripteur hors limite");
+    if (writers[fd] == NULL)
+    {
+        writers[fd] = malloc(sizeof(Writer));
+        myassert(writers[fd] != NULL, "Erreur");
+        writers[fd]->size = 0;
+        writers[fd]->frameStart = -1;
+        writers[fd]->nbPassed = 0;
+        writers[fd]->queue = NULL;
+        writers[fd]->queueStart = 0;
+        writers[fd]->queueEnd = 0;
+        writers[fd]->queueCapacity = 0;
+        writers[fd]->broken = false;
+        if (fd > maxFd)
+            maxFd = fd;
+    }
+    return writers[fd];
+}
+
+static Reader * getReader(int fd)
+{
+    myassert(fd >= 0 && fd < MAX_FD, "descripteur hors limite");
+    if (readers[fd] == NULL)
+    {
+        readers[fd] = malloc(sizeof(Reader));
+        myassert(readers[fd] != NULL, "Erreur");
+        readers[fd]->buffer = readers[fd]->small;
+        readers[fd]->capacity = FR_BUFFER_SIZE;
+        readers[fd]->maxLength = 0;
+        readers[fd]->start = 0;
+        readers[fd]->end = 0;
+        readers[fd]->remaining = 0;
+        readers[fd]->nbReceived = 0;
+        readers[fd]->notSocket = false;
+    }
+    return readers[fd];
+}
+
+
+/************************************************************************
+ * Envoi
+ ************************************************************************/
+static bool ringWait(int fd, bool forSpace);
+
+// envoi des <size> premiers octets du tampon, suivis de <large> ; les
+// descripteurs joints partent avec le premier appel
+static void sendSocket(int fd, Writer *writer, int size, const void *large, int largeSize)
+{
+    struct iovec iov[2];
+    int nbIov = 0;
+    if (size > 0)
+    {
+        iov[nbIov].iov_base = writer->buffer;
+        iov[nbIov].iov_len = size;
+        nbIov++;
+    }
+    if (largeSize > 0)
+    {
+        iov[nbIov].iov_base = (void *) large;
+        iov[nbIov].iov_len = largeSize;
+        nbIov++;
+    }
+
+    int first = 0;
+    while (first < nbIov)
+    {
+        ssize_t ret;
+        if (writer->nbPassed > 0)
+        {
+            char control[CMSG_SPACE(MAX_PASSED * sizeof(int))];
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            memset(control, 0, sizeof(control));
+            msg.msg_iov = iov + first;
+            msg.msg_iovlen = nbIov - first;
+            msg.msg_control = control;
+            msg.msg_controllen = CMSG_SPACE(writer->nbPassed * sizeof(int));
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(writer->nbPassed * sizeof(int));
+            memcpy(CMSG_DATA(cmsg), writer->passed, writer->nbPassed * sizeof(int));
+            ret = sendmsg(fd, &msg, 0);
+        }
+        else
+            ret = writev(fd, iov + first, nbIov - first);
+        nbSyscalls++;
+
+        if (ret == -1 && errno == EINTR)
+            continue;
+        myassert(ret > 0, "écriture d'une trame");
+        writer->nbPassed = 0;
+
+        // écriture partielle (gros envoi sur un tube) : on continue
+        while (first < nbIov && ret >= (ssize_t) iov[first].iov_len)
+        {
+            ret -= iov[first].iov_len;
+            first++;
+        }
+        if (first < nbIov)
+        {
+            iov[first].iov_base = (char *) iov[first].iov_base + ret;
+            iov[first].iov_len -= ret;
+        }
+    }
+}
+
+// coup de sonnette sur la socket d'un anneau (avec les descripteurs joints
+// en attente : ils précèdent ainsi leur trame)
+static void ringBell(int fd)
+{
+    char bell = 0;
+    sendSocket(fd, getWriter(fd), 0, &bell, 1);
+}
+
+static void ringPut(int fd, const char *data, int size)
+{
+    while (size > 0)
+    {
+        int nb = rg_write(rings[fd], data, size);
+        if (nb == 0)
+        {
+            bool ok = ringWait(fd, true);
+            myassert(ok, "anneau plein et lecteur parti");
+            continue;
+        }
+        data += nb;
+        size -= nb;
+        if (rg_wakeNeeded(rings[fd]))
+            ringBell(fd);
+    }
+}
+
+// descripteur non bloquant : un appel sans attendre ; renvoie les octets
+// envoyés, 0 si le tube est plein ou si le lecteur est parti
+static int sendNow(int fd, Writer *writer, struct iovec *iov, int nbIov)
+{
+    while (true)
+    {
+        ssize_t ret = writev(fd, iov, nbIov);
+        nbSyscalls++;
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        if (ret == -1 && errno == EPIPE)
+        {
+            writer->broken = true;
+            return 0;
+        }
+        myassert(ret >= 0, "écriture d'une trame");
+        return ret;
+    }
+}
+
+static void queueBytes(Writer *writer, const char *data, int size)
+{
+    if (size <= 0)
+        return;
+    if (writer->queueEnd + size > writer->queueCapacity)
+    {
+        // d'abord la place de ce qui est déjà parti
+        memmove(writer->queue, writer->queue + writer->queueStart, writer->queueEnd - writer->queueStart);
+        writer->queueEnd -= writer->queueStart;
+        writer->queueStart = 0;
+    }
+    if (writer->queueEnd + size > writer->queueCapacity)
+    {
+        int capacity = 2 * writer->queueCapacity;
+        if (capacity < writer->queueEnd + size)
+            capacity = writer->queueEnd + size;
+        writer->queue = realloc(writer->queue, capacity);
+        myassert(writer->queue != NULL, "Erreur");
+        writer->queueCapacity = capacity;
+    }
+    memcpy(writer->queue + writer->queueEnd, data, size);
+    writer->queueEnd += size;
+}
+
+// la file part autant que le tube le permet
+static void sendQueue(int fd, Writer *writer)
+{
+    while (writer->queueEnd > writer->queueStart && ! writer->broken)
+    {
+        struct iovec iov = { writer->queue + writer->queueStart, writer->queueEnd - writer->queueStart };
+        int ret = sendNow(fd, writer, &iov, 1);
+        if (ret == 0)
+            break;
+        writer->queueStart += ret;
+    }
+    if (writer->queueEnd == writer->queueStart || writer->broken)
+        writer->queueStart = writer->queueEnd = 0;
+}
+
+// ce qui ne part pas tout de suite attend dans la file, derrière ce qui y
+// est déjà (cf. fr_pending)
+static void sendNonBlocking(int fd, Writer *writer, int size, const void *large, int largeSize)
+{
+    myassert(writer->nbPassed == 0, "descripteur joint sur un descripteur non bloquant");
+    sendQueue(fd, writer);
+
+    int sent = 0;
+    if (writer->queueEnd == 0 && ! writer->broken)
+    {
+        struct iovec iov[2] = { { writer->buffer, size }, { (void *) large, largeSize } };
+        sent = sendNow(fd, writer, iov, (largeSize > 0) ? 2 : 1);
+    }
+    if (writer->broken)
+        return;
+
+    if (sent < size)
+        queueBytes(writer, writer->buffer + sent, size - sent);
+    sent = (sent > size) ? sent - size : 0;
+    queueBytes(writer, (const char *) large + sent, largeSize - sent);
+}
+
+static void sendBuffer(int fd, Writer *writer, int size, const void *large, int largeSize)
+{
+    if (nonBlocking[fd])
+    {
+        sendNonBlocking(fd, writer, size, large, largeSize);
+        return;
+    }
+    if (rings[fd] == NULL)
+    {
+        sendSocket(fd, writer, size, large, largeSize);
+        return;
+    }
+
+    if (writer->nbPassed > 0)
+        ringBell(fd);
+    ringPut(fd, writer->buffer, size);
+    ringPut(fd, large, largeSize);
+}
+
+// envoi des trames complètes du tampon
+void fr_flush(int fd)
+{
+    if (fd < 0 || fd >= MAX_FD || writers[fd] == NULL)
+        return;
+    Writer *writer = writers[fd];
+    if (nonBlocking[fd])
+        sendQueue(fd, writer);
+
+    int complete = (writer->frameStart == -1) ? writer->size : writer->frameStart;
+    if (complete == 0)
+        return;
+
+    sendBuffer(fd, writer, complete, NULL, 0);
+    memmove(writer->buffer, writer->buffer + complete, writer->size - complete);
+    writer->size -= complete;
+    if (writer->frameStart != -1)
+        writer->frameStart = 0;
+}
+
+void fr_flushAll()
+{
+    for (int fd = 0; fd <= maxFd; fd++)
+        fr_flush(fd);
+}
+
+static void ensureRoom(int fd, Writer *writer, int size)
+{
+    if (writer->size + size <= FR_BUFFER_SIZE)
+        return;
+    fr_flush(fd);
+    myassert(writer->size + size <= FR_BUFFER_SIZE, "trame trop grande (cf. fr_endLarge)");
+}
+
+void fr_begin(int fd, int opcode, int reqId)
+{
+    Writer *writer = getWriter(fd);
+    myassert(writer->frameStart == -1, "trame précédente non terminée");
+
+    FrameHeader header = { opcode, 0, reqId };
+    ensureRoom(fd, writer, sizeof(FrameHeader));
+    writer->frameStart = writer->size;
+    memcpy(writer->buffer + writer->size, &header, sizeof(FrameHeader));
+    writer->size += sizeof(FrameHeader);
+}
+
+void fr_put(int fd, const void *data, int size)
+{
+    Writer *writer = getWriter(fd);
+    myassert(writer->frameStart != -1, "écriture hors trame");
+
+    ensureRoom(fd, writer, size);
+    memcpy(writer->buffer + writer->size, data, size);
+    writer->size += size;
+}
+
+void fr_putInt(int fd, int value)
+{
+    fr_put(fd, &value, sizeof(int));
+}
+
+void fr_putFloat(int fd, float value)
+{
+    fr_put(fd, &value, sizeof(float));
+}
+
+static void attachFd(int fd, int fdToPass)
+{
+    Writer *writer = getWriter(fd);
+    myassert(writer->frameStart != -1, "écriture hors trame");
+    if (writer->nbPassed == MAX_PASSED)
+        fr_flush(fd);
+    writer->passed[writer->nbPassed] = fdToPass;
+    writer->nbPassed++;
+}
+
+// un descripteur qui porte un anneau part avec sa projection (et son côté)
+void fr_putFd(int fd, int fdToPass)
+{
+    Ring *ring = rings[fdToPass];
+    fr_putInt(fd, (ring == NULL) ? 0 : 1 + rg_side(ring));
+    attachFd(fd, fdToPass);
+    if (ring != NULL)
+        attachFd(fd, rg_memfd(ring));
+}
+
+static void setLength(Writer *writer, int length)
+{
+    FrameHeader *header = (FrameHeader *) (writer->buffer + writer->frameStart);
+    header->length = length;
+    writer->frameStart = -1;
+}
+
+void fr_end(int fd)
+{
+    Writer *writer = getWriter(fd);
+    myassert(writer->frameStart != -1, "fin hors trame");
+    setLength(writer, writer->size - writer->frameStart - sizeof(FrameHeader));
+}
+
+void fr_endLarge(int fd, const void *data, int size)
+{
+    Writer *writer = getWriter(fd);
+    myassert(writer->frameStart != -1, "fin hors trame");
+    setLength(writer, writer->size - writer->frameStart - sizeof(FrameHeader) + size);
+
+    // tampon et gros corps en un seul appel (writev)
+    sendBuffer(fd, writer, writer->size, data, size);
+    writer->size = 0;
+}
+
+
+/************************************************************************
+ * Réception
+ ************************************************************************/
+// un appel système de lecture ; les descripteurs joints sont mis en file
+// <flags> : MSG_DONTWAIT pour ne pas attendre (renvoie alors -1 si rien)
+static int receiveSocket(int fd, Reader *reader, void *buf, int size, int flags)
+{
+    while (true)
+    {
+        ssize_t ret;
+        if (reader->notSocket)
+            ret = read(fd, buf, size);
+        else
+        {
+            char control[CMSG_SPACE(MAX_PASSED * sizeof(int))];
+            struct iovec iov = { buf, size };
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            ret = recvmsg(fd, &msg, flags);
+
+            if (ret == -1 && errno == ENOTSOCK)
+            {
+                reader->notSocket = true;
+                continue;
+            }
+            if (ret > 0)
+            {
+                struct cmsghdr *cmsg;
+                for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+                {
+                    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+                        continue;
+                    int nb = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                    myassert(reader->nbReceived + nb <= MAX_RECEIVED, "trop de descripteurs reçus");
+                    memcpy(reader->received + reader->nbReceived, CMSG_DATA(cmsg), nb * sizeof(int));
+                    for (int i = 0; i < nb; i++)
+                    {
+                        int r = fcntl(reader->received[reader->nbReceived + i], F_SETFD, FD_CLOEXEC);
+                        myassert(r != -1, "Erreur");
+                    }
+                    reader->nbReceived += nb;
+                }
+            }
+        }
+        nbSyscalls++;
+
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret == -1 && (flags & MSG_DONTWAIT) && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return -1;
+        myassert(ret >= 0, "lecture d'une trame");
+        return ret;
+    }
+}
+
+// attente active, puis sommeil sur la socket jusqu'à un coup de sonnette
+// (les octets de sonnette sont jetés) ; renvoie false si l'autre côté est
+// parti sans que la condition soit remplie
+static bool ringReady(int fd, bool forSpace)
+{
+    return forSpace ? rg_canWrite(rings[fd]) : rg_canRead(rings[fd]);
+}
+
+static bool ringWait(int fd, bool forSpace)
+{
+    for (int i = 0; i < SPIN; i++)
+        if (ringReady(fd, forSpace))
+            return true;
+
+    Ring *ring = rings[fd];
+    while (true)
+    {
+        rg_sleep(ring);
+        if (ringReady(fd, forSpace))
+            break;
+        char bells[64];
+        if (receiveSocket(fd, getReader(fd), bells, sizeof(bells), 0) == 0)
+            break;
+    }
+    rg_wake(ring);
+    return ringReady(fd, forSpace);
+}
+
+// au moins un octet de l'anneau (0 : fin de l'autre côté)
+static int receiveRing(int fd, void *buf, int size)
+{
+    while (true)
+    {
+        int nb = rg_read(rings[fd], buf, size);
+        if (nb > 0)
+        {
+            if (rg_wakeNeeded(rings[fd]))
+                ringBell(fd);
+            return nb;
+        }
+        if (! ringWait(fd, false))
+            return 0;
+    }
+}
+
+static int receive(int fd, Reader *reader, void *buf, int size)
+{
+    // on ne bloque jamais avec des écritures en attente
+    fr_flushAll();
+
+    if (rings[fd] != NULL)
+        return receiveRing(fd, buf, size);
+    return receiveSocket(fd, reader, buf, size, 0);
+}
+
+// au moins <size> octets dans le tampon ; false si fin du descripteur
+static bool fill(int fd, Reader *reader, int size)
+{
+    if (reader->end - reader->start >= size)
+        return true;
+
+    memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+    reader->end -= reader->start;
+    reader->start = 0;
+
+    while (reader->end < size)
+    {
+        int ret = receive(fd, reader, reader->buffer + reader->end, reader->capacity - reader->end);
+        if (ret == 0)
+            return false;
+        reader->end += ret;
+    }
+    return true;
+}
+
+bool fr_next(int fd, FrameHeader *header)
+{
+    Reader *reader = getReader(fd);
+    myassert(reader->remaining == 0, "corps de la trame précédente non lu");
+
+    if (! fill(fd, reader, sizeof(FrameHeader)))
+    {
+        myassert(reader->end == reader->start, "trame tronquée");
+        return false;
+    }
+    memcpy(header, reader->buffer + reader->start, sizeof(FrameHeader));
+    reader->start += sizeof(FrameHeader);
+    reader->remaining = header->length;
+    return true;
+}
+
+void fr_get(int fd, void *data, int size)
+{
+    Reader *reader = getReader(fd);
+    myassert(size <= reader->remaining, "lecture au-delà de la trame");
+    reader->remaining -= size;
+
+    // d'abord ce qui est dans le tampon
+    int available = reader->end - reader->start;
+    int nb = (size < available) ? size : available;
+    memcpy(data, reader->buffer + reader->start, nb);
+    reader->start += nb;
+    data = (char *) data + nb;
+    size -= nb;
+
+    // gros corps : directement à destination, sinon via le tampon
+    while (size >= FR_BUFFER_SIZE)
+    {
+        int ret = receive(fd, reader, data, size);
+        myassert(ret > 0, "trame tronquée");
+        data = (char *) data + ret;
+        size -= ret;
+    }
+    if (size > 0)
+    {
+        bool ok = fill(fd, reader, size);
+        myassert(ok, "trame tronquée");
+        memcpy(data, reader->buffer + reader->start, size);
+        reader->start += size;
+    }
+}
+
+// longueur annoncée par l'en-tête arrivé à la position <pos> du tampon
+static int lengthAt(const Reader *reader, int pos)
+{
+    FrameHeader header;
+    memcpy(&header, reader->buffer + pos, sizeof(FrameHeader));
+    return header.length;
+}
+
+// la longueur vient de l'autre côté : elle est vérifiée avant de s'en servir
+static bool validLength(const Reader *reader, int length)
+{
+    return length >= 0 && length <= reader->maxLength;
+}
+
+// tous les en-têtes arrivés annoncent-ils un corps acceptable
+static bool headersValid(const Reader *reader)
+{
+    int pos = reader->start;
+    while (reader->end - pos >= (int) sizeof(FrameHeader))
+    {
+        int length = lengthAt(reader, pos);
+        if (! validLength(reader, length))
+            return false;
+        pos += sizeof(FrameHeader) + length;
+    }
+    return true;
+}
+
+// les octets non lus passent au début d'un tampon de <capacity> octets
+// (small pour FR_BUFFER_SIZE)
+static void resize(Reader *reader, int capacity)
+{
+    int unread = reader->end - reader->start;
+    char *buffer = reader->buffer;
+    if (capacity != reader->capacity)
+    {
+        buffer = (capacity == FR_BUFFER_SIZE) ? reader->small : malloc(capacity);
+        myassert(buffer != NULL, "Erreur");
+    }
+    memmove(buffer, reader->buffer + reader->start, unread);
+    if (buffer != reader->buffer && reader->buffer != reader->small)
+        free(reader->buffer);
+    reader->buffer = buffer;
+    reader->capacity = capacity;
+    reader->start = 0;
+    reader->end = unread;
+}
+
+bool fr_receive(int fd, int maxLength)
+{
+    Reader *reader = getReader(fd);
+    myassert(nonBlocking[fd], "descripteur bloquant");
+    myassert(reader->remaining == 0, "corps de la trame précédente non lu");
+    reader->maxLength = maxLength;
+
+    // un tampon agrandi reprend sa taille dès qu'il le peut
+    int unread = reader->end - reader->start;
+    resize(reader, (unread <= FR_BUFFER_SIZE) ? FR_BUFFER_SIZE : reader->capacity);
+
+    bool open = true;
+    while (open)
+    {
+        // tampon plein : soit la première trame est entière (la suite
+        // attendra qu'elle soit lue), soit il lui faut plus de place
+        if (reader->end == reader->capacity)
+        {
+            int length = lengthAt(reader, reader->start);
+            if (! validLength(reader, length))
+                return false;
+            int size = sizeof(FrameHeader) + length;
+            if (size <= reader->end)
+                break;
+            resize(reader, size);
+        }
+        int ret = receiveSocket(fd, reader, reader->buffer + reader->end, reader->capacity - reader->end,
+                                MSG_DONTWAIT);
+        if (ret == -1)
+            break;
+        if (ret == 0)
+            open = false;
+        reader->end += (ret > 0) ? ret : 0;
+    }
+    return open && headersValid(reader);
+}
+
+bool fr_complete(int fd)
+{
+    if (fd < 0 || fd >= MAX_FD || readers[fd] == NULL)
+        return false;
+    Reader *reader = readers[fd];
+    myassert(reader->remaining == 0, "corps de la trame précédente non lu");
+    int unread = reader->end - reader->start;
+    if (unread < (int) sizeof(FrameHeader))
+        return false;
+    int length = lengthAt(reader, reader->start);
+    return validLength(reader, length) && unread - (int) sizeof(FrameHeader) >= length;
+}
+
+int fr_getInt(int fd)
+{
+    int value;
+    fr_get(fd, &value, sizeof(int));
+    return value;
+}
+
+float fr_getFloat(int fd)
+{
+    float value;
+    fr_get(fd, &value, sizeof(float));
+    return value;
+}
+
+int fr_remaining(int fd)
+{
+    return getReader(fd)->remaining;
+}
+
+void fr_skip(int fd)
+{
+    char skipped[FR_BUFFER_SIZE];
+    Reader *reader = getReader(fd);
+    while (reader->remaining > 0)
+        fr_get(fd, skipped, (reader->remaining < FR_BUFFER_SIZE) ? reader->remaining : FR_BUFFER_SIZE);
+}
+
+static int detachFd(int fd)
+{
+    Reader *reader = getReader(fd);
+
+    // sur un anneau, les descripteurs arrivent par la socket, avec une
+    // sonnette envoyée avant la trame
+    while (reader->nbReceived == 0 && rings[fd] != NULL)
+    {
+        char bells[64];
+        int ret = receiveSocket(fd, reader, bells, sizeof(bells), 0);
+        myassert(ret > 0, "descripteur attendu");
+    }
+    myassert(reader->nbReceived > 0, "descripteur attendu");
+
+    int passed = reader->received[0];
+    reader->nbReceived--;
+    memmove(reader->received, reader->received + 1, reader->nbReceived * sizeof(int));
+    return passed;
+}
+
+int fr_getFd(int fd)
+{
+    int ringSide = fr_getInt(fd);
+    int passed = detachFd(fd);
+    if (ringSide != 0)
+    {
+        myassert(rings[passed] == NULL, "anneau déjà présent");
+        rings[passed] = rg_map(detachFd(fd), ringSide - 1);
+    }
+    return passed;
+}
+
+bool fr_hasData(int fd)
+{
+    if (fd < 0 || fd >= MAX_FD)
+        return false;
+    if (readers[fd] != NULL && readers[fd]->end > readers[fd]->start)
+        return true;
+    return rings[fd] != NULL && rg_canRead(rings[fd]);
+}
+
+bool fr_sleep(int fd)
+{
+    if (fd < 0 || fd >= MAX_FD)
+        return true;
+    if (fr_hasData(fd))
+        return false;
+    if (rings[fd] != NULL)
+    {
+        rg_sleep(rings[fd]);
+        if (rg_canRead(rings[fd]))
+        {
+            rg_wake(rings[fd]);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool fr_ready(int fd)
+{
+    if (rings[fd] == NULL)
+        return true;
+
+    // sonnettes sans attendre ; la fin de l'autre côté compte comme prêt
+    // (fr_next la verra)
+    char bells[64];
+    int ret;
+    while ((ret = receiveSocket(fd, getReader(fd), bells, sizeof(bells), MSG_DONTWAIT)) > 0)
+        ;
+    rg_wake(rings[fd]);
+    return ret == 0 || fr_hasData(fd);
+}
+
+
+/************************************************************************
+ * Anneaux
+ ************************************************************************/
+int fr_ringCreate(int fd)
+{
+    myassert(fd >= 0 && fd < MAX_FD && rings[fd] == NULL, "anneau déjà présent");
+    int memfd;
+    rings[fd] = rg_create(&memfd);
+    return memfd;
+}
+
+void fr_ringAttach(int fd, int memfd)
+{
+    myassert(fd >= 0 && fd < MAX_FD && rings[fd] == NULL, "anneau déjà présent");
+    rings[fd] = rg_map(memfd, 1);
+}
+
+
+/************************************************************************
+ * Divers
+ ************************************************************************/
+void fr_setNonBlocking(int fd)
+{
+    myassert(fd >= 0 && fd < MAX_FD && rings[fd] == NULL, "anneau non bloquant");
+    int flags = fcntl(fd, F_GETFL);
+    myassert(flags != -1, "Erreur");
+    int ret = fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    myassert(ret != -1, "Erreur");
+    nonBlocking[fd] = true;
+}
+
+bool fr_pending(int fd)
+{
+    if (fd < 0 || fd >= MAX_FD || writers[fd] == NULL)
+        return false;
+    return writers[fd]->queueEnd > writers[fd]->queueStart;
+}
+
+void fr_close(int fd)
+{
+    myassert(fd >= 0 && fd < MAX_FD, "descripteur hors limite");
+
+    // fd peut être joint à une trame en attente sur un autre descripteur :
+    // il doit partir avant d'être fermé
+    fr_flushAll();
+
+    if (writers[fd] != NULL)
+    {
+        myassert(writers[fd]->frameStart == -1, "trame non terminée");
+        free(writers[fd]->queue);
+        free(writers[fd]);
+        writers[fd] = NULL;
+    }
+    if (readers[fd] != NULL)
+    {
+        // l'autre côté d'un descripteur non bloquant peut partir au milieu
+        // d'une trame
+        myassert(nonBlocking[fd] || (readers[fd]->end == readers[fd]->start && readers[fd]->nbReceived == 0),
+                 "données reçues non lues");
+        if (readers[fd]->buffer != readers[fd]->small)
+            free(readers[fd]->buffer);
+        free(readers[fd]);
+        readers[fd] = NULL;
+    }
+    if (rings[fd] != NULL)
+    {
+        rg_unmap(rings[fd]);
+        rings[fd] = NULL;
+    }
+    nonBlocking[fd] = false;
+
+    int ret = close(fd);
+    myassert(ret == 0, "Erreur");
+}
+
+long fr_syscalls()
+{
+    return nbSyscalls;
+}
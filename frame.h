@@ -0,0 +1,106 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdbool.h>
+
+/************************************************************************
+ * Messages tramés sur un descripteur (tube ou socket locale)
+ *
+ * Une trame est un en-tête (code, taille du corps, numéro de requête)
+ * suivi du corps. Les écritures sont accumulées dans un tampon par
+ * descripteur et envoyées d'un coup (writev, ou sendmsg si des
+ * descripteurs sont joints) ; les lectures passent par un tampon par
+ * descripteur : plusieurs trames arrivent en un seul appel système.
+ *
+ * Règles :
+ * - une trame (hors fr_endLarge) tient dans le tampon ; un envoi de
+ *   moins de FR_BUFFER_SIZE (== PIPE_BUF) octets est atomique, des
+ *   écrivains concurrents sur un même tube ne mélangent pas leurs trames
+ * - avant toute lecture bloquante, toutes les écritures en attente du
+ *   processus sont envoyées (pas d'interblocage dû aux tampons)
+ * - un descripteur tramé est fermé par fr_close (qui oublie son état,
+ *   le numéro pouvant être réutilisé)
+ *
+ * Une socket locale peut porter un anneau en mémoire partagée (cf. ring.h,
+ * fr_ringCreate) : les trames passent alors par l'anneau, la socket ne sert
+ * plus qu'à réveiller l'autre côté et à transmettre les descripteurs.
+ * Avant d'attendre avec poll, il faut l'annoncer (fr_sleep) et, au réveil,
+ * vérifier qu'une trame est bien là (fr_ready).
+ *
+ * Un descripteur non bloquant (fr_setNonBlocking, tube d'un client dans le
+ * master) n'attend jamais : fr_receive lit ce qui est arrivé, et une trame
+ * n'est lue qu'une fois entière (fr_complete) ; ce qui ne peut pas partir
+ * attend dans une file (fr_pending) que fr_flush enverra quand il y aura
+ * de la place. Un lecteur parti fait jeter les envois (SIGPIPE doit être
+ * ignoré).
+ ************************************************************************/
+
+#define FR_BUFFER_SIZE 4096
+
+typedef struct
+{
+    int opcode;         // ordre ou réponse (CM_*, MW_*)
+    int length;         // taille du corps en octets
+    int reqId;          // numéro de requête (0 si sans objet)
+} FrameHeader;
+
+// écriture d'une trame : fr_begin, puis le corps, puis fr_end ou fr_endLarge
+void fr_begin(int fd, int opcode, int reqId);
+void fr_put(int fd, const void *data, int size);
+void fr_putInt(int fd, int value);
+void fr_putFloat(int fd, float value);
+// descripteur joint à l'envoi (SCM_RIGHTS, socket locale uniquement) ;
+// son anneau éventuel part avec lui
+void fr_putFd(int fd, int fdToPass);
+void fr_end(int fd);
+// dernier élément du corps, volumineux : il n'est pas copié, la trame est
+// envoyée immédiatement
+void fr_endLarge(int fd, const void *data, int size);
+
+// envoi de ce qui est en attente (sur un descripteur ou sur tous)
+void fr_flush(int fd);
+void fr_flushAll();
+
+// lecture d'une trame : fr_next, puis le corps en entier dans l'ordre
+// renvoie false si le descripteur est fermé à la place d'une trame
+bool fr_next(int fd, FrameHeader *header);
+void fr_get(int fd, void *data, int size);
+int fr_getInt(int fd);
+float fr_getFloat(int fd);
+// descripteur joint à la trame (dans l'ordre d'envoi), close-on-exec
+int fr_getFd(int fd);
+// octets du corps de la trame en cours pas encore lus, et abandon de ces
+// octets (trame refusée)
+int fr_remaining(int fd);
+void fr_skip(int fd);
+
+// descripteur non bloquant (cf. ci-dessus), jusqu'à fr_close
+void fr_setNonBlocking(int fd);
+// lecture de ce qui est arrivé, sans attendre ; false si l'autre côté a
+// fermé ou a annoncé un corps négatif ou de plus de <maxLength> octets (les
+// trames entières qui précèdent peuvent rester à lire)
+bool fr_receive(int fd, int maxLength);
+// une trame entière et valide (cf. fr_receive) attend : fr_next et fr_get
+// ne bloqueront pas
+bool fr_complete(int fd);
+// des octets attendent que le descripteur ait de la place
+bool fr_pending(int fd);
+
+// des octets sont-ils déjà lus (poll ne le signalera pas)
+bool fr_hasData(int fd);
+// avant poll : false s'il ne faut pas attendre (données déjà là)
+bool fr_sleep(int fd);
+// après poll (fd signalé) : false si ce n'était qu'un réveil sans trame
+bool fr_ready(int fd);
+
+// anneau sur la socket <fd> ; fr_ringCreate renvoie le memfd à transmettre
+// à l'autre extrémité, qui appelle fr_ringAttach
+int fr_ringCreate(int fd);
+void fr_ringAttach(int fd, int memfd);
+
+void fr_close(int fd);
+
+// nombre d'appels système de lecture/écriture faits par ce module
+long fr_syscalls();
+
+#endif
@@ -7,6 +7,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <signal.h>
 #include <unistd.h>
 
 #include <sys/types.h>
@@ -14,36 +18,185 @@
 
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
 
 #include <sys/ipc.h>
 #include <sys/sem.h>
 
 #include "utils.h"
 #include "myassert.h"
+#include "frame.h"
 
 #include "client_master.h"
 #include "master_worker.h"
+#include "tree.h"
+#include "snapshot.h"
+#include "wal.h"
+#include "stats.h"
+
+// moteurs possibles pour stocker l'ensemble
+#define ENGINE_WORKERS    0     // un worker (processus) par bloc d'éléments distincts
+#define ENGINE_ARENA      1     // arbre en mémoire dans le master (cf. tree.h)
+
+#define TK_ENGINE         "--engine"
+#define TK_ENGINE_WORKERS "workers"
+#define TK_ENGINE_ARENA   "arena"
+#define TK_TRANSPORT      "--transport"
+#define TK_LOAD           "--load"
+#define TK_WAL            "--wal"
+#define TK_SHARDS         "--shards"
+#define TK_POOL           "--pool"
+
+// nombre maximal de requêtes en cours dans l'arbre de workers
+#define MAX_PENDING       1024
+// nombre maximal de clients connectés simultanément
+#define MAX_SESSIONS       128
+// nombre maximal d'arbres de workers indépendants (cf. Shard)
+#define MAX_SHARDS          16
+// nombre maximal de zygotes (cf. MW_ZYGOTE)
+#define MAX_ZYGOTES         16
+// zygotes par défaut
+#define DEFAULT_ZYGOTES      1
+// identifiants epoll des canaux qui ne sont pas des sessions (les
+// sessions sont identifiées par leur indice)
+#define EV_REGISTRATION   (MAX_SESSIONS)
+#define EV_WORKERS        (MAX_SESSIONS + 1)
+#define EV_SHARDS         (MAX_SESSIONS + 2)    // plus l'indice du shard
+#define EV_OUTPUT         (EV_SHARDS + MAX_SHARDS)  // plus l'indice de la session :
+                                                    // son tube de réponses a de la place
+#define MAX_EVENTS          32
+// types d'ordre suivis (cf. CM_ORDER_*), réponses en attente d'écriture
+// par session
+#define MAX_ORDER_STATS     32
+#define MAX_UNFLUSHED       64
 
 /************************************************************************
- * Données persistantes d'un master
+ * Statistiques de latence par type d'ordre (ordre stats, cf. stats.h)
+ ************************************************************************/
+typedef struct
+{
+    StOrderStats orders[MAX_ORDER_STATS];   // dans l'ordre de première apparition
+    int nbOrders;
+} Stats;
+
+// chronométrage de l'ordre en cours : il suit l'ordre jusqu'à sa réponse,
+// y compris dans une requête terminée plus tard (cf. completeRequest)
+typedef struct
+{
+    int order;                      // CM_ORDER_*
+    double ready;                   // ordre signalé par epoll (début du tour)
+    double start;                   // début de son traitement
+} Timer;
+
+// réponse prête, pas encore écrite dans le tube du client
+typedef struct
+{
+    StOrderStats *stats;
+    double answered;
+} Unflushed;
+
+/************************************************************************
+ * Session avec un client (cf. client_master.h)
  ************************************************************************/
 typedef struct
 {
-    // communication avec le client
+    pid_t pid;                      // -1 : case libre
     int masterToClient;
     int clientToMaster;
+    int nbPending;                  // requêtes du client en cours dans l'arbre
+    bool closing;                   // le client est parti : fermeture dès que nbPending == 0
+    int nbUnsynced;                 // accusés d'insertion qui attendent la
+    int unsyncedAck;                // synchronisation du journal (tous identiques)
+
+    Stats *stats;                   // celles du master
+    Timer timer;                    // ordre en cours
+    Unflushed unflushed[MAX_UNFLUSHED];
+    int nbUnflushed;
+    bool output;                    // réponses en file : masterToClient surveillé (EPOLLOUT)
+} Session;
 
-    // données internes
-    pid_t firstWorkerPid;           // Process ID du premier worker
-    int semWait;
+/************************************************************************
+ * Shard : arbre de workers indépendant, qui stocke une tranche des clés
+ ************************************************************************/
+typedef struct
+{
+    pid_t firstWorkerPid;           // -1 : tranche vide (pas de premier worker)
+    int nbElements;                 // compté par le master à chaque insertion
 
     // communication avec le premier worker (double tubes)
     int masterToFirstWorker[2];
     int firstWorkerToMaster[2];
+} Shard;
+
+/************************************************************************
+ * Requête en cours dans l'arbre de workers
+ ************************************************************************/
+// une requête envoyée à plusieurs shards attend une réponse de chacun ;
+// les résultats sont cumulés au fur et à mesure (cf. receiveFirstWorkerAnswer)
+typedef struct
+{
+    int reqId;                      // 0 : case libre
+    int order;                      // MW_ORDER_*
+    int nbAnswers;                  // réponses encore attendues
+    bool done;                      // toutes les réponses sont arrivées
+    int answer;                     // MW_ANSWER_*
+    int results[2];                 // quantités (how many, exist, depth)
+    float value;                    // minimum, maximum, somme
+    ExportEntry *entries;           // parcours : les paires reçues (à libérer)
+    Session *session;               // client à qui répondre à l'arrivée de la
+                                    // réponse, NULL si la réponse est attendue
+    Timer timer;                    // ordre du client (si session != NULL)
+} Request;
+
+/************************************************************************
+ * Données persistantes d'un master
+ ************************************************************************/
+typedef struct
+{
+    // communication avec les clients : tube d'enregistrement (ouvert aussi
+    // en écriture pour ne jamais en voir la fin) et une session par client
+    int registration;
+    int registrationKeepAlive;
+    Session sessions[MAX_SESSIONS];
+    int epoll;
+
+    // données internes
+    int engine;                     // ENGINE_WORKERS ou ENGINE_ARENA
+    bool ring;                      // arêtes entre workers en mémoire partagée
+    const char *loadPath;           // instantané à charger au démarrage (NULL : aucun)
+    const char *walPath;            // journal des insertions (NULL : aucun)
+    Wal *wal;
+    Tree *tree;                     // ensemble si engine == ENGINE_ARENA
+    int semWait;
+
+    // arbres de workers : le shard i stocke les éléments de
+    // [bounds[i-1], bounds[i][ (pas de borne aux extrémités)
+    Shard shards[MAX_SHARDS];
+    int nbShards;
+    float bounds[MAX_SHARDS - 1];
 
     // communication en provenance de tous les workers (un seul tube en lecture)
     int workersToMaster[2];
 
+    // zygotes qui créent les workers sans exec (cf. MW_ZYGOTE) ; les
+    // demandes passent par pool[1], les zygotes lisent pool[0]
+    int pool[2];
+    int nbZygotes;                  // 0 : fork + exec pour chaque worker
+    pid_t zygotes[MAX_ZYGOTES];
+
+    // requêtes en cours, rangées à l'indice reqId % MAX_PENDING ; les
+    // insertions n'ont personne qui les attend : leur case est libérée
+    // dès la réponse
+    Request pending[MAX_PENDING];
+    int nbPending;
+    int nextReqId;
+
+    // latences, et début du tour de boucle en cours (cf. loop)
+    Stats stats;
+    double tourStart;
+
 } Data;
 
 
@@ -52,609 +205,2131 @@ typedef struct
  ************************************************************************/
 static void usage(const char *exeName, const char *message)
 {
-    fprintf(stderr, "usage : %s\n", exeName);
+    fprintf(stderr, "usage : %s [" TK_ENGINE " <" TK_ENGINE_WORKERS "|" TK_ENGINE_ARENA ">]"
+                    " [" TK_TRANSPORT " <" MW_TRANSPORT_SOCKET "|" MW_TRANSPORT_RING ">]"
+                    " [" TK_LOAD " <fichier>] [" TK_WAL " <fichier>]"
+                    " [" TK_SHARDS " <b1,b2,...>] [" TK_POOL " <n>]\n", exeName);
+    fprintf(stderr, "   " TK_ENGINE " " TK_ENGINE_WORKERS " : un worker par bloc d'éléments distincts (défaut)\n");
+    fprintf(stderr, "   " TK_ENGINE " " TK_ENGINE_ARENA "   : ensemble stocké dans le master, sans worker\n");
+    fprintf(stderr, "   " TK_TRANSPORT " " MW_TRANSPORT_SOCKET " : workers reliés par des sockets (défaut)\n");
+    fprintf(stderr, "   " TK_TRANSPORT " " MW_TRANSPORT_RING "   : anneaux en mémoire partagée entre workers\n");
+    fprintf(stderr, "   " TK_LOAD " <fichier> : ensemble initial lu dans un instantané (ordre snapshot)\n");
+    fprintf(stderr, "   " TK_WAL " <fichier>  : insertions journalisées (et rejouées au démarrage)\n");
+    fprintf(stderr, "   " TK_SHARDS " <b1,b2,...> : un arbre de workers par tranche ]-inf,b1[ [b1,b2[ ... [bn,+inf[\n");
+    fprintf(stderr, "   " TK_POOL " <n> : workers créés par <n> zygotes, sans exec (0 : fork + exec, défaut %d)\n",
+            DEFAULT_ZYGOTES);
     if (message != NULL)
         fprintf(stderr, "message : %s\n", message);
     exit(EXIT_FAILURE);
 }
 
+// bornes croissantes des tranches, séparées par des virgules
+static void parseBounds(const char *exeName, const char *arg, Data *data)
+{
+    data->nbShards = 1;
+    while (*arg != '\0')
+    {
+        char *end;
+        float bound = strtof(arg, &end);
+        if (end == arg || (*end != ',' && *end != '\0'))
+            usage(exeName, "borne incorrecte");
+        if (data->nbShards == MAX_SHARDS)
+            usage(exeName, "trop de tranches");
+        if (data->nbShards > 1 && bound <= data->bounds[data->nbShards - 2])
+            usage(exeName, "bornes non croissantes");
+        data->bounds[data->nbShards - 1] = bound;
+        data->nbShards++;
+        arg = (*end == ',') ? end + 1 : end;
+    }
+}
+
+static void parseArgs(int argc, char * argv[], Data *data)
+{
+    data->engine = ENGINE_WORKERS;
+    data->ring = false;
+    data->loadPath = NULL;
+    data->walPath = NULL;
+    data->wal = NULL;
+    data->nbShards = 1;
+    data->nbZygotes = DEFAULT_ZYGOTES;
+    bool pool = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], TK_ENGINE) == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], TK_ENGINE_WORKERS) == 0)
+                data->engine = ENGINE_WORKERS;
+            else if (strcmp(argv[i], TK_ENGINE_ARENA) == 0)
+                data->engine = ENGINE_ARENA;
+            else
+                usage(argv[0], "moteur inconnu");
+        }
+        else if (strcmp(argv[i], TK_TRANSPORT) == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], MW_TRANSPORT_SOCKET) == 0)
+                data->ring = false;
+            else if (strcmp(argv[i], MW_TRANSPORT_RING) == 0)
+                data->ring = true;
+            else
+                usage(argv[0], "transport inconnu");
+        }
+        else if (strcmp(argv[i], TK_LOAD) == 0 && i + 1 < argc)
+        {
+            i++;
+            data->loadPath = argv[i];
+        }
+        else if (strcmp(argv[i], TK_WAL) == 0 && i + 1 < argc)
+        {
+            i++;
+            data->walPath = argv[i];
+        }
+        else if (strcmp(argv[i], TK_SHARDS) == 0 && i + 1 < argc)
+        {
+            i++;
+            parseBounds(argv[0], argv[i], data);
+        }
+        else if (strcmp(argv[i], TK_POOL) == 0 && i + 1 < argc)
+        {
+            i++;
+            char *end;
+            long nb = strtol(argv[i], &end, 10);
+            if (*end != '\0' || end == argv[i] || nb < 0 || nb > MAX_ZYGOTES)
+                usage(argv[0], "nombre de zygotes incorrect");
+            data->nbZygotes = nb;
+            pool = true;
+        }
+        else
+            usage(argv[0], "argument incorrect");
+    }
+
+    if (data->engine == ENGINE_ARENA && data->nbShards > 1)
+        usage(argv[0], TK_SHARDS " demande le moteur " TK_ENGINE_WORKERS);
+    if (data->engine == ENGINE_ARENA && pool)
+        usage(argv[0], TK_POOL " demande le moteur " TK_ENGINE_WORKERS);
+    if (data->engine == ENGINE_ARENA)
+        data->nbZygotes = 0;
+}
+
+
+/************************************************************************
+ * Communication avec le client
+ ************************************************************************/
+// statistiques de <order>, créées à sa première apparition
+static StOrderStats * statsOf(Stats *stats, int order)
+{
+    for (int i = 0; i < stats->nbOrders; i++)
+        if (stats->orders[i].order == order)
+            return &(stats->orders[i]);
+    myassert(stats->nbOrders < MAX_ORDER_STATS, "trop de types d'ordre");
+    StOrderStats *entry = &(stats->orders[stats->nbOrders++]);
+    entry->order = order;
+    for (int p = 0; p < ST_NB_PHASES; p++)
+        st_init(&(entry->phases[p]));
+    return entry;
+}
+
+// les réponses prêtes de <session> viennent de quitter le master
+static void recordWrites(Session *session)
+{
+    double now = ut_now();
+    for (int i = 0; i < session->nbUnflushed; i++)
+        st_record(&(session->unflushed[i].stats->phases[ST_WRITE]), now - session->unflushed[i].answered);
+    session->nbUnflushed = 0;
+}
+
+// les réponses prêtes de <session> sont écrites dans son tube, sauf si
+// une partie attend encore de la place (cf. watchOutput)
+static void answersWritten(Session *session)
+{
+    if (! fr_pending(session->masterToClient))
+        recordWrites(session);
+}
+
+// la réponse à l'ordre en cours (cf. Session.timer) est prête : attente et
+// traitement sont comptés, l'écriture le sera à l'envoi (cf. flushAll)
+static void answerReady(Session *session)
+{
+    double now = ut_now();
+    StOrderStats *stats = statsOf(session->stats, session->timer.order);
+    st_record(&(stats->phases[ST_QUEUE]), session->timer.start - session->timer.ready);
+    st_record(&(stats->phases[ST_TREE]), now - session->timer.start);
+
+    if (session->nbUnflushed == MAX_UNFLUSHED)
+    {
+        // client qui ne lit pas : l'écriture est comptée jusqu'à la file
+        fr_flush(session->masterToClient);
+        recordWrites(session);
+    }
+    session->unflushed[session->nbUnflushed].stats = stats;
+    session->unflushed[session->nbUnflushed].answered = now;
+    session->nbUnflushed++;
+}
+
+// une réponse est une trame (cf. frame.h) : l'accusé de réception et les
+// résultats ; elle part avec les autres avant la prochaine attente
+static void writeFrameToClient(const Session *session, int ack, const void *buf, int size)
+{
+    fr_begin(session->masterToClient, ack, 0);
+    if (size > 0)
+        fr_put(session->masterToClient, buf, size);
+    fr_end(session->masterToClient);
+}
+
+static void writeAnswerToClient(Session *session, int ack, const void *buf, int size)
+{
+    writeFrameToClient(session, ack, buf, size);
+    answerReady(session);
+}
+
+static void writeAckToClient(Session *session, int ack)
+{
+    writeAnswerToClient(session, ack, NULL, 0);
+}
+
+// contenu de l'ordre (la trame, déjà commencée, est entière dans le
+// tampon : cf. sessionAction)
+static void readFromClient(const Session *session, void *buf, int size)
+{
+    fr_get(session->clientToMaster, buf, size);
+}
+
+// réponses des ordres qui peuvent se terminer à l'arrivée de la réponse
+// d'un worker, longtemps après la lecture de l'ordre
+static void answerMinimum(Session *session, float minimum)
+{
+    writeAnswerToClient(session, CM_ANSWER_MINIMUM_OK, &minimum, sizeof(float));
+}
+
+static void answerMaximum(Session *session, float maximum)
+{
+    writeAnswerToClient(session, CM_ANSWER_MAXIMUM_OK, &maximum, sizeof(float));
+}
+
+static void answerExist(Session *session, int quantity)
+{
+    if (quantity == 0)
+    {
+        // Si élément non présent, envoyer l'accusé de réception dédié au client
+        writeAckToClient(session, CM_ANSWER_EXIST_NO);
+    }
+    else
+    {
+        // Envoyer l'accusé de réception et le résultat au client
+        writeAnswerToClient(session, CM_ANSWER_EXIST_YES, &quantity, sizeof(int));
+    }
+}
+
+static void answerSum(Session *session, float sum)
+{
+    writeAnswerToClient(session, CM_ANSWER_SUM_OK, &sum, sizeof(float));
+}
+
+static void answerKth(Session *session, bool found, float elt)
+{
+    if (found)
+        writeAnswerToClient(session, CM_ANSWER_KTH_OK, &elt, sizeof(float));
+    else
+        writeAckToClient(session, CM_ANSWER_KTH_NONE);
+}
+
+static void answerRank(Session *session, int rank)
+{
+    writeAnswerToClient(session, CM_ANSWER_RANK_OK, &rank, sizeof(int));
+}
+
+
+/************************************************************************
+ * Sessions avec les clients
+ ************************************************************************/
+// plus de case libre : le client lit le refus puis la fin du tube, et
+// n'ouvre pas son second tube (cf. client_master.h)
+static void refuseSession(pid_t pid, const char *masterToClient)
+{
+    TRACE1("[master] trop de clients, %d refusé\n", (int) pid);
+    int fd = open(masterToClient, O_WRONLY | O_NONBLOCK);
+    if (fd == -1)
+        return;
+    fr_begin(fd, CM_ANSWER_SESSION_REFUSED, 0);
+    fr_end(fd);
+    fr_close(fd);
+}
+
+// ouverture de la session du client <pid> (cf. client_master.h)
+static void openSession(Data *data, pid_t pid)
+{
+    Session *session = NULL;
+    int idx;
+    for (idx = 0; idx < MAX_SESSIONS && session == NULL; idx++)
+        if (data->sessions[idx].pid == -1)
+            session = &(data->sessions[idx]);
+
+    char masterToClient[PIPE_NAME_SIZE], clientToMaster[PIPE_NAME_SIZE];
+    sessionPipeNames(pid, masterToClient, clientToMaster);
+    if (session == NULL)
+    {
+        refuseSession(pid, masterToClient);
+        return;
+    }
+    idx--;
+
+    // le client a déjà ouvert son tube en lecture : l'ouverture est
+    // immédiate, sauf s'il a disparu entre-temps
+    session->masterToClient = open(masterToClient, O_WRONLY | O_NONBLOCK);
+    if (session->masterToClient == -1)
+    {
+        TRACE1("[master] client %d disparu\n", (int) pid);
+        return;
+    }
+    // l'accord débloque le client, qui ouvre alors son second tube
+    fr_begin(session->masterToClient, CM_ANSWER_SESSION_OK, 0);
+    fr_end(session->masterToClient);
+    fr_flush(session->masterToClient);
+    session->clientToMaster = open(clientToMaster, O_RDONLY | O_NONBLOCK);
+    myassert(session->clientToMaster != -1, "Erreur");
+
+    // non bloquants ensuite : un client lent n'arrête pas la boucle (cf.
+    // sessionAction, watchOutput)
+    fr_setNonBlocking(session->masterToClient);
+    fr_setNonBlocking(session->clientToMaster);
+    setCloseOnExec(session->masterToClient, true);
+    setCloseOnExec(session->clientToMaster, true);
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u32 = idx;
+    int ret = epoll_ctl(data->epoll, EPOLL_CTL_ADD, session->clientToMaster, &event);
+    myassert(ret != -1, "Erreur");
+
+    session->pid = pid;
+    session->nbPending = 0;
+    session->closing = false;
+    session->nbUnsynced = 0;
+    session->stats = &(data->stats);
+    session->nbUnflushed = 0;
+    session->output = false;
+    TRACE1("[master] session avec le client %d\n", (int) pid);
+}
+
+static void closeSession(Data *data, Session *session)
+{
+    int ret;
+    if (! session->closing)
+    {
+        ret = epoll_ctl(data->epoll, EPOLL_CTL_DEL, session->clientToMaster, NULL);
+        myassert(ret != -1, "Erreur");
+    }
+    // les réponses encore en file sont perdues
+    if (session->output)
+    {
+        ret = epoll_ctl(data->epoll, EPOLL_CTL_DEL, session->masterToClient, NULL);
+        myassert(ret != -1, "Erreur");
+        session->output = false;
+    }
+    fr_close(session->masterToClient);
+    fr_close(session->clientToMaster);
+    session->pid = -1;
+    // les insertions sont tout de même synchronisées au prochain tour
+    session->nbUnsynced = 0;
+    session->nbUnflushed = 0;
+}
+
+// fin de la session à la demande du client (fin de son tube) ; on attend
+// pour fermer que les réponses en cours soient arrivées
+static void endSession(Data *data, Session *session)
+{
+    if (session->nbPending == 0)
+    {
+        closeSession(data, session);
+        return;
+    }
+    int ret = epoll_ctl(data->epoll, EPOLL_CTL_DEL, session->clientToMaster, NULL);
+    myassert(ret != -1, "Erreur");
+    session->closing = true;
+}
+
+// tous les PID en attente dans le tube d'enregistrement
+static void acceptSessions(Data *data)
+{
+    pid_t pid;
+    int ret;
+    while ((ret = read(data->registration, &pid, sizeof(pid_t))) == sizeof(pid_t))
+        openSession(data, pid);
+    myassert(ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK), "Erreur");
+}
+
+// un client qui ne lit pas ses réponses remplit son tube : le reste
+// attend dans la file de masterToClient (cf. frame.h), surveillé tant
+// qu'elle n'est pas vide
+static void watchOutput(Data *data, int idx)
+{
+    Session *session = &(data->sessions[idx]);
+    bool pending = fr_pending(session->masterToClient);
+    if (pending == session->output)
+        return;
+
+    struct epoll_event event;
+    event.events = EPOLLOUT;
+    event.data.u32 = EV_OUTPUT + idx;
+    int ret = epoll_ctl(data->epoll, pending ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, session->masterToClient, &event);
+    myassert(ret != -1, "Erreur");
+    session->output = pending;
+}
+
+// envoi de toutes les écritures en attente (cf. fr_flushAll) : les
+// réponses prêtes partent vers les clients, ou attendent de la place
+static void flushAll(Data *data)
+{
+    fr_flushAll();
+    for (int i = 0; i < MAX_SESSIONS; i++)
+        if (data->sessions[i].pid != -1)
+        {
+            watchOutput(data, i);
+            if (data->sessions[i].nbUnflushed > 0)
+                answersWritten(&(data->sessions[i]));
+        }
+}
+
+
+/************************************************************************
+ * Shards
+ ************************************************************************/
+// indice du shard qui stocke <elt>
+static int shardOf(const Data *data, float elt)
+{
+    int idx = 0;
+    while (idx < data->nbShards - 1 && elt >= data->bounds[idx])
+        idx++;
+    return idx;
+}
+
+static bool shardIsEmpty(const Shard *shard)
+{
+    return shard->firstWorkerPid == -1;
+}
+
+// la tranche du shard <idx> rencontre-t-elle l'intervalle [a,b[
+static bool shardMeets(const Data *data, int idx, float a, float b)
+{
+    return (idx == data->nbShards - 1 || a < data->bounds[idx])
+        && (idx == 0 || b > data->bounds[idx - 1]);
+}
+
+// nombre d'éléments des shards d'indice inférieur à <idx> (tous inférieurs
+// aux éléments du shard <idx>)
+static int nbElementsBefore(const Data *data, int idx)
+{
+    int nb = 0;
+    for (int i = 0; i < idx; i++)
+        nb += data->shards[i].nbElements;
+    return nb;
+}
+
+// l'ensemble est-il vide, quel que soit le moteur
+static bool isEmpty(const Data *data)
+{
+    if (data->engine == ENGINE_ARENA)
+        return tr_isEmpty(data->tree);
+    return nbElementsBefore(data, data->nbShards) == 0;
+}
+
+
+/************************************************************************
+ * Requêtes en cours dans l'arbre de workers
+ ************************************************************************/
+static Request * findRequest(Data *data, int reqId)
+{
+    Request *request = &(data->pending[reqId % MAX_PENDING]);
+    myassert(request->reqId == reqId && ! request->done, "réponse sans requête");
+    return request;
+}
+
+static void releaseRequest(Data *data, Request *request)
+{
+    request->reqId = MW_NO_REQUEST;
+    data->nbPending--;
+}
+
+// réponse arrivée : réponse au client s'il y en a un qui attend, sinon la
+// requête reste en place pour waitRequest (sauf les insertions)
+static void completeRequest(Data *data, Request *request)
+{
+    request->done = true;
+
+    Session *session = request->session;
+    if (session == NULL)
+    {
+        if (request->order == MW_ORDER_INSERT)
+            releaseRequest(data, request);
+        return;
+    }
+
+    if (! session->closing)
+    {
+        // la réponse termine l'ordre de la requête, pas celui que la
+        // session traite peut-être en ce moment
+        Timer current = session->timer;
+        session->timer = request->timer;
+        switch (request->order)
+        {
+          case MW_ORDER_MINIMUM:
+            answerMinimum(session, request->value);
+            break;
+          case MW_ORDER_MAXIMUM:
+            answerMaximum(session, request->value);
+            break;
+          case MW_ORDER_EXIST:
+            answerExist(session, (request->answer == MW_ANSWER_EXIST_YES) ? request->results[0] : 0);
+            break;
+          case MW_ORDER_SUM:
+            answerSum(session, request->value);
+            break;
+          case MW_ORDER_KTH:
+            answerKth(session, request->answer == MW_ANSWER_KTH, request->value);
+            break;
+          case MW_ORDER_RANK:
+            answerRank(session, request->results[0]);
+            break;
+          default:
+            myassert(false, "requête sans réponse au client");
+            break;
+        }
+        session->timer = current;
+    }
+
+    releaseRequest(data, request);
+    session->nbPending--;
+    if (session->closing && session->nbPending == 0)
+        closeSession(data, session);
+}
+
+// réponse (de la forme de l'arbre) du premier worker à une insertion
+static void readShapeAnswer(int fd)
+{
+    readWorker(fd);                 // hauteur
+    readWorker(fd);                 // déséquilibre
+    Summary summary;
+    readSummaryWorker(&summary, fd);
+}
+
+// réponse du premier worker d'un shard (sur son tube dédié) ; les
+// réponses des shards à une même requête se cumulent
+static void receiveFirstWorkerAnswer(Data *data, Shard *shard)
+{
+    int fd = shard->firstWorkerToMaster[0];
+    int reqId;
+    int answer = readHeaderWorker(fd, &reqId);
+    Request *request = findRequest(data, reqId);
+    request->answer = answer;
+
+    switch (answer)
+    {
+      case MW_ANSWER_INSERT:
+      case MW_ANSWER_INSERT_BATCH:
+      case MW_ANSWER_LOAD:
+        readShapeAnswer(fd);
+        break;
+      case MW_ANSWER_HOW_MANY:
+        request->results[0] += readWorker(fd);
+        request->results[1] += readWorker(fd);
+        break;
+      case MW_ANSWER_SUM:
+      case MW_ANSWER_RANGE_SUM:
+        request->value += readFloatWorker(fd);
+        break;
+      case MW_ANSWER_RANGE_COUNT:
+        request->results[0] += readWorker(fd);
+        break;
+      case MW_ANSWER_DEPTH:
+      {
+        int depth = readWorker(fd);
+        if (depth > request->results[0])
+            request->results[0] = depth;
+        break;
+      }
+      case MW_ANSWER_EXPORT:
+        break;
+      case MW_ANSWER_SCAN:
+        request->results[0] = readWorker(fd);
+        request->entries = malloc(request->results[0] * sizeof(ExportEntry));
+        myassert(request->entries != NULL || request->results[0] == 0, "Erreur");
+        readEntriesWorker(request->entries, request->results[0], fd);
+        break;
+      default:
+        myassert(false, "réponse inconnue");
+        break;
+    }
+
+    request->nbAnswers--;
+    if (request->nbAnswers == 0)
+        completeRequest(data, request);
+}
+
+// réponse directe d'un worker quelconque (sur le tube partagé)
+static void receiveDirectAnswer(Data *data)
+{
+    DirectAnswer direct;
+    readDirectAnswer(&direct, data->workersToMaster[0]);
+
+    Request *request = findRequest(data, direct.reqId);
+    request->answer = direct.answer;
+    request->value = direct.elt;
+    request->results[0] = direct.cardinality;
+    request->nbAnswers--;
+    if (request->nbAnswers == 0)
+        completeRequest(data, request);
+}
+
+// traite les réponses disponibles ; attend au plus <timeout> ms (cf. poll)
+// et renvoie false si rien n'est arrivé
+// Les réponses déjà dans les tampons de lecture (cf. frame.h) passent
+// avant : poll ne les signale pas.
+static bool receiveAnswers(Data *data, int timeout)
+{
+    // les premiers workers des shards, puis le tube partagé
+    struct pollfd fds[MAX_SHARDS + 1];
+    int nbFds = data->nbShards + 1;
+    for (int i = 0; i < data->nbShards; i++)
+        fds[i].fd = data->shards[i].firstWorkerToMaster[0];
+    fds[data->nbShards].fd = data->workersToMaster[0];
+    int ret = 0;
+    for (int i = 0; i < nbFds; i++)
+    {
+        fds[i].events = POLLIN;
+        fds[i].revents = fr_hasData(fds[i].fd) ? POLLIN : 0;
+        if (fds[i].revents != 0)
+            ret++;
+    }
+
+    if (ret == 0)
+    {
+        // pas d'attente avec des ordres encore dans les tampons d'écriture
+        if (timeout != 0)
+            flushAll(data);
+        ret = poll(fds, nbFds, timeout);
+        myassert(ret != -1, "Erreur");
+    }
+
+    for (int i = 0; i < data->nbShards; i++)
+        if (fds[i].revents != 0)
+            receiveFirstWorkerAnswer(data, &(data->shards[i]));
+    if (fds[data->nbShards].revents != 0)
+        receiveDirectAnswer(data);
+    return ret > 0;
+}
+
+// envoi de l'en-tête d'un ordre au premier worker de <shard> (le contenu
+// éventuel suit, puis endMessageToWorker) ; renvoie le numéro de la requête. Si <session> n'est pas NULL,
+// c'est l'arrivée de la réponse qui terminera l'ordre (cf. completeRequest)
+static int startRequest(Data *data, Shard *shard, int order, Session *session)
+{
+    int reqId = data->nextReqId;
+    data->nextReqId = (reqId == INT_MAX) ? 1 : reqId + 1;
+
+    // case encore occupée par une requête ancienne : on attend sa réponse
+    Request *request = &(data->pending[reqId % MAX_PENDING]);
+    while (request->reqId != MW_NO_REQUEST)
+        receiveAnswers(data, -1);
+
+    request->reqId = reqId;
+    request->order = order;
+    request->nbAnswers = 1;
+    request->done = false;
+    request->results[0] = 0;
+    request->results[1] = 0;
+    request->value = 0;
+    request->entries = NULL;
+    request->session = session;
+    data->nbPending++;
+    if (session != NULL)
+    {
+        session->nbPending++;
+        request->timer = session->timer;
+    }
+
+    writeHeaderToWorker(order, reqId, shard->masterToFirstWorker[1]);
+    return reqId;
+}
+
+// la requête <reqId> part aussi vers <shard> (même remarque pour le
+// contenu) : une réponse de plus à attendre
+static void joinRequest(Data *data, Shard *shard, int reqId)
+{
+    Request *request = &(data->pending[reqId % MAX_PENDING]);
+    myassert(request->reqId == reqId && ! request->done, "requête inconnue");
+    request->nbAnswers++;
+    writeHeaderToWorker(request->order, reqId, shard->masterToFirstWorker[1]);
+}
+
+// ordre sans contenu envoyé en parallèle à tous les shards non vides ;
+// renvoie le numéro de la requête (l'ensemble ne doit pas être vide)
+static int startRequestAll(Data *data, int order, Session *session)
+{
+    int reqId = MW_NO_REQUEST;
+    for (int i = 0; i < data->nbShards; i++)
+    {
+        Shard *shard = &(data->shards[i]);
+        if (shardIsEmpty(shard))
+            continue;
+        if (reqId == MW_NO_REQUEST)
+            reqId = startRequest(data, shard, order, session);
+        else
+            joinRequest(data, shard, reqId);
+        endMessageToWorker(shard->masterToFirstWorker[1]);
+    }
+    myassert(reqId != MW_NO_REQUEST, "ensemble vide");
+    return reqId;
+}
+
+// attente de la réponse à une requête, qui est ensuite libérée
+static void waitRequest(Data *data, int reqId, Request *result)
+{
+    Request *request = &(data->pending[reqId % MAX_PENDING]);
+    myassert(request->reqId == reqId, "requête inconnue");
+    while (! request->done)
+        receiveAnswers(data, -1);
+
+    *result = *request;
+    releaseRequest(data, request);
+}
+
+// attente de toutes les requêtes en cours (les insertions) : nécessaire
+// avant les ordres qui demandent un arbre stable (print, stop, lot, ...)
+static void waitAllRequests(Data *data)
+{
+    while (data->nbPending > 0)
+        receiveAnswers(data, -1);
+}
+
+// requête complète : en-tête sans contenu envoyé à tous les shards non
+// vides, puis attente des réponses (cumulées)
+static void requestAll(Data *data, int order, Request *result)
+{
+    int reqId = startRequestAll(data, order, NULL);
+    waitRequest(data, reqId, result);
+}
+
 
 /************************************************************************
  * initialisation complète
  ************************************************************************/
+static void watch(Data *data, int fd, int tag)
+{
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u32 = tag;
+    int ret = epoll_ctl(data->epoll, EPOLL_CTL_ADD, fd, &event);
+    myassert(ret != -1, "Erreur");
+}
+
 void init(Data *data)
 {
     int ret;
 
-    ret = pipe(data->firstWorkerToMaster);
-    myassert(ret == 0, "Erreur");
+    for (int s = 0; s < data->nbShards; s++)
+    {
+        Shard *shard = &(data->shards[s]);
+        ret = pipe(shard->firstWorkerToMaster);
+        myassert(ret == 0, "Erreur");
 
-    ret = pipe(data->masterToFirstWorker);
-    myassert(ret == 0, "Erreur");
+        ret = pipe(shard->masterToFirstWorker);
+        myassert(ret == 0, "Erreur");
+
+        // seul le premier worker du shard doit hériter de ses extrémités
+        // (cf. createWorker)
+        for (int i = 0; i < 2; i++)
+        {
+            setCloseOnExec(shard->firstWorkerToMaster[i], true);
+            setCloseOnExec(shard->masterToFirstWorker[i], true);
+        }
+
+        shard->firstWorkerPid = -1;
+        shard->nbElements = 0;
+    }
 
     ret = pipe(data->workersToMaster);
     myassert(ret == 0, "Erreur");
+    for (int i = 0; i < 2; i++)
+        setCloseOnExec(data->workersToMaster[i], true);
+
+    // zygotes : datagrammes pour que chaque demande aille entière à un
+    // seul d'entre eux
+    data->pool[0] = data->pool[1] = -1;
+    if (data->nbZygotes > 0)
+    {
+        ret = socketpair(AF_UNIX, SOCK_DGRAM, 0, data->pool);
+        myassert(ret == 0, "Erreur");
+        for (int i = 0; i < 2; i++)
+            setCloseOnExec(data->pool[i], true);
+    }
+    for (int z = 0; z < data->nbZygotes; z++)
+    {
+        data->zygotes[z] = fork();
+        myassert(data->zygotes[z] != -1, "fork n'a pas fonctionné");
+        if (data->zygotes[z] == 0)
+        {
+            createZygote(data->pool[0], data->pool[1], data->workersToMaster[1], data->ring);
+            myassert(false, "Erreur");
+        }
+    }
+
+    // un client parti pendant une écriture donne EPIPE, pas la fin du
+    // master (cf. frame.h) ; les zygotes, déjà créés, gardent SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    data->tree = NULL;
+    for (int i = 0; i < MAX_PENDING; i++)
+        data->pending[i].reqId = MW_NO_REQUEST;
+    data->nbPending = 0;
+    data->nextReqId = 1;
+    data->stats.nbOrders = 0;
+    data->tourStart = ut_now();
+    if (data->engine == ENGINE_ARENA)
+        data->tree = tr_create();
+
+    // tube d'enregistrement (créé par main) : lecture non bloquante pour
+    // vider tous les PID en attente
+    data->registration = open(REGISTRATION, O_RDONLY | O_NONBLOCK);
+    myassert(data->registration != -1, "Erreur");
+    data->registrationKeepAlive = open(REGISTRATION, O_WRONLY);
+    myassert(data->registrationKeepAlive != -1, "Erreur");
+    setCloseOnExec(data->registration, true);
+    setCloseOnExec(data->registrationKeepAlive, true);
+
+    for (int i = 0; i < MAX_SESSIONS; i++)
+        data->sessions[i].pid = -1;
+
+    data->epoll = epoll_create(MAX_EVENTS);
+    myassert(data->epoll != -1, "Erreur");
+    setCloseOnExec(data->epoll, true);
+    watch(data, data->registration, EV_REGISTRATION);
+    for (int s = 0; s < data->nbShards; s++)
+        watch(data, data->shards[s].firstWorkerToMaster[0], EV_SHARDS + s);
+    watch(data, data->workersToMaster[0], EV_WORKERS);
+}
+
+
+/************************************************************************
+ * fin du master
+ ************************************************************************/
+void orderStop(Data *data, Session *session)
+{
+    TRACE0("[master] ordre stop\n");
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    //TODO
+    // - traiter le cas ensemble vide (pas de premier worker)
+    // - envoyer au premier worker ordre de fin (cf. master_worker.h)
+    // - attendre sa fin
+    // - envoyer l'accusé de réception au client (cf. client_master.h)
+    //END TODO
+
+    if (data->engine == ENGINE_ARENA)
+    {
+        tr_destroy(data->tree);
+        data->tree = NULL;
+    }
+    else
+    {
+        // Envoyer aux premiers workers l'ordre de fin (cf. master_worker.h),
+        // une fois toutes les insertions terminées : les shards s'arrêtent
+        // en parallèle
+        waitAllRequests(data);
+        for (int i = 0; i < data->nbShards; i++)
+        {
+            Shard *shard = &(data->shards[i]);
+            if (shardIsEmpty(shard))
+                continue;
+            writeHeaderToWorker(MW_ORDER_STOP, MW_NO_REQUEST, shard->masterToFirstWorker[1]);
+            endMessageToWorker(shard->masterToFirstWorker[1]);
+            fr_flush(shard->masterToFirstWorker[1]);
+        }
+
+        // Attendre la fin des premiers workers
+        for (int i = 0; i < data->nbShards; i++)
+        {
+            Shard *shard = &(data->shards[i]);
+            if (shardIsEmpty(shard))
+                continue;
+            int ret = waitpid(shard->firstWorkerPid, NULL, 0);
+            myassert(ret != -1, "Erreur");
+        }
+
+        // les autres workers sont les fils des zygotes, qui les attendent
+        for (int z = 0; z < data->nbZygotes; z++)
+            stopZygote(data->pool[1]);
+        for (int z = 0; z < data->nbZygotes; z++)
+        {
+            int ret = waitpid(data->zygotes[z], NULL, 0);
+            myassert(ret != -1, "Erreur");
+        }
+    }
+
+    // Envoyer l'accusé de réception au client (cf. client_master.h)
+    writeAckToClient(session, CM_ANSWER_STOP_OK);
+}
+
+
+/************************************************************************
+ * quel est la cardinalité de l'ensemble
+ ************************************************************************/
+void orderHowMany(Data *data, Session *session)
+{
+    TRACE0("[master] ordre how many\n");
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    //TODO
+    // - traiter le cas ensemble vide (pas de premier worker)
+    // - envoyer au premier worker ordre howmany (cf. master_worker.h)
+    // - recevoir accusé de réception venant du premier worker (cf. master_worker.h)
+    // - recevoir résultats (deux quantités) venant du premier worker
+    // - envoyer l'accusé de réception au client (cf. client_master.h)
+    // - envoyer les résultats au client
+    //END TODO
+
+    // ensemble vide : 0 et 0
+    int res[2] = {0, 0};
+
+    if (data->engine == ENGINE_ARENA)
+    {
+        tr_howMany(data->tree, &res[0], &res[1]);
+    }
+    else if (! isEmpty(data))
+    {
+        // le nombre d'éléments distincts n'est connu qu'à la fin des insertions
+        waitAllRequests(data);
+
+        // Envoyer aux premiers workers ordre howmany (cf. master_worker.h) et
+        // recevoir les résultats (deux quantités, cumulées sur les shards)
+        Request result;
+        requestAll(data, MW_ORDER_HOW_MANY, &result);
+        myassert(result.answer == MW_ANSWER_HOW_MANY, "Erreur");
+        res[0] = result.results[0];
+        res[1] = result.results[1];
+    }
+
+    // Envoyer l'accusé de réception et les résultats au client
+    writeAnswerToClient(session, CM_ANSWER_HOW_MANY_OK, res, 2 * sizeof(int));
+}
+
+
+/************************************************************************
+ * quel est la minimum de l'ensemble
+ ************************************************************************/
+void orderMinimum(Data *data, Session *session)
+{
+    TRACE0("[master] ordre minimum\n");
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    //TODO
+    // - si ensemble vide (pas de premier worker)
+    //       . envoyer l'accusé de réception dédié au client (cf. client_master.h)
+    // - sinon
+    //       . envoyer au premier worker ordre minimum (cf. master_worker.h)
+    //       . recevoir accusé de réception venant du worker concerné (cf. master_worker.h)
+    //       . recevoir résultat (la valeur) venant du worker concerné
+    //       . envoyer l'accusé de réception au client (cf. client_master.h)
+    //       . envoyer le résultat au client
+    //END TODO
+
+    // Si ensemble vide, envoyer l'accusé de réception dédié au client
+    if (isEmpty(data))
+    {
+        writeAckToClient(session, CM_ANSWER_MINIMUM_EMPTY);
+        return;
+    }
+
+    if (data->engine == ENGINE_ARENA)
+    {
+        // Envoyer l'accusé de réception puis le résultat au client
+        answerMinimum(session, tr_minimum(data->tree));
+    }
+    else
+    {
+        // Envoyer au premier worker du premier shard non vide l'ordre
+        // minimum (cf. master_worker.h) ; la réponse du worker concerné
+        // sera transmise au client à son arrivée
+        int idx = 0;
+        while (shardIsEmpty(&(data->shards[idx])))
+            idx++;
+        Shard *shard = &(data->shards[idx]);
+        startRequest(data, shard, MW_ORDER_MINIMUM, session);
+        endMessageToWorker(shard->masterToFirstWorker[1]);
+    }
+}
+
+
+/************************************************************************
+ * quel est la maximum de l'ensemble
+ ************************************************************************/
+void orderMaximum(Data *data, Session *session)
+{
+    TRACE0("[master] ordre maximum\n");
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    // Si ensemble vide, envoyer l'accusé de réception dédié au client
+    if (isEmpty(data))
+    {
+        writeAckToClient(session, CM_ANSWER_MAXIMUM_EMPTY);
+        return;
+    }
+
+    if (data->engine == ENGINE_ARENA)
+    {
+        // Envoyer l'accusé de réception puis le résultat au client
+        answerMaximum(session, tr_maximum(data->tree));
+    }
+    else
+    {
+        // Envoyer au premier worker du dernier shard non vide l'ordre
+        // maximum (cf. master_worker.h) ; la réponse du worker concerné
+        // sera transmise au client à son arrivée
+        int idx = data->nbShards - 1;
+        while (shardIsEmpty(&(data->shards[idx])))
+            idx--;
+        Shard *shard = &(data->shards[idx]);
+        startRequest(data, shard, MW_ORDER_MAXIMUM, session);
+        endMessageToWorker(shard->masterToFirstWorker[1]);
+    }
+}
+
+
+/************************************************************************
+ * test d'existence
+ ************************************************************************/
+void orderExist(Data *data, Session *session)
+{
+    TRACE0("[master] ordre existence\n");
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    //TODO
+    // - recevoir l'élément à tester en provenance du client
+    // - si ensemble vide (pas de premier worker)
+    //       . envoyer l'accusé de réception dédié au client (cf. client_master.h)
+    // - sinon
+    //       . envoyer au premier worker ordre existence (cf. master_worker.h)
+    //       . envoyer au premier worker l'élément à tester
+    //       . recevoir accusé de réception venant du worker concerné (cf. master_worker.h)
+    //       . si élément non présent
+    //             . envoyer l'accusé de réception dédié au client (cf. client_master.h)
+    //       . sinon
+    //             . recevoir résultat (une quantité) venant du worker concerné
+    //             . envoyer l'accusé de réception au client (cf. client_master.h)
+    //             . envoyer le résultat au client
+    //END TODO
+
+    // Recevoir l'élément à tester en provenance du client
+    float elementToTest;
+    readFromClient(session, &elementToTest, sizeof(float));
+
+    Shard *shard = &(data->shards[shardOf(data, elementToTest)]);
+
+    if (data->engine == ENGINE_ARENA)
+    {
+        answerExist(session, tr_exist(data->tree, elementToTest));
+    }
+    else if (shardIsEmpty(shard))
+    {
+        answerExist(session, 0);
+    }
+    else
+    {
+        // Envoyer au premier worker du shard l'ordre existence et l'élément
+        // à tester ; la réponse du worker concerné (et la quantité si
+        // présent) sera transmise au client à son arrivée
+        startRequest(data, shard, MW_ORDER_EXIST, session);
+        writeFloatToWorker(elementToTest, shard->masterToFirstWorker[1]);
+        endMessageToWorker(shard->masterToFirstWorker[1]);
+    }
+}
+
+/************************************************************************
+ * somme
+ ************************************************************************/
+void orderSum(Data *data, Session *session)
+{
+    TRACE0("[master] ordre somme\n");
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    if (data->engine == ENGINE_ARENA)
+    {
+        answerSum(session, tr_sum(data->tree));
+    }
+    else if (isEmpty(data))
+    {
+        // Si ensemble vide (pas de premier worker), la somme est alors 0
+        answerSum(session, 0);
+    }
+    else
+    {
+        // Envoyer aux premiers workers l'ordre somme (cf. master_worker.h) ;
+        // la somme des réponses sera transmise au client à leur arrivée
+        startRequestAll(data, MW_ORDER_SUM, session);
+    }
+}
+
+/************************************************************************
+ * nombre ou somme des éléments d'un intervalle [a,b[
+ ************************************************************************/
+void orderRange(Data *data, Session *session, int order)
+{
+    TRACE0("[master] ordre intervalle\n");
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    // Recevoir les bornes en provenance du client
+    float bounds[2];
+    readFromClient(session, bounds, 2 * sizeof(float));
+
+    // ensemble vide ou intervalle vide : 0
+    int nbElements = 0;
+    float sum = 0;
+
+    if (data->engine == ENGINE_ARENA)
+    {
+        tr_range(data->tree, bounds[0], bounds[1], &nbElements, &sum);
+    }
+    else if (bounds[0] < bounds[1])
+    {
+        // les résumés des sous-arbres (cf. master_worker.h) ne sont
+        // complets qu'à la fin des insertions
+        waitAllRequests(data);
+
+        // seuls les shards dont la tranche rencontre l'intervalle sont
+        // interrogés, en parallèle
+        int mwOrder = (order == CM_ORDER_RANGE_COUNT) ? MW_ORDER_RANGE_COUNT : MW_ORDER_RANGE_SUM;
+        int reqId = MW_NO_REQUEST;
+        for (int i = 0; i < data->nbShards; i++)
+        {
+            Shard *shard = &(data->shards[i]);
+            if (shardIsEmpty(shard) || ! shardMeets(data, i, bounds[0], bounds[1]))
+                continue;
+            if (reqId == MW_NO_REQUEST)
+                reqId = startRequest(data, shard, mwOrder, NULL);
+            else
+                joinRequest(data, shard, reqId);
+            writeFloatToWorker(bounds[0], shard->masterToFirstWorker[1]);
+            writeFloatToWorker(bounds[1], shard->masterToFirstWorker[1]);
+            endMessageToWorker(shard->masterToFirstWorker[1]);
+        }
+
+        if (reqId != MW_NO_REQUEST)
+        {
+            Request result;
+            waitRequest(data, reqId, &result);
+            nbElements = result.results[0];
+            sum = result.value;
+        }
+    }
+
+    // Envoyer l'accusé de réception et le résultat au client
+    if (order == CM_ORDER_RANGE_COUNT)
+        writeAnswerToClient(session, CM_ANSWER_RANGE_COUNT_OK, &nbElements, sizeof(int));
+    else
+        writeAnswerToClient(session, CM_ANSWER_RANGE_SUM_OK, &sum, sizeof(float));
+}
+
+
+/************************************************************************
+ * k-ième élément, percentile et rang
+ ************************************************************************/
+// pour l'arbre de workers, la réponse vient directement du worker concerné
+// et sera transmise au client à son arrivée (cf. completeRequest)
+
+// k-ième élément de l'arbre de workers : le master connaît le nombre
+// d'éléments de chaque shard, il envoie l'ordre au bon shard avec le rang
+// dans ce shard
+static void kthRequest(Data *data, Session *session, int k)
+{
+    if (k < 1 || k > nbElementsBefore(data, data->nbShards))
+    {
+        answerKth(session, false, 0);
+        return;
+    }
+
+    int idx = 0;
+    while (k > data->shards[idx].nbElements)
+    {
+        k -= data->shards[idx].nbElements;
+        idx++;
+    }
+    Shard *shard = &(data->shards[idx]);
+    startRequest(data, shard, MW_ORDER_KTH, session);
+    writeToWorker(k, shard->masterToFirstWorker[1]);
+    endMessageToWorker(shard->masterToFirstWorker[1]);
+}
+
+void orderKth(Data *data, Session *session)
+{
+    TRACE0("[master] ordre k-ième\n");
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    int k;
+    readFromClient(session, &k, sizeof(int));
+
+    if (data->engine == ENGINE_ARENA)
+    {
+        int nbElements, nbDistinctElements;
+        tr_howMany(data->tree, &nbElements, &nbDistinctElements);
+        bool found = (k >= 1 && k <= nbElements);
+        answerKth(session, found, found ? tr_kth(data->tree, k) : 0);
+    }
+    else
+    {
+        kthRequest(data, session, k);
+    }
+}
+
+void orderPercentile(Data *data, Session *session)
+{
+    TRACE0("[master] ordre percentile\n");
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    float p;
+    readFromClient(session, &p, sizeof(float));
+
+    if (isEmpty(data))
+    {
+        answerKth(session, false, 0);
+    }
+    else if (data->engine == ENGINE_ARENA)
+    {
+        int nbElements, nbDistinctElements;
+        tr_howMany(data->tree, &nbElements, &nbDistinctElements);
+        answerKth(session, true, tr_kth(data->tree, percentileRank(p, nbElements)));
+    }
+    else
+    {
+        kthRequest(data, session, percentileRank(p, nbElementsBefore(data, data->nbShards)));
+    }
+}
+
+void orderRank(Data *data, Session *session)
+{
+    TRACE0("[master] ordre rang\n");
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    float x;
+    readFromClient(session, &x, sizeof(float));
+
+    if (data->engine == ENGINE_ARENA)
+    {
+        answerRank(session, tr_rank(data->tree, x));
+        return;
+    }
+
+    // les éléments des shards précédents sont tous inférieurs à x
+    int idx = shardOf(data, x);
+    Shard *shard = &(data->shards[idx]);
+    int rank = nbElementsBefore(data, idx);
+    if (shardIsEmpty(shard))
+    {
+        answerRank(session, rank);
+    }
+    else
+    {
+        startRequest(data, shard, MW_ORDER_RANK, session);
+        writeFloatToWorker(x, shard->masterToFirstWorker[1]);
+        writeToWorker(rank, shard->masterToFirstWorker[1]);
+        endMessageToWorker(shard->masterToFirstWorker[1]);
+    }
+}
+
+
+/************************************************************************
+ * insertion d'un élément
+ ************************************************************************/
+
+// lancement du premier worker d'un shard vide avec son élément
+static void createFirstWorker(Data *data, Shard *shard, float elt, int cardinality)
+{
+    shard->firstWorkerPid = fork();
+    myassert(shard->firstWorkerPid != -1, "fork n'a pas fonctionné");
+
+    if (shard->firstWorkerPid == 0)
+    {
+        signal(SIGPIPE, SIG_DFL);
+        createWorker(elt, cardinality, shard->masterToFirstWorker[0], shard->firstWorkerToMaster[1],
+                     data->workersToMaster[1], data->ring, -1, data->pool[1]);
+        myassert(false, "Erreur");
+    }
+}
+
+// insère un élément ; pour l'arbre de workers la réponse n'est pas
+// attendue : les ordres suivants voient l'élément car ils suivent le même
+// chemin dans l'arbre, derrière l'insertion
+static void insertElement(Data *data, float elementToInsert)
+{
+    if (data->engine == ENGINE_ARENA)
+    {
+        tr_insert(data->tree, elementToInsert);
+        return;
+    }
+
+    Shard *shard = &(data->shards[shardOf(data, elementToInsert)]);
+    shard->nbElements++;
+
+    if (shardIsEmpty(shard))
+    {
+        // - si shard vide (pas de premier worker)
+        //       . créer le premier worker avec l'élément reçu du client
+        createFirstWorker(data, shard, elementToInsert, 1);
+    }
+    else
+    {
+        // Envoyer au premier worker l'ordre insertion et l'élément à insérer
+        startRequest(data, shard, MW_ORDER_INSERT, NULL);
+        writeFloatToWorker(elementToInsert, shard->masterToFirstWorker[1]);
+        writeToWorker(1, shard->masterToFirstWorker[1]);
+        endMessageToWorker(shard->masterToFirstWorker[1]);
+    }
+}
+
+static int compareFloats(const void *a, const void *b)
+{
+    float x = *((const float *) a);
+    float y = *((const float *) b);
+    return (x > y) - (x < y);
+}
+
+// insertion d'un tableau en un seul message pour l'arbre de workers : le
+// lot est trié ici une fois pour toutes et ses doublons regroupés, chaque
+// worker n'a plus qu'à le couper (cf. master_worker.h) ; <elements> est
+// trié sur place
+static void insertBatch(Data *data, float *elements, int nbOfElements)
+{
+    if (data->engine == ENGINE_ARENA)
+    {
+        for (int i = 0; i < nbOfElements; ++i)
+            tr_insert(data->tree, elements[i]);
+        return;
+    }
+
+    qsort(elements, nbOfElements, sizeof(float), compareFloats);
+    ExportEntry *entries = malloc(nbOfElements * sizeof(ExportEntry));
+    myassert(entries != NULL, "Erreur");
+    int nbEntries = 0;
+    for (int i = 0; i < nbOfElements; i++)
+    {
+        if (nbEntries > 0 && entries[nbEntries - 1].elt == elements[i])
+            entries[nbEntries - 1].cardinality++;
+        else
+        {
+            entries[nbEntries].elt = elements[i];
+            entries[nbEntries].cardinality = 1;
+            nbEntries++;
+        }
+    }
+
+    // un lot demande un arbre stable (cf. master_worker.h)
+    waitAllRequests(data);
+
+    // chaque shard reçoit sa tranche du lot, tous en parallèle
+    int reqId = MW_NO_REQUEST;
+    int begin = 0;
+    for (int i = 0; i < data->nbShards; i++)
+    {
+        int end = begin;
+        while (end < nbEntries && shardOf(data, entries[end].elt) == i)
+        {
+            data->shards[i].nbElements += entries[end].cardinality;
+            end++;
+        }
+        if (end == begin)
+            continue;
+
+        Shard *shard = &(data->shards[i]);
+        ExportEntry *batch = entries + begin;
+        int nb = end - begin;
+        begin = end;
+
+        if (shardIsEmpty(shard))
+        {
+            // le premier worker prend la paire médiane, le reste lui est envoyé
+            int median = nb / 2;
+            createFirstWorker(data, shard, batch[median].elt, batch[median].cardinality);
+            memmove(batch + median, batch + median + 1, (nb - median - 1) * sizeof(ExportEntry));
+            nb--;
+        }
+        if (nb == 0)
+            continue;
+
+        if (reqId == MW_NO_REQUEST)
+            reqId = startRequest(data, shard, MW_ORDER_INSERT_BATCH, NULL);
+        else
+            joinRequest(data, shard, reqId);
+        writeToWorker(nb, shard->masterToFirstWorker[1]);
+        endEntriesToWorker(batch, nb, shard->masterToFirstWorker[1]);
+    }
+    free(entries);
+
+    if (reqId == MW_NO_REQUEST)
+        return;
+    Request result;
+    waitRequest(data, reqId, &result);
+    myassert(result.answer == MW_ANSWER_INSERT_BATCH, "Erreur");
+}
+
+// avec un journal, l'accusé de réception d'une insertion attend que son
+// enregistrement soit synchronisé (cf. commitLog) ; les éléments sont
+// journalisés avant d'être insérés (insertBatch les réordonne)
+static void logInsert(Data *data, const float *elements, int nbOfElements)
+{
+    if (data->wal != NULL)
+        wl_append(data->wal, elements, nbOfElements);
+}
+
+// avec un journal, l'accusé différé compte comme prêt dès maintenant : la
+// synchronisation est comptée dans son temps d'écriture
+static void ackInsert(Data *data, Session *session, int ack)
+{
+    if (data->wal == NULL)
+    {
+        writeAckToClient(session, ack);
+        return;
+    }
+    session->nbUnsynced++;
+    session->unsyncedAck = ack;
+    answerReady(session);
+}
+
+// accusé de réception différé d'un ordre d'insertion, -1 pour les autres
+static int insertAck(int order)
+{
+    switch (order)
+    {
+    case CM_ORDER_INSERT:
+        return CM_ANSWER_INSERT_OK;
+    case CM_ORDER_INSERT_MANY:
+    case CM_ORDER_INSERT_MANY_SHM:
+        return CM_ANSWER_INSERT_MANY_OK;
+    default:
+        return -1;
+    }
+}
+
+// validation groupée : toutes les insertions journalisées depuis la
+// précédente (tous clients confondus) sont écrites et synchronisées
+// ensemble, puis acquittées
+static void commitLog(Data *data)
+{
+    if (data->wal == NULL || ! wl_pending(data->wal))
+        return;
+
+    int nbRecords = wl_commit(data->wal);
+    TRACE1("[master] journal : %d insertion(s) synchronisée(s)\n", nbRecords);
+    (void) nbRecords;
+
+    for (int i = 0; i < MAX_SESSIONS; i++)
+    {
+        Session *session = &(data->sessions[i]);
+        if (session->pid == -1 || session->closing)
+            continue;
+        for ( ; session->nbUnsynced > 0; session->nbUnsynced--)
+            writeFrameToClient(session, session->unsyncedAck, NULL, 0);
+    }
+}
+
+void orderInsert(Data *data, Session *session)
+{
+    TRACE0("[master] ordre insertion\n");
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    //TODO
+    // - recevoir l'élément à insérer en provenance du client
+    // - si ensemble vide (pas de premier worker)
+    //       . créer le premier worker avec l'élément reçu du client
+    // - sinon
+    //       . envoyer au premier worker ordre insertion (cf. master_worker.h)
+    //       . envoyer au premier worker l'élément à insérer
+    // - recevoir accusé de réception venant du worker concerné (cf. master_worker.h)
+    // - envoyer l'accusé de réception au client (cf. client_master.h)
+    //END TODO
 
-    myassert(data != NULL, "il faut l'environnement d'exécution");
+    // - recevoir l'élément à insérer en provenance du client
+    float elementToInsert;
+    readFromClient(session, &elementToInsert, sizeof(float));
 
-    data->firstWorkerPid = -1;
+    logInsert(data, &elementToInsert, 1);
+    insertElement(data, elementToInsert);
+
+    // Envoyer l'accusé de réception au client (cf. client_master.h)
+    ackInsert(data, session, CM_ANSWER_INSERT_OK);
 }
 
 
 /************************************************************************
- * fin du master
+ * insertion d'un tableau d'éléments
  ************************************************************************/
-void orderStop(Data *data)
+void orderInsertMany(Data *data, Session *session)
 {
-    TRACE0("[master] ordre stop\n");
+    TRACE0("[master] ordre insertion tableau\n");
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
     //TODO
-    // - traiter le cas ensemble vide (pas de premier worker)
-    // - envoyer au premier worker ordre de fin (cf. master_worker.h)
-    // - attendre sa fin
+    // - recevoir le tableau d'éléments à insérer en provenance du client
+    // - pour chaque élément du tableau
+    //       . l'insérer selon l'algo vu dans orderInsert (penser à factoriser le code)
     // - envoyer l'accusé de réception au client (cf. client_master.h)
     //END TODO
 
-    // Si ensemble vide (pas de premier worker)
-
-    if (data->firstWorkerPid == -1)
+    // - recevoir le tableau d'éléments à insérer en provenance du client
+    // le nombre vient du client : le corps doit le contenir exactement
+    int nbOfElements = -1;
+    int length = fr_remaining(session->clientToMaster);
+    if (length >= (int) sizeof(int))
+        readFromClient(session, &nbOfElements, sizeof(int));
+    if (nbOfElements <= 0 || (size_t) nbOfElements * sizeof(float) != (size_t) length - sizeof(int))
     {
-        printf("\nIl n'y a pas de premier worker\n");
+        TRACE1("[master] tableau du client %d incohérent\n", (int) session->pid);
+        fr_skip(session->clientToMaster);
+        writeAckToClient(session, CM_ANSWER_INSERT_MANY_ERROR);
+        return;
     }
-    else
-    {
-        // fermer les extrémités des tubes inutiles
-        close(data->masterToFirstWorker[0]);
-        close(data->firstWorkerToMaster[1]);
 
-        // Envoyer au premier worker l'ordre de fin (cf. master_worker.h)
-        writeToWorker(MW_ORDER_STOP, data->masterToFirstWorker[1]);
+    float *elements = malloc(nbOfElements * sizeof(float));
+    myassert(elements != NULL, "Erreur");
+    readFromClient(session, elements, nbOfElements * sizeof(float));
 
-        // Attendre la fin du premier worker
-        waitpid(data->firstWorkerPid, NULL, 0);
-
-    }
+    // Insérer le tableau en un seul lot
+    insertBatch(data, elements, nbOfElements);
+    logInsert(data, elements, nbOfElements);
 
     // Envoyer l'accusé de réception au client (cf. client_master.h)
-    int ack = CM_ANSWER_STOP_OK;
-    int ret = write(data->masterToClient, &ack, sizeof(int));
-    myassert(ret == sizeof(int), "Erreur");
+    ackInsert(data, session, CM_ANSWER_INSERT_MANY_OK);
 
+    // Libérer la mémoire allouée pour le tableau
+    free(elements);
 }
 
-
-/************************************************************************
- * quel est la cardinalité de l'ensemble
- ************************************************************************/
-void orderHowMany(Data *data)
+// même chose, le tableau étant dans le segment partagé du client : il est
+// trié et inséré sur place (cf. client_master.h)
+void orderInsertManyShm(Data *data, Session *session)
 {
-    TRACE0("[master] ordre how many\n");
+    TRACE0("[master] ordre insertion tableau (mémoire partagée)\n");
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    //TODO
-    // - traiter le cas ensemble vide (pas de premier worker)
-    // - envoyer au premier worker ordre howmany (cf. master_worker.h)
-    // - recevoir accusé de réception venant du premier worker (cf. master_worker.h)
-    // - recevoir résultats (deux quantités) venant du premier worker
-    // - envoyer l'accusé de réception au client (cf. client_master.h)
-    // - envoyer les résultats au client
-    //END TODO
-
-    int ret;
+    int nbOfElements = -1;
+    if (fr_remaining(session->clientToMaster) == (int) sizeof(int))
+        readFromClient(session, &nbOfElements, sizeof(int));
 
-    // Si ensemble vide (pas de premier worker), envoyer l'accusé de réception dédié au client
-    if (data->firstWorkerPid == -1)
+    // le nombre vient du client : le segment doit le contenir
+    size_t size = (size_t) nbOfElements * sizeof(float);
+    float *elements = (nbOfElements > 0) ? payloadOpen(session->pid, size) : NULL;
+    if (elements == NULL)
     {
-        // - envoyer l'accusé de réception au client (cf. client_master.h)
-        int ack = CM_ANSWER_HOW_MANY_OK;
-        ret = write(data->masterToClient, &ack, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-
-        // Envoyer les résultats au client l'ensemble est vide
-        int res = 0;
-        int car = 0;
-        ret = write(data->masterToClient, &res, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-
-        ret = write(data->masterToClient, &car, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
+        TRACE1("[master] segment du client %d absent ou trop petit\n", (int) session->pid);
+        fr_skip(session->clientToMaster);
+        writeAckToClient(session, CM_ANSWER_INSERT_MANY_ERROR);
+        return;
     }
-    else
-    {
-        // Envoyer au premier worker ordre howmany (cf. master_worker.h)
-        writeToWorker(MW_ORDER_HOW_MANY, data->masterToFirstWorker[1]);
+    insertBatch(data, elements, nbOfElements);
+    logInsert(data, elements, nbOfElements);
+    payloadClose(elements, size);
 
-        // Recevoir accusé de réception vanant du premier worker (cf. master_worker.f)
-        ret = readWorker(data->firstWorkerToMaster[0]);
-        myassert(ret == MW_ANSWER_HOW_MANY, "Erreur");
+    ackInsert(data, session, CM_ANSWER_INSERT_MANY_OK);
+}
 
-        // Recevoir résultats (deux quantités) venant du premier worker
-        int res1, res2;
-        ret = read(data->firstWorkerToMaster[0], &res1, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
 
-        ret = read(data->firstWorkerToMaster[0], &res2, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
+/************************************************************************
+ * export trié vers le client, instantané
+ ************************************************************************/
+// toutes les paires (élément, cardinalité) triées, dans <*nb> entrées à
+// rendre par releaseEntries ; les workers remplissent en parallèle un
+// segment partagé (cf. master_worker.h)
+static ExportEntry * collectEntries(Data *data, int *nb)
+{
+    ExportEntry *entries = NULL;
+    *nb = 0;
 
-        // - envoyer l'accusé de réception au client (cf. client_master.h)
-        int ack = CM_ANSWER_HOW_MANY_OK;
-        ret = write(data->masterToClient, &ack, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
+    if (data->engine == ENGINE_ARENA)
+    {
+        int nbElements;
+        tr_howMany(data->tree, &nbElements, nb);
+        if (*nb == 0)
+            return NULL;
+        float *elts = malloc(*nb * sizeof(float));
+        int *cardinalities = malloc(*nb * sizeof(int));
+        entries = malloc(*nb * sizeof(ExportEntry));
+        myassert(elts != NULL && cardinalities != NULL && entries != NULL, "Erreur");
+        tr_export(data->tree, elts, cardinalities);
+        for (int i = 0; i < *nb; i++)
+        {
+            entries[i].elt = elts[i];
+            entries[i].cardinality = cardinalities[i];
+        }
+        free(elts);
+        free(cardinalities);
+    }
+    else if (! isEmpty(data))
+    {
+        // le nombre d'éléments distincts de chaque shard (taille du
+        // segment et indices) n'est connu qu'à la fin des insertions
+        waitAllRequests(data);
+        int reqIds[MAX_SHARDS];
+        int nbDistinct[MAX_SHARDS];
+        for (int i = 0; i < data->nbShards; i++)
+        {
+            Shard *shard = &(data->shards[i]);
+            if (shardIsEmpty(shard))
+                continue;
+            reqIds[i] = startRequest(data, shard, MW_ORDER_HOW_MANY, NULL);
+            endMessageToWorker(shard->masterToFirstWorker[1]);
+        }
+        Request result;
+        for (int i = 0; i < data->nbShards; i++)
+        {
+            nbDistinct[i] = 0;
+            if (shardIsEmpty(&(data->shards[i])))
+                continue;
+            waitRequest(data, reqIds[i], &result);
+            nbDistinct[i] = result.results[1];
+            *nb += nbDistinct[i];
+        }
 
-        // Envoyer les résultats au client
-        int res[2] = {res1, res2};
-        ret = write(data->masterToClient, res, 2 * sizeof(int));
-        myassert(ret == 2 * sizeof(int), "Erreur");
+        // chaque shard remplit son bloc du segment, tous en parallèle
+        entries = exportCreate(getpid(), *nb);
+        int reqId = MW_NO_REQUEST;
+        int start = 0;
+        for (int i = 0; i < data->nbShards; i++)
+        {
+            Shard *shard = &(data->shards[i]);
+            if (shardIsEmpty(shard))
+                continue;
+            if (reqId == MW_NO_REQUEST)
+                reqId = startRequest(data, shard, MW_ORDER_EXPORT, NULL);
+            else
+                joinRequest(data, shard, reqId);
+            writeToWorker(getpid(), shard->masterToFirstWorker[1]);
+            writeToWorker(start, shard->masterToFirstWorker[1]);
+            writeToWorker(*nb, shard->masterToFirstWorker[1]);
+            endMessageToWorker(shard->masterToFirstWorker[1]);
+            start += nbDistinct[i];
+        }
+        waitRequest(data, reqId, &result);
+        myassert(result.answer == MW_ANSWER_EXPORT, "Erreur");
     }
+
+    return entries;
 }
 
+static void releaseEntries(Data *data, ExportEntry *entries, int nb)
+{
+    if (data->engine == ENGINE_ARENA)
+        free(entries);
+    else if (entries != NULL)
+    {
+        exportClose(entries, nb);
+        exportDestroy(getpid());
+    }
+}
 
-/************************************************************************
- * quel est la minimum de l'ensemble
- ************************************************************************/
-void orderMinimum(Data *data)
+void orderExport(Data *data, Session *session)
 {
-    TRACE0("[master] ordre minimum\n");
+    TRACE0("[master] ordre export\n");
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    //TODO
-    // - si ensemble vide (pas de premier worker)
-    //       . envoyer l'accusé de réception dédié au client (cf. client_master.h)
-    // - sinon
-    //       . envoyer au premier worker ordre minimum (cf. master_worker.h)
-    //       . recevoir accusé de réception venant du worker concerné (cf. master_worker.h)
-    //       . recevoir résultat (la valeur) venant du worker concerné
-    //       . envoyer l'accusé de réception au client (cf. client_master.h)
-    //       . envoyer le résultat au client
-    //END TODO
+    int nb;
+    ExportEntry *entries = collectEntries(data, &nb);
 
+    // le tableau part sans copie, en une seule écriture
+    answerReady(session);
+    fr_begin(session->masterToClient, CM_ANSWER_EXPORT_OK, 0);
+    fr_putInt(session->masterToClient, nb);
+    fr_endLarge(session->masterToClient, entries, nb * sizeof(ExportEntry));
+    answersWritten(session);
 
-    int ret;
+    releaseEntries(data, entries, nb);
+}
 
+// écriture de l'ensemble dans un fichier (cf. snapshot.h), relu par
+// master --load
+void orderSnapshot(Data *data, Session *session)
+{
+    TRACE0("[master] ordre instantané\n");
+    myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    // Si ensemble vide (pas de premier worker), envoyer l'accusé de réception dédié au client
-    if (data->firstWorkerPid == -1)
+    // Recevoir le chemin (relatif au répertoire du master)
+    // la longueur vient du client : elle doit être celle du reste de la
+    // trame, et laisser la place du '\0'
+    int length = -1;
+    if (fr_remaining(session->clientToMaster) >= (int) sizeof(int))
+        readFromClient(session, &length, sizeof(int));
+    if (length <= 0 || length >= CM_PATH_SIZE || length != fr_remaining(session->clientToMaster))
     {
-        // - envoyer l'accusé de réception dédié au client (cf. client_master.h)
-        int ack = CM_ANSWER_MINIMUM_EMPTY;
-        int ret = write(data->masterToClient, &ack, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
+        TRACE1("[master] chemin du client %d incorrect\n", (int) session->pid);
+        fr_skip(session->clientToMaster);
+        writeAckToClient(session, CM_ANSWER_SNAPSHOT_ERROR);
+        return;
     }
+    char path[CM_PATH_SIZE];
+    readFromClient(session, path, length);
+    path[length] = '\0';
+
+    int nb;
+    ExportEntry *entries = collectEntries(data, &nb);
+    bool ok = sn_write(path, entries, nb);
+    releaseEntries(data, entries, nb);
+
+    // un chemin incorrect n'arrête pas le master
+    if (ok)
+        writeAnswerToClient(session, CM_ANSWER_SNAPSHOT_OK, &nb, sizeof(int));
     else
-    {
-        // Envoyer au premier worker l'ordre minimum (cf. master_worker.h)
-        writeToWorker(MW_ORDER_MINIMUM, data->masterToFirstWorker[1]);
-
-        // Recevoir accusé de réception venant du worker concerné (cf. master_worker.h)
-        ret = readWorker(data->workersToMaster[0]);
-        myassert(ret == MW_ANSWER_MINIMUM, "Erreur");
-
-        // Recevoir résultat (la valeur) venant du worker concerné
-        int resultMinimum;
-        ret = read(data->workersToMaster[0], &resultMinimum, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-
-        // Envoyer l'accusé de réception au client (cf. client_master.h)
-        int ack = CM_ANSWER_MINIMUM_OK;
-        ret = write(data->masterToClient, &ack, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-
-        // Envoyer le résultat au client
-        ret = write(data->masterToClient, &resultMinimum, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-    }
-
+        writeAckToClient(session, CM_ANSWER_SNAPSHOT_ERROR);
 }
 
 
 /************************************************************************
- * quel est la maximum de l'ensemble
+ * affichage ordonné
  ************************************************************************/
-void orderMaximum(Data *data)
+void orderPrint(Data *data, Session *session)
 {
-    TRACE0("[master] ordre maximum\n");
+    TRACE0("[master] ordre affichage\n");
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    int ret;
-
-    // Si ensemble vide (pas de premier worker), envoyer l'accusé de réception dédié au client
-    if (data->firstWorkerPid == -1)
+    if (data->engine == ENGINE_ARENA)
     {
-        // - envoyer l'accusé de réception dédié au client (cf. client_master.h)
-        int ack = CM_ANSWER_MAXIMUM_EMPTY;
-        int ret = write(data->masterToClient, &ack, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
+        tr_print(data->tree);
     }
     else
     {
-        // Envoyer au premier worker l'ordre maximum (cf. master_worker.h)
-        writeToWorker(MW_ORDER_MAXIMUM, data->masterToFirstWorker[1]);
-
-        // Recevoir accusé de réception venant du worker concerné (cf. master_worker.h)
-        ret = readWorker(data->workersToMaster[0]);
-        myassert(ret == MW_ANSWER_MAXIMUM, "Erreur");
-
-        // Recevoir résultat (la valeur) venant du worker concerné
-        int resultMaximum;
-        ret = read(data->workersToMaster[0], &resultMaximum, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-
-        // Envoyer l'accusé de réception au client (cf. client_master.h)
-        int ack = CM_ANSWER_MAXIMUM_OK;
-        ret = write(data->masterToClient, &ack, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-
-        // Envoyer le résultat au client
-        ret = write(data->masterToClient, &resultMaximum, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
+        // les workers remplissent l'export tous en même temps (au lieu de
+        // s'afficher l'un après l'autre, dans l'ordre infixe) : le master
+        // affiche ensuite les paires triées
+        int nb;
+        ExportEntry *entries = collectEntries(data, &nb);
+        for (int i = 0; i < nb; i++)
+            printf("Element: %g, Cardinality: %d\n", entries[i].elt, entries[i].cardinality);
+        fflush(stdout);
+        releaseEntries(data, entries, nb);
     }
 
+    // Envoyer l'accusé de réception au client (cf. client_master.h)
+    writeAckToClient(session, CM_ANSWER_PRINT_OK);
 }
 
 
 /************************************************************************
- * test d'existence
+ * parcours d'une page de l'ensemble trié
  ************************************************************************/
-void orderExist(Data *data)
+void orderScan(Data *data, Session *session)
 {
-    TRACE0("[master] ordre existence\n");
+    TRACE0("[master] ordre parcours\n");
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    //TODO
-    // - recevoir l'élément à tester en provenance du client
-    // - si ensemble vide (pas de premier worker)
-    //       . envoyer l'accusé de réception dédié au client (cf. client_master.h)
-    // - sinon
-    //       . envoyer au premier worker ordre existence (cf. master_worker.h)
-    //       . envoyer au premier worker l'élément à tester
-    //       . recevoir accusé de réception venant du worker concerné (cf. master_worker.h)
-    //       . si élément non présent
-    //             . envoyer l'accusé de réception dédié au client (cf. client_master.h)
-    //       . sinon
-    //             . recevoir résultat (une quantité) venant du worker concerné
-    //             . envoyer l'accusé de réception au client (cf. client_master.h)
-    //             . envoyer le résultat au client
-    //END TODO
-
-    // Recevoir l'élément à tester en provenance du client
-    int elementToTest;
-    int ret;
-
-    ret = read(data->clientToMaster, &elementToTest, sizeof(int));
-    myassert(ret == sizeof(int), "Erreur");
+    float after;
+    int limit;
+    readFromClient(session, &after, sizeof(float));
+    readFromClient(session, &limit, sizeof(int));
 
-    // Si ensemble vide (pas de premier worker)
-    if (data->firstWorkerPid == -1)
+    // la limite vient du client : limit + 1 ne doit pas déborder
+    if (limit <= 0 || limit > CM_MAX_SCAN_LIMIT)
     {
-        // - envoyer l'accusé de réception dédié au client (cf. client_master.h)
-        int ack = CM_ANSWER_EXIST_NO;
-        ret = write(data->masterToClient, &ack, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
+        writeAckToClient(session, CM_ANSWER_SCAN_ERROR);
+        return;
     }
-    else
-    {
-        // Envoyer au premier worker l'ordre existence (cf. master_worker.h)
-        writeToWorker(MW_ORDER_EXIST, data->masterToFirstWorker[1]);
 
-        // Envoyer au premier worker l'élément à tester
-        writeToWorker(elementToTest, data->masterToFirstWorker[1]);
+    // une paire de plus que la page : elle dit s'il y a une suite
+    int nb = 0;
+    ExportEntry *entries = NULL;
 
-        // Recevoir l'accusé de réception du worker concerné
-        ret = readWorker(data->workersToMaster[0]);
-        myassert(ret == sizeof(int), "Erreur");
-
-        if (ret == MW_ANSWER_EXIST_NO)
+    if (data->engine == ENGINE_ARENA)
+    {
+        float *elts = malloc((limit + 1) * sizeof(float));
+        int *cardinalities = malloc((limit + 1) * sizeof(int));
+        entries = malloc((limit + 1) * sizeof(ExportEntry));
+        myassert(elts != NULL && cardinalities != NULL && entries != NULL, "Erreur");
+        nb = tr_scan(data->tree, after, limit + 1, elts, cardinalities);
+        for (int i = 0; i < nb; i++)
         {
-
-            // Si élément non présent, envoyer l'accusé de réception dédié au client
-            int ack = CM_ANSWER_EXIST_NO;
-            ret = write(data->masterToClient, &ack, sizeof(int));
-            myassert(ret == sizeof(int), "Erreur");
-
+            entries[i].elt = elts[i];
+            entries[i].cardinality = cardinalities[i];
         }
-        else
+        free(elts);
+        free(cardinalities);
+    }
+    else
+    {
+        // les workers parcourent un arbre stable ; les shards sont
+        // parcourus dans l'ordre, à partir de celui de <after>, jusqu'à
+        // remplir la page
+        waitAllRequests(data);
+        entries = malloc((limit + 1) * sizeof(ExportEntry));
+        myassert(entries != NULL, "Erreur");
+        for (int i = shardOf(data, after); i < data->nbShards && nb < limit + 1; i++)
         {
-
-            // Si élément présent, recevoir le résultat (une quantité) du worker concerné
-            int quantity;
-            ret = read(data->workersToMaster[0], &quantity, sizeof(int));
-            myassert(ret == sizeof(int), "Erreur");
-
-            // Envoyer l'accusé de réception au client (cf. client_master.h)
-            int ack = CM_ANSWER_EXIST_YES;
-            ret = write(data->masterToClient, &ack, sizeof(int));
-            myassert(ret == sizeof(int), "Erreur");
-
-            // Envoyer le résultat au client
-            ret = write(data->masterToClient, &quantity, sizeof(int));
-            myassert(ret == sizeof(int), "Erreur");
+            Shard *shard = &(data->shards[i]);
+            if (shardIsEmpty(shard))
+                continue;
+            int reqId = startRequest(data, shard, MW_ORDER_SCAN, NULL);
+            writeFloatToWorker(after, shard->masterToFirstWorker[1]);
+            writeToWorker(limit + 1 - nb, shard->masterToFirstWorker[1]);
+            endMessageToWorker(shard->masterToFirstWorker[1]);
+
+            Request result;
+            waitRequest(data, reqId, &result);
+            myassert(result.answer == MW_ANSWER_SCAN, "Erreur");
+            memcpy(entries + nb, result.entries, result.results[0] * sizeof(ExportEntry));
+            nb += result.results[0];
+            free(result.entries);
         }
     }
+
+    // la suite reprend après le dernier élément de la page
+    int more = (nb > limit);
+    if (more)
+        nb = limit;
+    float cursor = (nb > 0) ? entries[nb - 1].elt : after;
+
+    answerReady(session);
+    fr_begin(session->masterToClient, CM_ANSWER_SCAN_OK, 0);
+    fr_putInt(session->masterToClient, nb);
+    fr_putInt(session->masterToClient, more);
+    fr_putFloat(session->masterToClient, cursor);
+    fr_endLarge(session->masterToClient, entries, nb * sizeof(ExportEntry));
+    answersWritten(session);
+    free(entries);
 }
 
+
 /************************************************************************
- * somme
+ * profondeur de l'arbre (vérification de l'équilibrage)
  ************************************************************************/
-void orderSum(Data *data)
+void orderDepth(Data *data, Session *session)
 {
-TRACE0("[master] ordre somme\n");
+    TRACE0("[master] ordre profondeur\n");
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    int ret;
+    // ensemble vide : profondeur 0
+    int depth = 0;
 
-    // Si ensemble vide (pas de premier worker), la somme est alors 0
-    if (data->firstWorkerPid == -1)
+    if (data->engine == ENGINE_ARENA)
     {
-        // Envoyer l'accusé de réception au client (cf. client_master.h)
-        int ack = CM_ANSWER_SUM_OK;
-        ret = write(data->masterToClient, &ack, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-
-        int sum = 0;
-        ret = write(data->masterToClient, &sum, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
+        depth = tr_depth(data->tree);
     }
-    else
+    else if (! isEmpty(data))
     {
-        // Envoyer au premier worker l'ordre existence (cf. master_worker.h)
-        writeToWorker(MW_ORDER_SUM, data->masterToFirstWorker[1]);
-
-        // Recevoire accusé de réception venant du premier worker
-        ret = readWorker(data->firstWorkerToMaster[0]);
-        myassert(ret == MW_ANSWER_SUM, "Erreur");
-
-        // Recevoir le résultat (la somme) venant du premier worker
-        int resultSum;
-        ret = read(data->firstWorkerToMaster[0], &resultSum, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-
-        // Envoyer l'accusé de réception au client (cf. client_master.h)
-        int ack = CM_ANSWER_SUM_OK;
-        ret = write(data->masterToClient, &ack, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-
-        // Envoyer le résultat au client
-        ret = write(data->masterToClient, &resultSum, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
+        // le premier worker connaît la hauteur de tout son arbre, une fois
+        // les insertions terminées (rotations comprises) ; c'est le shard le
+        // plus profond qui compte
+        waitAllRequests(data);
+        Request result;
+        requestAll(data, MW_ORDER_DEPTH, &result);
+        myassert(result.answer == MW_ANSWER_DEPTH, "Erreur");
+        depth = result.results[0];
     }
 
+    writeAnswerToClient(session, CM_ANSWER_DEPTH_OK, &depth, sizeof(int));
 }
 
+
 /************************************************************************
- * insertion d'un élément
+ * chargement d'un instantané au démarrage
  ************************************************************************/
-
-//TODO voir si une fonction annexe commune à orderInsert et orderInsertMany est justifiée
-
-void orderInsert(Data *data)
+// l'arbre est construit directement équilibré : chaque sous-arbre part de
+// l'élément du milieu de sa tranche (cf. MW_ORDER_LOAD) ; la durée et la
+// profondeur obtenue sont affichées
+static void loadSnapshot(Data *data)
 {
-    TRACE0("[master] ordre insertion\n");
-    myassert(data != NULL, "il faut l'environnement d'exécution");
-
-    //TODO
-    // - recevoir l'élément à insérer en provenance du client
-    // - si ensemble vide (pas de premier worker)
-    //       . créer le premier worker avec l'élément reçu du client
-    // - sinon
-    //       . envoyer au premier worker ordre insertion (cf. master_worker.h)
-    //       . envoyer au premier worker l'élément à insérer
-    // - recevoir accusé de réception venant du worker concerné (cf. master_worker.h)
-    // - envoyer l'accusé de réception au client (cf. client_master.h)
-    //END TODO
-
-    // - recevoir l'élément à insérer en provenance du client
-    int elementToInsert;
-    int ret;
+    double start = ut_now();
 
-    ret = read(data->clientToMaster, &elementToInsert, sizeof(int));
-    myassert(ret == sizeof(int), "Erreur");
+    const SnapshotHeader *snapshot = sn_map(data->loadPath);
+    myassert(snapshot != NULL, "instantané absent ou invalide");
+    const ExportEntry *entries = sn_entries(snapshot);
+    int nb = snapshot->nbEntries;
+    int depth = 0;
 
-    if (data->firstWorkerPid == -1)
+    if (data->engine == ENGINE_ARENA)
     {
-        // - si ensemble vide (pas de premier worker)
-        //       . créer le premier worker avec l'élément reçu du client
-        data->firstWorkerPid = fork();
-        myassert(data->firstWorkerPid!= -1, "fork n'a pas fonctionné");
-
-        if (data->firstWorkerPid == 0)
+        float *elts = malloc(nb * sizeof(float));
+        int *cardinalities = malloc(nb * sizeof(int));
+        myassert((elts != NULL && cardinalities != NULL) || nb == 0, "Erreur");
+        for (int i = 0; i < nb; i++)
         {
-            createWorker(elementToInsert, data->masterToFirstWorker[0], data->firstWorkerToMaster[1], data->workersToMaster[1] );
-            myassert(false, "Erreur");
+            elts[i] = entries[i].elt;
+            cardinalities[i] = entries[i].cardinality;
         }
+        tr_build(data->tree, elts, cardinalities, nb);
+        free(elts);
+        free(cardinalities);
+        depth = tr_depth(data->tree);
     }
-    else
+    else if (nb > 0)
     {
-        // Envoyer au premier worker l'ordre insertion (cf. master_worker.h)
-        writeToWorker(MW_ORDER_INSERT, data->masterToFirstWorker[1]);
-
-        // Envoyer au premier worker l'élément à insérer
-        writeToWorker(elementToInsert, data->masterToFirstWorker[1]);
+        // chaque shard charge sa tranche du fichier, tous en parallèle : le
+        // premier worker prend l'élément du milieu, puis construit ses deux
+        // sous-arbres
+        int reqId = MW_NO_REQUEST;
+        int lo = 0;
+        for (int i = 0; i < data->nbShards; i++)
+        {
+            int hi = lo;
+            while (hi < nb && shardOf(data, entries[hi].elt) == i)
+            {
+                data->shards[i].nbElements += entries[hi].cardinality;
+                hi++;
+            }
+            if (hi == lo)
+                continue;
+
+            Shard *shard = &(data->shards[i]);
+            const ExportEntry *mid = &(entries[lo + (hi - lo) / 2]);
+            createFirstWorker(data, shard, mid->elt, mid->cardinality);
+            if (reqId == MW_NO_REQUEST)
+                reqId = startRequest(data, shard, MW_ORDER_LOAD, NULL);
+            else
+                joinRequest(data, shard, reqId);
+            writeStringToWorker(data->loadPath, shard->masterToFirstWorker[1]);
+            writeToWorker(lo, shard->masterToFirstWorker[1]);
+            writeToWorker(hi, shard->masterToFirstWorker[1]);
+            endMessageToWorker(shard->masterToFirstWorker[1]);
+            lo = hi;
+        }
 
+        Request result;
+        waitRequest(data, reqId, &result);
+        myassert(result.answer == MW_ANSWER_LOAD, "Erreur");
+        requestAll(data, MW_ORDER_DEPTH, &result);
+        depth = result.results[0];
     }
 
-    // Recevoir l'accusé de réception venant du worker concerné (cf. master_worker.h)
-    ret = readWorker(data->workersToMaster[0]);
-    myassert(ret == MW_ANSWER_INSERT, "Erreur");
-
-    // Envoyer l'accusé de réception au client (cf. client_master.h)
-    int ack = CM_ANSWER_INSERT_OK;
-    ret = write(data->masterToClient, &ack, sizeof(int));
-    myassert(ret == sizeof(int), "Erreur");
+    printf("[master] %s chargé : %d élément(s), %d distinct(s), en %.3f s, profondeur %d\n",
+           data->loadPath, snapshot->nbElements, nb, ut_now() - start, depth);
+    fflush(stdout);
+    sn_unmap(snapshot);
 }
 
 
 /************************************************************************
- * insertion d'un tableau d'éléments
+ * journal des insertions au démarrage
  ************************************************************************/
-void orderInsertMany(Data *data)
+// les insertions journalisées sont rejouées en un seul lot, après
+// l'éventuel instantané ; le journal reste ouvert pour les suivantes
+static void replayLog(Data *data)
 {
-    TRACE0("[master] ordre insertion tableau\n");
-    myassert(data != NULL, "il faut l'environnement d'exécution");
-
-    //TODO
-    // - recevoir le tableau d'éléments à insérer en provenance du client
-    // - pour chaque élément du tableau
-    //       . l'insérer selon l'algo vu dans orderInsert (penser à factoriser le code)
-    // - envoyer l'accusé de réception au client (cf. client_master.h)
-    //END TODO
-
-    // - recevoir le tableau d'éléments à insérer en provenance du client
-    int nbOfElements;
-    int ret;
-    ret  = read(data->clientToMaster, &nbOfElements, sizeof(int));
-    myassert(ret == sizeof(int), "Erreur");
-
-    int* elements = (int*)malloc(nbOfElements * sizeof(int));
-    ret = read(data->clientToMaster, elements, nbOfElements * sizeof(int));
-    myassert(ret == -1, "Erreur");
+    double start = ut_now();
 
-    // Insérer chaque élément du tableau
-    for (int i = 0; i < nbOfElements; ++i)
-    {
-        // Envoyer au premier worker l'ordre insertion (cf. master_worker.h)
-        writeToWorker(MW_ORDER_INSERT, data->masterToFirstWorker[1]);
-
-        // Envoyer au premier worker l'élément à insérer
-        ret = write(data->masterToFirstWorker[1], &elements[i], sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-    }
-
-    // Envoyer l'accusé de réception au client (cf. client_master.h)
-    int ack = CM_ANSWER_INSERT_OK;
-    ret = write(data->masterToClient, &ack, sizeof(int));
-    myassert(ret == sizeof(int), "Erreur");
-
-    // Libérer la mémoire allouée pour le tableau
+    data->wal = wl_open(data->walPath);
+    int nb;
+    float *elements = wl_replay(data->wal, &nb);
+    if (nb > 0)
+        insertBatch(data, elements, nb);
     free(elements);
 
+    printf("[master] journal %s rejoué : %d insertion(s) en %.3f s\n",
+           data->walPath, nb, ut_now() - start);
+    fflush(stdout);
 }
 
 
 /************************************************************************
- * affichage ordonné
+ * statistiques de latence
  ************************************************************************/
-void orderPrint(Data *data)
+// histogrammes de chaque type d'ordre reçu depuis le démarrage ; celui de
+// l'ordre stats compte cette demande-ci (sauf son écriture)
+void orderStats(Data *data, Session *session)
 {
-    TRACE0("[master] ordre affichage\n");
+    TRACE0("[master] ordre stats\n");
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    //TODO
-    // - traiter le cas ensemble vide (pas de premier worker)
-    // - envoyer au premier worker ordre print (cf. master_worker.h)
-    // - recevoir accusé de réception venant du premier worker (cf. master_worker.h)
-    //   note : ce sont les workers qui font les affichages
-    // - envoyer l'accusé de réception au client (cf. client_master.h)
-    //END TODO
+    answerReady(session);
+    fr_begin(session->masterToClient, CM_ANSWER_STATS_OK, 0);
+    fr_putInt(session->masterToClient, data->stats.nbOrders);
+    fr_endLarge(session->masterToClient, data->stats.orders, data->stats.nbOrders * sizeof(StOrderStats));
+    answersWritten(session);
+}
 
-    int ret;
 
-    // Si ensemble vide (pas de premier worker), la somme est alors 0
-    if (data->firstWorkerPid == -1)
+/************************************************************************
+ * boucle principale de communication avec les clients
+ ************************************************************************/
+// un ordre d'un client ; renvoie true pour l'ordre de fin
+static bool orderAction(Data *data, Session *session, int order)
+{
+    switch(order)
     {
-
-        close(data->masterToFirstWorker[0]);
-        close(data->firstWorkerToMaster[1]);
+    case CM_ORDER_STOP:
+        orderStop(data, session);
+        return true;
+    case CM_ORDER_HOW_MANY:
+        orderHowMany(data, session);
+        break;
+    case CM_ORDER_MINIMUM:
+        orderMinimum(data, session);
+        break;
+    case CM_ORDER_MAXIMUM:
+        orderMaximum(data, session);
+        break;
+    case CM_ORDER_EXIST:
+        orderExist(data, session);
+        break;
+    case CM_ORDER_SUM:
+        orderSum(data, session);
+        break;
+    case CM_ORDER_RANGE_COUNT:
+    case CM_ORDER_RANGE_SUM:
+        orderRange(data, session, order);
+        break;
+    case CM_ORDER_KTH:
+        orderKth(data, session);
+        break;
+    case CM_ORDER_PERCENTILE:
+        orderPercentile(data, session);
+        break;
+    case CM_ORDER_RANK:
+        orderRank(data, session);
+        break;
+    case CM_ORDER_INSERT:
+        orderInsert(data, session);
+        break;
+    case CM_ORDER_INSERT_MANY:
+        orderInsertMany(data, session);
+        break;
+    case CM_ORDER_INSERT_MANY_SHM:
+        orderInsertManyShm(data, session);
+        break;
+    case CM_ORDER_PRINT:
+        orderPrint(data, session);
+        break;
+    case CM_ORDER_DEPTH:
+        orderDepth(data, session);
+        break;
+    case CM_ORDER_EXPORT:
+        orderExport(data, session);
+        break;
+    case CM_ORDER_SCAN:
+        orderScan(data, session);
+        break;
+    case CM_ORDER_SNAPSHOT:
+        orderSnapshot(data, session);
+        break;
+    case CM_ORDER_STATS:
+        orderStats(data, session);
+        break;
+    default:
+        myassert(false, "ordre inconnu");
+        exit(EXIT_FAILURE);
+        break;
     }
-    else
+    return false;
+}
+
+// les ordres d'un client : un ordre est une trame (cf. frame.h) ; une
+// lecture peut en apporter plusieurs, ou seulement le début d'une : elle
+// attend alors la suite dans le tampon. Renvoie true pour l'ordre de fin
+static bool sessionAction(Data *data, Session *session)
+{
+    bool open = fr_receive(session->clientToMaster, CM_MAX_ORDER_LENGTH);
+
+    while (fr_complete(session->clientToMaster))
     {
+        //TODO pour que ça ne boucle pas, mais recevoir l'ordre du client
+        FrameHeader header;
+        long calls = fr_syscalls();
+        fr_next(session->clientToMaster, &header);
 
-        // Sinon, envoyer au premier worker l'ordre print (cf. master_worker.h)
-        writeToWorker(MW_ORDER_PRINT, data->masterToFirstWorker[1]);
+        // les accusés d'insertion en attente partent avant toute autre
+        // réponse à ce client
+        if (session->nbUnsynced > 0 && insertAck(header.opcode) != session->unsyncedAck)
+            commitLog(data);
 
-        // Recevoir l'accusé de réception venant du premier worker (cf. master_worker.h)
-        ret = readWorker(data->firstWorkerToMaster[0]);
-        myassert(ret == MW_ANSWER_PRINT, "Erreur");
+        session->timer.order = header.opcode;
+        session->timer.ready = data->tourStart;
+        session->timer.start = ut_now();
 
-        // Envoyer l'accusé de réception au client (cf. client_master.h)
-        int ack = CM_ANSWER_PRINT_OK;
-        ret = write(data->masterToClient, &ack, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
+        if (orderAction(data, session, header.opcode))
+            return true;
 
+        TRACE1("[master] fin ordre (%ld appels système)\n", fr_syscalls() - calls);
     }
-}
 
+    // fin du tube (le client a terminé) ou en-tête invalide : la session
+    // est fermée, un ordre incomplet est abandonné
+    if (! open)
+        endSession(data, session);
+    return false;
+}
 
-/************************************************************************
- * boucle principale de communication avec le client
- ************************************************************************/
+// le master attend sur tous les canaux à la fois (epoll) : nouveaux
+// clients, ordres des clients connectés et réponses des workers
 void loop(Data *data)
 {
     bool end = false;
 
     init(data);
-
+    if (data->loadPath != NULL)
+        loadSnapshot(data);
+    if (data->walPath != NULL)
+        replayLog(data);
 
     while (! end)
     {
-        int ret;
-
-        //TODO ouverture des tubes avec le client (cf. explications dans client.c)
-        // Ouvrir le tube vers le client (à compléter avec le nom du tube approprié)
-        data->masterToClient = open(MASTER_TO_CLIENT, O_WRONLY);
-        myassert(data->masterToClient != -1, "Erreur");
-
-        // Ouvrir le tube depuis le client (à compléter avec le nom du tube approprié)
-        data->clientToMaster = open(CLIENT_TO_MASTER, O_RDONLY);
-        myassert(data->clientToMaster != -1, "Erreur");
-
-
-        //TODO pour que ça ne boucle pas, mais recevoir l'ordre du client
-        int order;
-        ret = read(data->clientToMaster, &order, sizeof(int));
-        myassert(ret != -1, "clientToMaster n'est pas lu");
-
-        switch(order)
+        // les insertions de ce tour sont synchronisées ensemble, puis les
+        // réponses (aux clients, aux workers) partent avant l'attente
+        commitLog(data);
+        flushAll(data);
+
+        struct epoll_event events[MAX_EVENTS];
+        int nb = epoll_wait(data->epoll, events, MAX_EVENTS, -1);
+        if (nb == -1 && errno == EINTR)
+            continue;
+        myassert(nb != -1, "Erreur");
+        data->tourStart = ut_now();
+
+        // les nouveaux clients sont acceptés en dernier : une case de
+        // session libérée pendant ce tour n'est pas réutilisée avant la
+        // fin du tour
+        bool registration = false;
+
+        for (int i = 0; i < nb && ! end; i++)
         {
-        case CM_ORDER_STOP:
-            orderStop(data);
-            end = true;
-            break;
-        case CM_ORDER_HOW_MANY:
-            orderHowMany(data);
-            break;
-        case CM_ORDER_MINIMUM:
-            orderMinimum(data);
-            break;
-        case CM_ORDER_MAXIMUM:
-            orderMaximum(data);
-            break;
-        case CM_ORDER_EXIST:
-            orderExist(data);
-            break;
-        case CM_ORDER_SUM:
-            orderSum(data);
-            break;
-        case CM_ORDER_INSERT:
-            orderInsert(data);
-            break;
-        case CM_ORDER_INSERT_MANY:
-            orderInsertMany(data);
-            break;
-        case CM_ORDER_PRINT:
-            orderPrint(data);
-            break;
-        default:
-            myassert(false, "ordre inconnu");
-            exit(EXIT_FAILURE);
-            break;
+            int tag = events[i].data.u32;
+            if (tag == EV_REGISTRATION)
+            {
+                registration = true;
+            }
+            else if (tag >= EV_OUTPUT)
+            {
+                // de la place pour les réponses en file : elles partent
+                // au prochain flushAll
+            }
+            else if (tag >= EV_WORKERS)
+            {
+                // les réponses ont pu être lues pendant un ordre qui les
+                // attendait : on ne lit que ce qui est disponible
+                while (receiveAnswers(data, 0))
+                    ;
+            }
+            else
+            {
+                Session *session = &(data->sessions[tag]);
+                if (session->pid != -1 && ! session->closing)
+                    end = sessionAction(data, session);
+            }
         }
 
-        //TODO fermer les tubes nommés
-        ret = close(data->masterToClient);
-        myassert(ret == 0, "tubeMasterToClient n'est pas fermé");
-
-        ret = close(data->clientToMaster);
-        myassert(ret == 0, "tubeClientToMaster n'est pas fermé");
-        //     il est important d'ouvrir et fermer les tubes nommés à chaque itération
-        //     voyez-vous pourquoi ?
-        //TODO attendre ordre du client avant de continuer (sémaphore pour une précédence)
-        //entrerSC(data->semWait);
+        if (registration && ! end)
+            acceptSessions(data);
+    }
 
-        sleep(1);
+    // fin : insertions des autres clients pendant le dernier tour, puis
+    // fermeture de toutes les sessions
+    commitLog(data);
+    for (int i = 0; i < MAX_SESSIONS; i++)
+        if (data->sessions[i].pid != -1)
+            closeSession(data, &(data->sessions[i]));
+    if (data->wal != NULL)
+        wl_close(data->wal);
 
-        TRACE0("[master] fin ordre\n");
-    }
+    int ret = close(data->epoll);
+    myassert(ret == 0, "Erreur");
+    ret = close(data->registration);
+    myassert(ret == 0, "Erreur");
+    ret = close(data->registrationKeepAlive);
+    myassert(ret == 0, "Erreur");
 }
 
 
@@ -667,54 +2342,54 @@ void loop(Data *data)
 
 int main(int argc, char * argv[])
 {
-    if (argc != 1){
-        usage(argv[0], NULL);
-    }
-
-    TRACE0("[master] début\n");
-
     Data data;
     int ret;
 
+    parseArgs(argc, argv, &data);
+
+    TRACE0("[master] début\n");
+
     //TODO
     // - création des sémaphores
     //data.semWait = creatSem(PROJ_ID, 1);
 
-    // - création des tubes nommés
-    ret = mkfifo(MASTER_TO_CLIENT, 0644);
-    myassert(ret != -1, "Erreur");
-
-    ret = mkfifo(CLIENT_TO_MASTER, 0644);
+    // - création du tube d'enregistrement des clients (les tubes de
+    //   chaque session sont créés par les clients)
+    ret = mkfifo(REGISTRATION, 0644);
     myassert(ret != -1, "Erreur");
 
     //END TODO
     loop(&data);
 
     //TODO destruction des tubes nommés, des sémaphores, ...
-    ret = unlink(MASTER_TO_CLIENT);
-    myassert(ret != -1, "Erreur");
-
-    ret = unlink(CLIENT_TO_MASTER);
+    ret = unlink(REGISTRATION);
     myassert(ret != -1, "Erreur");
 
     // Détruire les sémaphores
     //destroySemaphore(data.semWait);
 
 
-    ret = close(data.masterToFirstWorker[0]);
-    myassert(ret == 0, "tuben'est pas fermé");
-    ret = close(data.firstWorkerToMaster[1]);
-    myassert(ret == 0, "tubeClientToMaster n'est pas fermé");
+    for (int i = 0; i < data.nbShards; i++)
+    {
+        Shard *shard = &(data.shards[i]);
+        ret = close(shard->masterToFirstWorker[0]);
+        myassert(ret == 0, "tuben'est pas fermé");
+        ret = close(shard->firstWorkerToMaster[1]);
+        myassert(ret == 0, "tubeClientToMaster n'est pas fermé");
 
-    ret = close(data.masterToFirstWorker[1]);
-    myassert(ret == 0, "tube n'est pas fermé");
-    ret = close(data.firstWorkerToMaster[0]);
-    myassert(ret == 0, "tube n'est pas fermé");
+        closeWorker(shard->masterToFirstWorker[1]);
+        closeWorker(shard->firstWorkerToMaster[0]);
+    }
 
-    ret = close(data.workersToMaster[0]);
-    myassert(ret == 0, "tuben'est pas fermé");
+    closeWorker(data.workersToMaster[0]);
     ret = close(data.workersToMaster[1]);
     myassert(ret == 0, "tube n'est pas fermé");
+    for (int i = 0; i < 2; i++)
+        if (data.pool[i] != -1)
+        {
+            ret = close(data.pool[i]);
+            myassert(ret == 0, "socket des zygotes n'est pas fermée");
+        }
 
 
     TRACE0("[master] terminaison\n");
@@ -2,49 +2,379 @@
 #include "config.h"
 #endif
 
+// ftruncate
+#define _XOPEN_SOURCE 500
+
 //TODO include selon ce qu'il y a dans le .h
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
 
+#include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
 
 #include "utils.h"
 #include "myassert.h"
+#include "frame.h"
 
 #include "master_worker.h"
 
 
 //TODO fonctions selon ce qu'il y a dans le .h
 
+// tous les échanges sont des trames (cf. frame.h) : un ordre ou une réponse
+// commence par writeHeaderToWorker, se termine par endMessageToWorker, et
+// les écritures entre les deux ne font aucun appel système
+
 void writeToWorker(int message, int fdWorkerWrite)
 {
-	int ret = write(fdWorkerWrite, &message, sizeof(int));
-	myassert(ret == sizeof(int), "Erreur");
+	fr_putInt(fdWorkerWrite, message);
 }
 
 int readWorker(int fdWorkerRead)
 {
-	int message;
-	int ret = read(fdWorkerRead, &message, sizeof(int));
-	myassert(ret == sizeof(int), "Erreur");
-	return message;
+	return fr_getInt(fdWorkerRead);
+}
+
+
+void writeHeaderToWorker(int code, int reqId, int fdWorkerWrite)
+{
+	fr_begin(fdWorkerWrite, code, reqId);
+}
+
+void endMessageToWorker(int fdWorkerWrite)
+{
+	fr_end(fdWorkerWrite);
+}
+
+int readHeaderWorker(int fdWorkerRead, int *reqId)
+{
+	FrameHeader header;
+	bool ok = fr_next(fdWorkerRead, &header);
+	myassert(ok, "canal fermé");
+	*reqId = header.reqId;
+	return header.opcode;
+}
+
+
+// une trame de moins de PIPE_BUF octets : elle part en une seule écriture et
+// ne se mélange pas avec celle d'un autre worker
+void writeDirectAnswerToMaster(const DirectAnswer *answer, int fdToMaster)
+{
+	fr_begin(fdToMaster, answer->answer, answer->reqId);
+	fr_putFloat(fdToMaster, answer->elt);
+	fr_putInt(fdToMaster, answer->cardinality);
+	fr_end(fdToMaster);
+}
+
+void readDirectAnswer(DirectAnswer *answer, int fdWorkersRead)
+{
+	answer->answer = readHeaderWorker(fdWorkersRead, &(answer->reqId));
+	answer->elt = fr_getFloat(fdWorkersRead);
+	answer->cardinality = fr_getInt(fdWorkersRead);
+}
+
+
+void writeFloatToWorker(float value, int fdWorkerWrite)
+{
+	fr_putFloat(fdWorkerWrite, value);
 }
 
+float readFloatWorker(int fdWorkerRead)
+{
+	return fr_getFloat(fdWorkerRead);
+}
+
+void writeStringToWorker(const char *s, int fdWorkerWrite)
+{
+	int length = strlen(s);
+	fr_putInt(fdWorkerWrite, length);
+	fr_put(fdWorkerWrite, s, length);
+}
 
-void createWorker(int value, int fdIn, int fdOut, int fdToMaster)
+void readStringWorker(char *s, int size, int fdWorkerRead)
 {
-	char *argv[5];
-	char elt = (char)value;
-    char fdI = (char)fdIn;
-    char fdO = (char)fdOut;
-    char fdToM = (char)fdToMaster;
-    argv[0] = "worker";
-    argv[1] = &elt;
-    argv[2] = &fdI;
-    argv[3] = &fdO;
-    argv[4] = &fdToM;
-    argv[5] = NULL;
- 	execv(argv[0], argv);
+	int length = fr_getInt(fdWorkerRead);
+	myassert(length >= 0 && length < size, "chaîne trop longue");
+	fr_get(fdWorkerRead, s, length);
+	s[length] = '\0';
 }
 
+void writeEntriesToWorker(const ExportEntry *entries, int nb, int fdWorkerWrite)
+{
+	fr_put(fdWorkerWrite, entries, nb * sizeof(ExportEntry));
+}
+
+// tableaux (lots d'insertion, pages) : ils peuvent dépasser la taille du
+// tampon, ils terminent donc la trame et sont envoyés sans copie
+void endEntriesToWorker(const ExportEntry *entries, int nb, int fdWorkerWrite)
+{
+	fr_endLarge(fdWorkerWrite, entries, nb * sizeof(ExportEntry));
+}
+
+void readEntriesWorker(ExportEntry *entries, int nb, int fdWorkerRead)
+{
+	fr_get(fdWorkerRead, entries, nb * sizeof(ExportEntry));
+}
+
+
+void writeSummaryToWorker(const Summary *summary, int fdWorkerWrite)
+{
+	fr_put(fdWorkerWrite, summary, sizeof(Summary));
+}
+
+void readSummaryWorker(Summary *summary, int fdWorkerRead)
+{
+	fr_get(fdWorkerRead, summary, sizeof(Summary));
+}
+
+// transmission d'un descripteur à un autre processus (SCM_RIGHTS) ; le canal
+// doit être une socket locale. fd peut valoir -1 (pas de descripteur à passer).
+// Le descripteur ne part qu'avec la trame : on le ferme avec closeWorker, qui
+// envoie d'abord tout ce qui est en attente.
+void writeFdToWorker(int fd, int socketWrite)
+{
+	int present = (fd != -1);
+	fr_putInt(socketWrite, present);
+	if (present)
+		fr_putFd(socketWrite, fd);
+}
+
+int readFdWorker(int socketRead)
+{
+	int present = fr_getInt(socketRead);
+	if (! present)
+		return -1;
+	return fr_getFd(socketRead);
+}
+
+// fermeture d'un canal tramé (et oubli de ses tampons)
+void closeWorker(int fd)
+{
+	fr_close(fd);
+}
+
+static void exportName(pid_t masterPid, char name[MW_EXPORT_NAME_SIZE])
+{
+	snprintf(name, MW_EXPORT_NAME_SIZE, "/%s.%d", MW_EXPORT, (int) masterPid);
+}
+
+// projection de tout le segment ; le descripteur n'est plus utile ensuite
+static ExportEntry * exportMap(int fd, int nb)
+{
+	void *entries = mmap(NULL, nb * sizeof(ExportEntry), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	myassert(entries != MAP_FAILED, "projection du segment d'export");
+	int ret = close(fd);
+	myassert(ret == 0, "Erreur");
+	return entries;
+}
+
+ExportEntry * exportCreate(pid_t masterPid, int nb)
+{
+	char name[MW_EXPORT_NAME_SIZE];
+	exportName(masterPid, name);
+
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	myassert(fd != -1, "création du segment d'export");
+	int ret = ftruncate(fd, nb * sizeof(ExportEntry));
+	myassert(ret == 0, "Erreur");
+	return exportMap(fd, nb);
+}
+
+ExportEntry * exportOpen(pid_t masterPid, int nb)
+{
+	char name[MW_EXPORT_NAME_SIZE];
+	exportName(masterPid, name);
+
+	int fd = shm_open(name, O_RDWR, 0);
+	myassert(fd != -1, "segment d'export introuvable");
+	return exportMap(fd, nb);
+}
+
+void exportClose(ExportEntry *entries, int nb)
+{
+	int ret = munmap(entries, nb * sizeof(ExportEntry));
+	myassert(ret == 0, "Erreur");
+}
+
+void exportDestroy(pid_t masterPid)
+{
+	char name[MW_EXPORT_NAME_SIZE];
+	exportName(masterPid, name);
+	int ret = shm_unlink(name);
+	myassert(ret == 0, "Erreur");
+}
+
+int percentileRank(float p, int nbElements)
+{
+	int k = (int) ceil(p * (double) nbElements / 100.0);
+	if (k < 1)
+		k = 1;
+	if (k > nbElements)
+		k = nbElements;
+	return k;
+}
+
+// un descripteur avec close-on-exec n'est pas hérité par les workers lancés
+// ensuite ; indispensable pour qu'un worker voie la fin (EOF) de ses fils
+void setCloseOnExec(int fd, bool closeOnExec)
+{
+	int ret = fcntl(fd, F_SETFD, closeOnExec ? FD_CLOEXEC : 0);
+	myassert(ret != -1, "Erreur");
+}
+
+
+// à appeler dans le fils après le fork : les paramètres du worker sont
+// passés en chaînes de caractères sur la ligne de commande
+void createWorker(float value, int cardinality, int fdIn, int fdOut, int fdToMaster, bool ring, int fdRing,
+                  int poolOut)
+{
+	char elt[32], card[16], fdI[16], fdO[16], fdToM[16], fdR[16], fdP[16];
+	snprintf(elt, sizeof(elt), "%.9g", value);
+	snprintf(card, sizeof(card), "%d", cardinality);
+	snprintf(fdI, sizeof(fdI), "%d", fdIn);
+	snprintf(fdO, sizeof(fdO), "%d", fdOut);
+	snprintf(fdToM, sizeof(fdToM), "%d", fdToMaster);
+	snprintf(fdR, sizeof(fdR), "%d", fdRing);
+	snprintf(fdP, sizeof(fdP), "%d", poolOut);
+
+	// ces canaux doivent survivre à l'exec
+	setCloseOnExec(fdIn, false);
+	setCloseOnExec(fdOut, false);
+	setCloseOnExec(fdToMaster, false);
+	if (fdRing != -1)
+		setCloseOnExec(fdRing, false);
+	if (poolOut != -1)
+		setCloseOnExec(poolOut, false);
+
+	char *argv[10];
+	argv[0] = "worker";
+	argv[1] = elt;
+	argv[2] = card;
+	argv[3] = fdI;
+	argv[4] = fdO;
+	argv[5] = fdToM;
+	argv[6] = ring ? MW_TRANSPORT_RING : MW_TRANSPORT_SOCKET;
+	argv[7] = fdR;
+	argv[8] = fdP;
+	argv[9] = NULL;
+	execv("./worker", argv);
+}
+
+// idem pour un zygote : worker sans élément ni père
+void createZygote(int poolIn, int poolOut, int fdToMaster, bool ring)
+{
+	char fdPI[16], fdPO[16], fdToM[16];
+	snprintf(fdPI, sizeof(fdPI), "%d", poolIn);
+	snprintf(fdPO, sizeof(fdPO), "%d", poolOut);
+	snprintf(fdToM, sizeof(fdToM), "%d", fdToMaster);
+
+	setCloseOnExec(poolIn, false);
+	setCloseOnExec(poolOut, false);
+	setCloseOnExec(fdToMaster, false);
+
+	char *argv[7];
+	argv[0] = "worker";
+	argv[1] = MW_ZYGOTE;
+	argv[2] = fdPI;
+	argv[3] = fdPO;
+	argv[4] = fdToM;
+	argv[5] = ring ? MW_TRANSPORT_RING : MW_TRANSPORT_SOCKET;
+	argv[6] = NULL;
+	execv("./worker", argv);
+}
+
+// demande à un zygote : un datagramme (l'élément et sa cardinalité, le
+// nombre de descripteurs joints) ; aucun descripteur : arrêt
+typedef struct
+{
+	float elt;
+	int cardinality;
+	int nbFds;
+} WorkerRequest;
+
+static void sendWorkerRequest(const WorkerRequest *request, const int *fds, int poolOut)
+{
+	struct iovec iov;
+	iov.iov_base = (void *) request;
+	iov.iov_len = sizeof(WorkerRequest);
+
+	char control[CMSG_SPACE(2 * sizeof(int))];
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	if (request->nbFds > 0)
+	{
+		msg.msg_control = control;
+		msg.msg_controllen = CMSG_SPACE(request->nbFds * sizeof(int));
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(request->nbFds * sizeof(int));
+		memcpy(CMSG_DATA(cmsg), fds, request->nbFds * sizeof(int));
+	}
+
+	ssize_t ret;
+	do
+		ret = sendmsg(poolOut, &msg, 0);
+	while (ret == -1 && errno == EINTR);
+	myassert(ret == sizeof(WorkerRequest), "demande à un zygote");
+}
+
+void requestWorker(float elt, int cardinality, int fd, int fdRing, int poolOut)
+{
+	int fds[2] = { fd, fdRing };
+	WorkerRequest request = { elt, cardinality, (fdRing == -1) ? 1 : 2 };
+	sendWorkerRequest(&request, fds, poolOut);
+}
+
+void stopZygote(int poolOut)
+{
+	WorkerRequest request = { 0, 0, 0 };
+	sendWorkerRequest(&request, NULL, poolOut);
+}
+
+bool receiveWorkerRequest(int poolIn, float *elt, int *cardinality, int *fd, int *fdRing)
+{
+	WorkerRequest request;
+	struct iovec iov;
+	iov.iov_base = &request;
+	iov.iov_len = sizeof(WorkerRequest);
+
+	char control[CMSG_SPACE(2 * sizeof(int))];
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	ssize_t ret;
+	do
+		ret = recvmsg(poolIn, &msg, 0);
+	while (ret == -1 && errno == EINTR);
+	myassert(ret == sizeof(WorkerRequest), "demande à un zygote");
+	if (request.nbFds == 0)
+		return false;
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	myassert(cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+	         && (msg.msg_flags & MSG_CTRUNC) == 0, "descripteurs perdus");
+	int fds[2];
+	memcpy(fds, CMSG_DATA(cmsg), request.nbFds * sizeof(int));
+
+	*elt = request.elt;
+	*cardinality = request.cardinality;
+	*fd = fds[0];
+	*fdRing = (request.nbFds == 2) ? fds[1] : -1;
+	return true;
+}
@@ -1,6 +1,7 @@
 #ifndef MASTER_WORKER_H
 #define MASTER_WORKER_H
 
+#include <stdbool.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -11,8 +12,20 @@
 #define MW_ORDER_MAXIMUM        30
 #define MW_ORDER_EXIST          40
 #define MW_ORDER_SUM            50
-#define MW_ORDER_INSERT         60
-#define MW_ORDER_PRINT          70
+#define MW_ORDER_INSERT         60      // suivi de l'élément et de sa cardinalité
+#define MW_ORDER_DEPTH          80
+#define MW_ORDER_INSERT_BATCH  110      // suivi du nombre de paires puis des paires, triées
+#define MW_ORDER_RANGE_COUNT   130      // suivi des bornes de l'intervalle [a,b[
+#define MW_ORDER_RANGE_SUM     140      // idem
+#define MW_ORDER_KTH           150      // suivi du rang k dans le sous-arbre
+#define MW_ORDER_RANK          170      // suivi de l'élément x et du nombre d'éléments < x déjà comptés
+#define MW_ORDER_EXPORT        180      // suivi du PID du master, de l'indice du sous-arbre et du nombre total d'entrées
+#define MW_ORDER_SCAN          190      // suivi de l'élément de départ (exclu) et du nombre maximal de paires
+#define MW_ORDER_LOAD          200      // suivi du chemin d'un instantané et de la tranche [lo, hi[ du sous-arbre
+// ordres entre un worker et un de ses fils pour rééquilibrer l'arbre (AVL)
+#define MW_ORDER_ROTATE         90      // le fils fait lui-même une rotation (suivi du sens)
+#define MW_ORDER_HANDOVER      100      // rotation avec le père (suivi du sens) : échange de blocs et de sous-arbres
+#define MW_ORDER_REBALANCE     120      // le fils se rééquilibre entièrement (après un lot)
 
 // réponses possibles d'un worker pour le master, ou d'un worker pour son père
 // pas de MW_ANSWER_STOP : le master attend la fin du premier worker, ou un worker attend la fin de ses fils
@@ -23,8 +36,143 @@
 #define MW_ANSWER_EXIST_YES     41
 #define MW_ANSWER_SUM           50
 #define MW_ANSWER_INSERT        60
-#define MW_ANSWER_PRINT         70
+#define MW_ANSWER_DEPTH         80
+#define MW_ANSWER_ROTATE        90
+#define MW_ANSWER_HANDOVER     100
+#define MW_ANSWER_INSERT_BATCH 110
+#define MW_ANSWER_REBALANCE    120
+#define MW_ANSWER_RANGE_COUNT  130
+#define MW_ANSWER_RANGE_SUM    140
+#define MW_ANSWER_KTH          150
+#define MW_ANSWER_KTH_NONE     151
+#define MW_ANSWER_RANK         170
+#define MW_ANSWER_EXPORT       180
+#define MW_ANSWER_SCAN         190      // suivi du nombre de paires puis des paires
+#define MW_ANSWER_LOAD         200      // suivi de la forme du sous-arbre (comme MW_ANSWER_INSERT)
 
+// numéro de requête des ordres internes (rééquilibrage, fin) : ils ne
+// viennent pas du master et ne lui sont pas rendus
+#define MW_NO_REQUEST            0
+
+// transport entre un worker et ses fils : la socket seule, ou un anneau en
+// mémoire partagée par arête (cf. ring.h) ; le canal avec le master reste
+// un tube
+#define MW_TRANSPORT_SOCKET   "socket"
+#define MW_TRANSPORT_RING     "ring"
+
+// pool de zygotes (master --pool) : des workers lancés d'avance, sans
+// élément, attendent tous sur une même socket (datagrammes) les demandes
+// de fils. Au lieu de fork + exec, un worker envoie l'élément du fils et
+// lui joint la socket de leur arête (et l'anneau, SCM_RIGHTS) ; un zygote
+// fork alors le fils, déjà initialisé, qui démarre sur cette socket. Une
+// demande sans descripteur arrête un zygote. Les fils d'un zygote sont ses
+// processus fils : il les attend avant de se terminer.
+#define MW_ZYGOTE             "zygote"
+
+// sens d'une rotation, ou côté d'un fils
+#define MW_LEFT                  0
+#define MW_RIGHT                 1
+
+// nombre maximal d'éléments distincts d'un worker
+// Un worker garde un bloc trié de paires (élément, cardinalité) : les
+// éléments de son fils gauche sont inférieurs à tout le bloc, ceux de son
+// fils droit supérieurs (arbre AVL de blocs, ou T-tree). Un élément compris
+// entre les extrêmes du bloc y est cherché par dichotomie et ne peut être
+// nulle part ailleurs. Un élément hors du bloc descend vers le fils de son
+// côté ; s'il n'y en a pas, il entre dans le bloc tant qu'il reste de la
+// place, sinon un fils est créé. Un bloc plein qui reçoit un élément
+// intérieur cède un de ses extrêmes (avec sa cardinalité) au fils le moins
+// haut. Il y a ainsi environ MW_BLOCK_SIZE fois moins de workers.
+#define MW_BLOCK_SIZE           64
+
+// L'insertion remonte de fils en père jusqu'au master : chaque worker
+// renvoie MW_ANSWER_INSERT suivi de la hauteur, du déséquilibre et du
+// résumé (cf. Summary) de son sous-arbre, ce qui permet au père de se
+// rééquilibrer et de tenir son propre résumé à jour.
+// Un lot (MW_ORDER_INSERT_BATCH) est trié et sans doublon (les doublons
+// sont regroupés dans les cardinalités) : chaque worker fusionne dans son
+// bloc les paires comprises entre ses extrêmes, le complète avec les
+// paires voisines du côté d'un fils absent ou cède ses extrêmes s'il
+// déborde, puis transmet chaque côté à son fils en un seul message ; un
+// fils créé pour un lot prend la paire médiane de sa partie. Le lot n'est
+// acquitté qu'une fois (MW_ANSWER_INSERT_BATCH, suivi de la même forme que
+// pour MW_ANSWER_INSERT).
+// Une requête sur un intervalle [a,b[ (MW_ORDER_RANGE_*) n'est transmise
+// qu'aux fils dont le sous-arbre chevauche une borne : un sous-arbre
+// entièrement dedans est compté grâce à son résumé, un sous-arbre
+// entièrement dehors est ignoré. Seuls les workers des deux chemins vers
+// a et b sont donc visités. Chaque worker répond à son père.
+// Le k-ième élément (MW_ORDER_KTH) et le rang d'un élément (MW_ORDER_RANK)
+// descendent un seul chemin, guidés par le nombre d'éléments des fils :
+// chaque worker choisit le fils où est la réponse (en corrigeant k, ou le
+// nombre d'éléments déjà comptés) et le dernier répond directement au
+// master, comme pour l'existence. Le master transforme lui-même un
+// percentile en rang (cf. percentileRank) : il connaît le nombre
+// d'éléments de chaque shard.
+// L'export (MW_ORDER_EXPORT) remplit un segment de mémoire partagée créé
+// par le master (cf. exportCreate) avec les paires (élément, cardinalité)
+// triées. Un sous-arbre qui commence à l'indice i y occupe autant d'entrées
+// qu'il a d'éléments distincts : le worker écrit son bloc à partir de
+// l'indice i + (distincts du fils gauche), et ses deux fils remplissent
+// leurs parties en même temps. Chaque worker répond à son père une fois ses fils finis.
+// Le parcours (MW_ORDER_SCAN) renvoie au plus <limit> paires strictement
+// supérieures à <after>, triées : un worker interroge d'abord son fils
+// gauche (s'il a des éléments > after), ajoute son bloc puis complète
+// avec son fils droit. Un fils sans élément > after n'est pas interrogé,
+// et plus rien n'est demandé une fois la page pleine : le coût est la
+// profondeur plus la taille de la page.
+// Au chargement d'un instantané (MW_ORDER_LOAD, cf. snapshot.h), un
+// worker est créé avec l'élément du milieu de sa tranche du fichier : il
+// prend comme bloc les MW_BLOCK_SIZE paires autour de cet élément, crée
+// ses fils avec le milieu de chaque reste de la tranche et leur transmet
+// l'ordre. Les sous-arbres se
+// construisent en parallèle et l'arbre obtenu est équilibré sans rotation.
+// Tout ordre et toute réponse commence par un en-tête (code, numéro de
+// requête) : le master peut ainsi avoir plusieurs requêtes en cours et
+// associer chaque réponse à sa requête quel que soit l'ordre d'arrivée.
+// Un worker ne bloque pas sur ses descendants : il transmet une insertion
+// et traite les ordres suivants ; la réponse du fils est relayée au père
+// quand elle arrive. Les rotations n'ont lieu que lorsqu'aucune insertion
+// n'est en cours dans les sous-arbres concernés.
+// Entre workers le canal est une socket locale (une par fils) pour pouvoir
+// se transmettre les sous-arbres (descripteurs) lors des rotations.
+
+
+// résumé d'un sous-arbre, maintenu par chaque worker à chaque insertion :
+// le premier worker répond ainsi directement à howmany, sum, min et max
+typedef struct
+{
+    int nbElements;             // cardinalités comprises
+    int nbDistinctElements;
+    float sum;
+    float min;                  // non significatifs si nbElements == 0
+    float max;
+} Summary;
+
+// réponse envoyée directement au master (minimum, maximum, existence) sur le
+// tube partagé par tous les workers : c'est une trame courte, écrite en une
+// seule fois (taille < PIPE_BUF) pour ne pas se mélanger avec celle d'un
+// autre worker
+typedef struct
+{
+    int answer;                 // MW_ANSWER_*
+    int reqId;
+    float elt;                  // minimum, maximum ou k-ième élément
+    int cardinality;            // existence, ou rang
+} DirectAnswer;
+
+// paire (élément, cardinalité) : entrée du segment d'export (cf.
+// MW_ORDER_EXPORT), d'une page de parcours (cf. MW_ORDER_SCAN), d'un lot
+// ou du bloc d'un worker (cf. MW_BLOCK_SIZE)
+typedef struct
+{
+    float elt;
+    int cardinality;
+} ExportEntry;
+
+// segment d'export, nommé d'après le PID du master
+#define MW_EXPORT            "masterExport"
+#define MW_EXPORT_NAME_SIZE  64
 
 //TODO
 // Vous pouvez mettre ici des informations/fonctions soit communes au master et au
@@ -35,9 +183,56 @@
 // . lancement d'un worker
 //END TODO
 
-void createWorker(int value, int fdIn, int fdOut, int fdToMaster);
+// worker qui démarre avec l'élément <value> (et sa cardinalité) ;
+// <fdRing> : anneau de l'arête avec le père (-1 si aucun) ; <poolOut> :
+// socket des demandes aux zygotes (-1 : les fils sont lancés par exec)
+void createWorker(float value, int cardinality, int fdIn, int fdOut, int fdToMaster, bool ring, int fdRing,
+                  int poolOut);
+// zygotes (cf. MW_ZYGOTE) : lancement (dans le fils après le fork), demande
+// d'un worker pour <elt> sur la socket <fd> (les descripteurs restent à
+// fermer par l'appelant), arrêt, et attente d'une demande (false : arrêt)
+void createZygote(int poolIn, int poolOut, int fdToMaster, bool ring);
+void requestWorker(float elt, int cardinality, int fd, int fdRing, int poolOut);
+void stopZygote(int poolOut);
+bool receiveWorkerRequest(int poolIn, float *elt, int *cardinality, int *fd, int *fdRing);
 void writeToWorker(int message, int fdWorkerWrite);
 int readWorker(int fdWorkerRead);
+// un message est une trame (cf. frame.h) : writeHeaderToWorker, le contenu,
+// puis endMessageToWorker (ou endEntriesToWorker) ; readHeaderWorker renvoie
+// le code
+void writeHeaderToWorker(int code, int reqId, int fdWorkerWrite);
+void endMessageToWorker(int fdWorkerWrite);
+int readHeaderWorker(int fdWorkerRead, int *reqId);
+void writeDirectAnswerToMaster(const DirectAnswer *answer, int fdToMaster);
+void readDirectAnswer(DirectAnswer *answer, int fdWorkersRead);
+// chaîne de caractères (longueur puis caractères) ; <size> : taille du
+// tableau de réception, '\0' compris
+void writeStringToWorker(const char *s, int fdWorkerWrite);
+void readStringWorker(char *s, int size, int fdWorkerRead);
+// les éléments de l'ensemble circulent sous forme de float
+void writeFloatToWorker(float value, int fdWorkerWrite);
+float readFloatWorker(int fdWorkerRead);
+// paires (élément, cardinalité) : endEntriesToWorker termine le message
+// par un tableau, envoyé sans copie ; writeEntriesToWorker ajoute un petit
+// tableau (un bloc) au message, sans le terminer
+void writeEntriesToWorker(const ExportEntry *entries, int nb, int fdWorkerWrite);
+void endEntriesToWorker(const ExportEntry *entries, int nb, int fdWorkerWrite);
+void readEntriesWorker(ExportEntry *entries, int nb, int fdWorkerRead);
+void writeSummaryToWorker(const Summary *summary, int fdWorkerWrite);
+void readSummaryWorker(Summary *summary, int fdWorkerRead);
+void writeFdToWorker(int fd, int socketWrite);
+int readFdWorker(int socketRead);
+void closeWorker(int fd);
+// segment d'export de <nb> entrées : création et suppression par le
+// master, ouverture par les workers ; exportClose retire la projection
+ExportEntry * exportCreate(pid_t masterPid, int nb);
+ExportEntry * exportOpen(pid_t masterPid, int nb);
+void exportClose(ExportEntry *entries, int nb);
+void exportDestroy(pid_t masterPid);
+// rang (de 1 à nbElements) du percentile <p> (0 à 100) parmi <nbElements>
+// éléments : méthode du rang le plus proche
+int percentileRank(float p, int nbElements);
+void setCloseOnExec(int fd, bool closeOnExec);
 
 
 
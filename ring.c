@@ -0,0 +1,193 @@
+// memfd_create
+#define _GNU_SOURCE
+
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "myassert.h"
+
+#include "ring.h"
+
+// écarte les indices du producteur et du consommateur (lignes de cache)
+#define CACHE_LINE 64
+
+
+/************************************************************************
+ * Structures
+ ************************************************************************/
+// positions croissantes sans fin (modulo 2^32), RG_SIZE est une puissance
+// de 2 : octets en attente = tail - head
+typedef struct
+{
+    unsigned head;                      // écrit par le consommateur seul
+    char pad1[CACHE_LINE - sizeof(unsigned)];
+    unsigned tail;                      // écrit par le producteur seul
+    char pad2[CACHE_LINE - sizeof(unsigned)];
+    char data[RG_SIZE];
+} Queue;
+
+// contenu de la projection partagée
+typedef struct
+{
+    Queue queue[2];                     // queue[s] : écrite par le côté s
+    int sleeping[2];                    // le côté s dort sur sa socket
+} Shared;
+
+// vue d'un processus
+struct Ring
+{
+    Shared *shared;
+    int side;
+    int memfd;
+};
+
+
+/************************************************************************
+ * Création, projection
+ ************************************************************************/
+Ring * rg_map(int memfd, int side)
+{
+    myassert(side == 0 || side == 1, "côté inconnu");
+
+    Ring *ring = malloc(sizeof(Ring));
+    myassert(ring != NULL, "Erreur");
+    ring->shared = mmap(NULL, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    myassert(ring->shared != MAP_FAILED, "projection de l'anneau");
+    ring->side = side;
+    ring->memfd = memfd;
+    return ring;
+}
+
+Ring * rg_create(int *memfd)
+{
+    myassert((RG_SIZE & (RG_SIZE - 1)) == 0, "RG_SIZE doit être une puissance de 2");
+
+    // projection remise à zéro par ftruncate : files vides, personne ne dort
+    *memfd = memfd_create("ring", MFD_CLOEXEC);
+    myassert(*memfd != -1, "memfd_create");
+    int ret = ftruncate(*memfd, sizeof(Shared));
+    myassert(ret == 0, "Erreur");
+
+    return rg_map(*memfd, 0);
+}
+
+void rg_unmap(Ring *ring)
+{
+    int ret = munmap(ring->shared, sizeof(Shared));
+    myassert(ret == 0, "Erreur");
+    ret = close(ring->memfd);
+    myassert(ret == 0, "Erreur");
+    free(ring);
+}
+
+int rg_side(const Ring *ring)
+{
+    return ring->side;
+}
+
+int rg_memfd(const Ring *ring)
+{
+    return ring->memfd;
+}
+
+
+/************************************************************************
+ * Files
+ ************************************************************************/
+// copie circulaire de <size> octets à partir de la position <pos>
+static void copyIn(Queue *queue, unsigned pos, const char *data, int size)
+{
+    unsigned offset = pos & (RG_SIZE - 1);
+    int first = (size < (int) (RG_SIZE - offset)) ? size : (int) (RG_SIZE - offset);
+    memcpy(queue->data + offset, data, first);
+    memcpy(queue->data, data + first, size - first);
+}
+
+static void copyOut(const Queue *queue, unsigned pos, char *data, int size)
+{
+    unsigned offset = pos & (RG_SIZE - 1);
+    int first = (size < (int) (RG_SIZE - offset)) ? size : (int) (RG_SIZE - offset);
+    memcpy(data, queue->data + offset, first);
+    memcpy(data + first, queue->data, size - first);
+}
+
+int rg_write(Ring *ring, const void *data, int size)
+{
+    Queue *queue = &(ring->shared->queue[ring->side]);
+    unsigned tail = queue->tail;
+    unsigned head = __atomic_load_n(&(queue->head), __ATOMIC_ACQUIRE);
+
+    int room = RG_SIZE - (tail - head);
+    int nb = (size < room) ? size : room;
+    if (nb == 0)
+        return 0;
+
+    copyIn(queue, tail, data, nb);
+    // publication (ordre total avec l'annonce de sommeil, cf. rg_sleep)
+    __atomic_store_n(&(queue->tail), tail + nb, __ATOMIC_SEQ_CST);
+    return nb;
+}
+
+int rg_read(Ring *ring, void *data, int size)
+{
+    Queue *queue = &(ring->shared->queue[1 - ring->side]);
+    unsigned head = queue->head;
+    unsigned tail = __atomic_load_n(&(queue->tail), __ATOMIC_ACQUIRE);
+
+    int used = tail - head;
+    int nb = (size < used) ? size : used;
+    if (nb == 0)
+        return 0;
+
+    copyOut(queue, head, data, nb);
+    __atomic_store_n(&(queue->head), head + nb, __ATOMIC_SEQ_CST);
+    return nb;
+}
+
+bool rg_canRead(const Ring *ring)
+{
+    const Queue *queue = &(ring->shared->queue[1 - ring->side]);
+    return __atomic_load_n(&(queue->tail), __ATOMIC_SEQ_CST) != queue->head;
+}
+
+bool rg_canWrite(const Ring *ring)
+{
+    const Queue *queue = &(ring->shared->queue[ring->side]);
+    return queue->tail - __atomic_load_n(&(queue->head), __ATOMIC_SEQ_CST) < RG_SIZE;
+}
+
+
+/************************************************************************
+ * Sommeil et réveil
+ *
+ * Le dormeur annonce son sommeil puis revérifie les files ; celui qui
+ * publie (ou libère de la place) publie puis regarde l'annonce. Les deux
+ * accès sont séquentiellement cohérents : l'un des deux voit forcément
+ * l'autre, aucun réveil n'est perdu.
+ ************************************************************************/
+void rg_sleep(Ring *ring)
+{
+    __atomic_store_n(&(ring->shared->sleeping[ring->side]), 1, __ATOMIC_SEQ_CST);
+}
+
+void rg_wake(Ring *ring)
+{
+    __atomic_store_n(&(ring->shared->sleeping[ring->side]), 0, __ATOMIC_SEQ_CST);
+}
+
+bool rg_wakeNeeded(Ring *ring)
+{
+    int *sleeping = &(ring->shared->sleeping[1 - ring->side]);
+    if (__atomic_load_n(sleeping, __ATOMIC_SEQ_CST) == 0)
+        return false;
+    return __atomic_exchange_n(sleeping, 0, __ATOMIC_SEQ_CST) == 1;
+}
@@ -0,0 +1,50 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdbool.h>
+
+/************************************************************************
+ * Anneaux en mémoire partagée entre deux processus (une arête de l'arbre)
+ *
+ * Une arête est une projection partagée (memfd) qui contient deux files
+ * à un producteur et un consommateur : la file <s> est écrite par le côté
+ * <s> et lue par l'autre. Les données ne passent plus par le noyau.
+ * Un côté qui n'a plus rien à faire l'annonce (rg_sleep) puis dort sur
+ * la socket de l'arête ; l'autre côté le réveille par un octet
+ * ("sonnette") lorsque rg_wakeNeeded le demande.
+ * Utilisé par frame.h (cf. fr_ringCreate) : les ordres et réponses ne
+ * voient pas la différence.
+ ************************************************************************/
+
+// capacité de chaque file (octets)
+#define RG_SIZE (128 * 1024)
+
+typedef struct Ring Ring;
+
+// création d'une arête, vue du côté 0 ; <memfd> est à transmettre à
+// l'autre côté (rg_map avec le côté 1)
+Ring * rg_create(int *memfd);
+// projection d'une arête existante ; la ring garde <memfd>
+Ring * rg_map(int memfd, int side);
+// fin de la projection (et fermeture du memfd)
+void rg_unmap(Ring *ring);
+
+int rg_side(const Ring *ring);
+int rg_memfd(const Ring *ring);
+
+// copie d'au plus <size> octets ; renvoient le nombre d'octets copiés
+// (0 si la file sortante est pleine, ou la file entrante vide)
+int rg_write(Ring *ring, const void *data, int size);
+int rg_read(Ring *ring, void *data, int size);
+
+bool rg_canRead(const Ring *ring);
+bool rg_canWrite(const Ring *ring);
+
+// annonce que ce côté va dormir (sur sa socket) ; rg_wake l'annule
+void rg_sleep(Ring *ring);
+void rg_wake(Ring *ring);
+// après rg_write ou rg_read : l'autre côté dormait-il ? (il faut alors le
+// réveiller, l'annonce est consommée)
+bool rg_wakeNeeded(Ring *ring);
+
+#endif
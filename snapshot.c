@@ -0,0 +1,104 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// fstat, mmap
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "myassert.h"
+
+#include "snapshot.h"
+
+
+/************************************************************************
+ * Ecriture
+ ************************************************************************/
+static bool writeAll(int fd, const void *buf, long size)
+{
+    const char *p = buf;
+    while (size > 0)
+    {
+        ssize_t ret = write(fd, p, size);
+        if (ret <= 0)
+            return false;
+        p += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+bool sn_write(const char *path, const ExportEntry *entries, int nb)
+{
+    SnapshotHeader header = { SN_MAGIC, SN_VERSION, nb, 0 };
+    for (int i = 0; i < nb; i++)
+        header.nbElements += entries[i].cardinality;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        return false;
+
+    bool ok = writeAll(fd, &header, sizeof(SnapshotHeader))
+              && writeAll(fd, entries, (long) nb * sizeof(ExportEntry));
+    int ret = close(fd);
+    return ok && ret == 0;
+}
+
+
+/************************************************************************
+ * Projection
+ ************************************************************************/
+static long fileSize(int nbEntries)
+{
+    return sizeof(SnapshotHeader) + (long) nbEntries * sizeof(ExportEntry);
+}
+
+const SnapshotHeader * sn_map(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+    int ret = fstat(fd, &st);
+    myassert(ret == 0, "Erreur");
+
+    const SnapshotHeader *snapshot = NULL;
+    if (st.st_size >= (off_t) sizeof(SnapshotHeader))
+    {
+        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        myassert(p != MAP_FAILED, "projection de l'instantané");
+        snapshot = p;
+
+        // en-tête et taille cohérents, sinon le fichier est refusé
+        if (snapshot->magic != SN_MAGIC || snapshot->version != SN_VERSION
+            || snapshot->nbEntries < 0 || fileSize(snapshot->nbEntries) != st.st_size)
+        {
+            ret = munmap(p, st.st_size);
+            myassert(ret == 0, "Erreur");
+            snapshot = NULL;
+        }
+    }
+
+    ret = close(fd);
+    myassert(ret == 0, "Erreur");
+    return snapshot;
+}
+
+const ExportEntry * sn_entries(const SnapshotHeader *snapshot)
+{
+    return (const ExportEntry *) (snapshot + 1);
+}
+
+void sn_unmap(const SnapshotHeader *snapshot)
+{
+    int ret = munmap((void *) snapshot, fileSize(snapshot->nbEntries));
+    myassert(ret == 0, "Erreur");
+}
@@ -0,0 +1,40 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+
+#include "master_worker.h"
+
+/************************************************************************
+ * Instantané binaire de l'ensemble (ordre snapshot, master --load)
+ *
+ * Un en-tête de taille fixe suivi des paires (élément, cardinalité)
+ * triées, au format ExportEntry (cf. master_worker.h) : le fichier se
+ * projette tel quel en mémoire, sans décodage. Le numéro de version
+ * change avec le format ; un fichier d'une autre version est refusé.
+ ************************************************************************/
+
+#define SN_MAGIC        0x50414e53      // "SNAP" en petit-boutiste
+#define SN_VERSION      1
+// taille maximale d'un chemin transmis dans un ordre
+#define SN_PATH_SIZE    4096
+
+typedef struct
+{
+    int magic;                  // SN_MAGIC
+    int version;                // SN_VERSION
+    int nbEntries;              // nombre d'éléments distincts
+    int nbElements;             // nombre d'éléments (cardinalités comprises)
+} SnapshotHeader;
+
+// écriture de <nb> paires triées dans <path> ; false en cas d'échec
+// (fichier impossible à créer ou à écrire)
+bool sn_write(const char *path, const ExportEntry *entries, int nb);
+
+// projection en lecture seule de <path> ; NULL si le fichier n'existe pas
+// ou n'est pas un instantané valide
+const SnapshotHeader * sn_map(const char *path);
+const ExportEntry * sn_entries(const SnapshotHeader *snapshot);
+void sn_unmap(const SnapshotHeader *snapshot);
+
+#endif
@@ -0,0 +1,85 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "myassert.h"
+
+#include "stats.h"
+
+
+/************************************************************************
+ * Seaux
+ ************************************************************************/
+// us dans [2^(e-1), 2^e[ (frexp) : sous-seau selon la position dans
+// l'octave
+static int bucketOf(double us)
+{
+    if (us < 1)
+        return 0;
+    int e;
+    double m = frexp(us, &e);       // us = m * 2^e, m dans [0.5, 1[
+    int sub = (int) ((2 * m - 1) * ST_SUB_BUCKETS);
+    int idx = 1 + (e - 1) * ST_SUB_BUCKETS + sub;
+    return (idx < ST_NB_BUCKETS) ? idx : ST_NB_BUCKETS - 1;
+}
+
+static double bucketUpper(int idx)
+{
+    if (idx == 0)
+        return 1;
+    int e = (idx - 1) / ST_SUB_BUCKETS;
+    int sub = (idx - 1) % ST_SUB_BUCKETS;
+    return ldexp(1.0 + (sub + 1.0) / ST_SUB_BUCKETS, e);
+}
+
+
+/************************************************************************
+ * Histogramme
+ ************************************************************************/
+void st_init(StHistogram *h)
+{
+    memset(h, 0, sizeof(StHistogram));
+}
+
+void st_record(StHistogram *h, double seconds)
+{
+    double us = (seconds > 0) ? seconds * 1e6 : 0;
+    h->buckets[bucketOf(us)]++;
+    h->count++;
+    h->totalUs += us;
+    if (us > h->maxUs)
+        h->maxUs = us;
+}
+
+double st_percentile(const StHistogram *h, double q)
+{
+    myassert(q >= 0 && q <= 1, "percentile hors de [0,1]");
+    if (h->count == 0)
+        return 0;
+
+    // rang le plus proche : au moins un élément
+    long rank = (long) ceil(q * h->count);
+    if (rank < 1)
+        rank = 1;
+    long seen = 0;
+    for (int i = 0; i < ST_NB_BUCKETS; i++)
+    {
+        seen += h->buckets[i];
+        if (seen >= rank)
+        {
+            double upper = bucketUpper(i);
+            return (upper < h->maxUs) ? upper : h->maxUs;
+        }
+    }
+    return h->maxUs;
+}
+
+double st_mean(const StHistogram *h)
+{
+    return (h->count > 0) ? h->totalUs / h->count : 0;
+}
@@ -0,0 +1,53 @@
+#ifndef STATS_H
+#define STATS_H
+
+/************************************************************************
+ * Histogrammes de latence (ordre stats)
+ *
+ * Seaux logarithmiques : le seau 0 compte les durées de moins d'une
+ * microseconde, puis chaque puissance de deux [2^e, 2^(e+1)[ µs est
+ * découpée en ST_SUB_BUCKETS seaux égaux (erreur relative d'au plus
+ * 1/ST_SUB_BUCKETS sur un percentile), jusqu'à 2^32 µs ; le dernier seau
+ * reçoit tout ce qui dépasse. Enregistrer une durée est un calcul
+ * d'indice, sans allocation.
+ *
+ * Les structures passent telles quelles du master au client (même
+ * compilation), comme les paires ExportEntry.
+ ************************************************************************/
+
+#define ST_SUB_BUCKETS  4
+#define ST_NB_BUCKETS   (1 + 32 * ST_SUB_BUCKETS)
+
+typedef struct
+{
+    int count;
+    float maxUs;                    // plus longue durée, en µs
+    double totalUs;                 // somme des durées, en µs
+    int buckets[ST_NB_BUCKETS];
+} StHistogram;
+
+// étapes d'un ordre dans le master
+typedef enum
+{
+    ST_QUEUE,                       // attente : ordre lisible -> début du traitement
+    ST_TREE,                        // traitement (arbre de workers ou arène) -> réponse prête
+    ST_WRITE,                       // réponse prête -> écrite dans le tube du client
+    ST_NB_PHASES
+} StPhase;
+
+typedef struct
+{
+    int order;                      // CM_ORDER_*
+    StHistogram phases[ST_NB_PHASES];
+} StOrderStats;
+
+void st_init(StHistogram *h);
+// ajout d'une durée (en secondes, comme ut_now)
+void st_record(StHistogram *h, double seconds);
+// percentile <q> (dans [0,1]) en µs : borne supérieure de son seau, sans
+// dépasser le maximum ; 0 si l'histogramme est vide
+double st_percentile(const StHistogram *h, double q);
+// moyenne en µs
+double st_mean(const StHistogram *h);
+
+#endif
@@ -4,6 +4,33 @@ nb=10
 min=95
 max=105    # non inclus
 
+# entier de 4 octets (petit-boutiste), au format de printf
+intBytes()
+{
+    printf '\\x%02x' $(($1 & 255)) $(($1 >> 8 & 255)) $(($1 >> 16 & 255)) $(($1 >> 24 & 255))
+}
+
+# client minimal : ouvre une session (cf. client_master.h), envoie les
+# octets <$1> (format de printf) et affiche le code de la réponse ; sert à
+# envoyer ce que ./client refuse d'envoyer
+rawOrder()
+{
+    (
+        pid=$BASHPID
+        m2c=tubeMasterToClient.$pid
+        c2m=tubeClientToMaster.$pid
+        mkfifo $m2c $c2m
+        exec 3<>$m2c
+        printf "$(intBytes $pid)" > tubeRegistration
+        head -c 12 <&3 > /dev/null
+        exec 4>$c2m
+        rm -f $m2c $c2m
+        printf "$1" >&4
+        answer=$(timeout 1 head -c 12 <&3 | od -An -tu4 -N4 | tr -d ' ')
+        echo "réponse : ${answer:-aucune}"
+    )
+}
+
 echo '== insertion des '$nb' valeur(s), interval ['$min','$max'['
 ./client insertmany $nb $min $max
 ./client insert 100
@@ -21,6 +48,10 @@ echo
 
 echo "== affichage"
 ./client print
+echo "== export"
+./client export
+echo "== parcours"
+./client scan 97 3
 echo "== cardinalité"
 ./client howmany
 echo "== min et mas"
@@ -28,6 +59,31 @@ echo "== min et mas"
 ./client max
 echo "== somme"
 ./client sum
+echo "== intervalle [97,101["
+./client range 97 101
+echo "== statistiques d'ordre"
+./client kth 5
+./client rank 100
+./client percentile 50
+./client percentile 90
+echo "== profondeur"
+./client depth
+echo "== latences"
+./client stats
+echo "== en-têtes invalides : la session est fermée, le master continue"
+rawOrder "$(intBytes 10)$(intBytes -1)$(intBytes 0)"
+rawOrder "$(intBytes 70)$(intBytes 2147483647)$(intBytes 0)"
+echo "== tableaux incohérents : refusés (71), le master continue"
+rawOrder "$(intBytes 70)$(intBytes 4)$(intBytes 0)$(intBytes -5)"
+rawOrder "$(intBytes 70)$(intBytes 8)$(intBytes 0)$(intBytes 3)$(intBytes 0)"
+rawOrder "$(intBytes 71)$(intBytes 0)$(intBytes 0)"
+echo "== pages de parcours invalides : refusées (161)"
+rawOrder "$(intBytes 160)$(intBytes 8)$(intBytes 0)$(intBytes 0)$(intBytes 0)"
+rawOrder "$(intBytes 160)$(intBytes 8)$(intBytes 0)$(intBytes 0)$(intBytes 2147483647)"
+echo "== chemins d'instantané invalides : refusés (171)"
+rawOrder "$(intBytes 170)$(intBytes 4)$(intBytes 0)$(intBytes -1)"
+rawOrder "$(intBytes 170)$(intBytes 4)$(intBytes 0)$(intBytes 5000)"
+./client howmany
 echo "== stop"
 ./client stop
 echo
@@ -39,3 +95,6 @@ loc_min=0
 loc_max=10 # non inclus
 echo '== calcul multi-thread (nbThreads='$loc_nbThreads', elt='$loc_elt', nb='$loc_nb', intervalle=['$loc_min','$loc_max'[)'
 ./client local $loc_nbThreads $loc_elt $loc_nb $loc_min $loc_max
+loc_seed=42
+echo '== calcul multi-thread sans tableau (graine='$loc_seed')'
+./client localstream $loc_nbThreads $loc_elt $loc_nb $loc_min $loc_max $loc_seed
@@ -0,0 +1,458 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "myassert.h"
+
+#include "tree.h"
+
+// indice signifiant "pas de noeud"
+#define NIL            -1
+// taille initiale de l'arène (en nombre de noeuds)
+#define INIT_CAPACITY  1024
+
+
+/************************************************************************
+ * Structures
+ ************************************************************************/
+typedef struct
+{
+    float elt;
+    int cardinality;
+    int left;       // indice du fils gauche dans l'arène (NIL si absent)
+    int right;      // indice du fils droit dans l'arène (NIL si absent)
+    int height;     // hauteur du sous-arbre (1 pour une feuille)
+    // cumuls du sous-arbre (cardinalités comprises), pour les intervalles
+    int nbElements;
+    float sum;
+} Node;
+
+struct Tree
+{
+    // arène : les noeuds ne sont jamais libérés individuellement
+    Node *nodes;
+    int size;
+    int capacity;
+
+    int root;
+
+    // cumuls globaux, maintenus à chaque insertion
+    int nbElements;
+    float sum;
+};
+
+
+/************************************************************************
+ * Arène
+ ************************************************************************/
+static int newNode(Tree *tree, float elt)
+{
+    if (tree->size == tree->capacity)
+    {
+        tree->capacity *= 2;
+        tree->nodes = realloc(tree->nodes, tree->capacity * sizeof(Node));
+        myassert(tree->nodes != NULL, "agrandissement de l'arène");
+    }
+
+    int idx = tree->size;
+    tree->size++;
+
+    Node *node = &(tree->nodes[idx]);
+    node->elt = elt;
+    node->cardinality = 1;
+    node->left = NIL;
+    node->right = NIL;
+    node->height = 1;
+    node->nbElements = 1;
+    node->sum = elt;
+
+    return idx;
+}
+
+Tree * tr_create()
+{
+    Tree *tree = malloc(sizeof(Tree));
+    myassert(tree != NULL, "allocation de l'arbre");
+
+    tree->nodes = malloc(INIT_CAPACITY * sizeof(Node));
+    myassert(tree->nodes != NULL, "allocation de l'arène");
+    tree->size = 0;
+    tree->capacity = INIT_CAPACITY;
+    tree->root = NIL;
+    tree->nbElements = 0;
+    tree->sum = 0;
+
+    return tree;
+}
+
+void tr_destroy(Tree *tree)
+{
+    myassert(tree != NULL, "il faut un arbre");
+    free(tree->nodes);
+    free(tree);
+}
+
+
+/************************************************************************
+ * Equilibrage (AVL)
+ ************************************************************************/
+static int height(const Tree *tree, int idx)
+{
+    return (idx == NIL) ? 0 : tree->nodes[idx].height;
+}
+
+// hauteur et cumuls, à partir de ceux des fils
+static void updateNode(Tree *tree, int idx)
+{
+    Node *node = &(tree->nodes[idx]);
+    int hl = height(tree, node->left);
+    int hr = height(tree, node->right);
+    node->height = 1 + (hl > hr ? hl : hr);
+
+    node->nbElements = node->cardinality;
+    node->sum = node->elt * node->cardinality;
+    if (node->left != NIL)
+    {
+        node->nbElements += tree->nodes[node->left].nbElements;
+        node->sum += tree->nodes[node->left].sum;
+    }
+    if (node->right != NIL)
+    {
+        node->nbElements += tree->nodes[node->right].nbElements;
+        node->sum += tree->nodes[node->right].sum;
+    }
+}
+
+static int balanceFactor(const Tree *tree, int idx)
+{
+    return height(tree, tree->nodes[idx].left) - height(tree, tree->nodes[idx].right);
+}
+
+// renvoie la nouvelle racine du sous-arbre
+static int rotateRight(Tree *tree, int idx)
+{
+    int newRoot = tree->nodes[idx].left;
+    tree->nodes[idx].left = tree->nodes[newRoot].right;
+    tree->nodes[newRoot].right = idx;
+    updateNode(tree, idx);
+    updateNode(tree, newRoot);
+    return newRoot;
+}
+
+static int rotateLeft(Tree *tree, int idx)
+{
+    int newRoot = tree->nodes[idx].right;
+    tree->nodes[idx].right = tree->nodes[newRoot].left;
+    tree->nodes[newRoot].left = idx;
+    updateNode(tree, idx);
+    updateNode(tree, newRoot);
+    return newRoot;
+}
+
+static int rebalance(Tree *tree, int idx)
+{
+    updateNode(tree, idx);
+    int bf = balanceFactor(tree, idx);
+
+    if (bf > 1)
+    {
+        if (balanceFactor(tree, tree->nodes[idx].left) < 0)
+            tree->nodes[idx].left = rotateLeft(tree, tree->nodes[idx].left);
+        return rotateRight(tree, idx);
+    }
+    if (bf < -1)
+    {
+        if (balanceFactor(tree, tree->nodes[idx].right) > 0)
+            tree->nodes[idx].right = rotateRight(tree, tree->nodes[idx].right);
+        return rotateLeft(tree, idx);
+    }
+    return idx;
+}
+
+
+/************************************************************************
+ * Insertion
+ ************************************************************************/
+// attention : newNode peut déplacer l'arène, on ne garde donc aucun
+// pointeur sur un noeud à travers l'appel récursif
+static int insertRec(Tree *tree, int idx, float elt)
+{
+    if (idx == NIL)
+        return newNode(tree, elt);
+
+    if (elt == tree->nodes[idx].elt)
+    {
+        tree->nodes[idx].cardinality++;
+        updateNode(tree, idx);
+        return idx;
+    }
+
+    if (elt < tree->nodes[idx].elt)
+    {
+        int child = insertRec(tree, tree->nodes[idx].left, elt);
+        tree->nodes[idx].left = child;
+    }
+    else
+    {
+        int child = insertRec(tree, tree->nodes[idx].right, elt);
+        tree->nodes[idx].right = child;
+    }
+
+    return rebalance(tree, idx);
+}
+
+void tr_insert(Tree *tree, float elt)
+{
+    myassert(tree != NULL, "il faut un arbre");
+
+    tree->root = insertRec(tree, tree->root, elt);
+    tree->nbElements++;
+    tree->sum += elt;
+}
+
+
+/************************************************************************
+ * Construction à partir d'éléments triés
+ ************************************************************************/
+// chaque sous-arbre est enraciné sur l'élément du milieu de sa tranche
+// [lo, hi[ : les hauteurs des deux fils diffèrent d'au plus 1
+static int buildRec(Tree *tree, const float *elts, const int *cardinalities, int lo, int hi)
+{
+    if (lo >= hi)
+        return NIL;
+
+    int mid = lo + (hi - lo) / 2;
+    int idx = newNode(tree, elts[mid]);
+    tree->nodes[idx].cardinality = cardinalities[mid];
+    int left = buildRec(tree, elts, cardinalities, lo, mid);
+    int right = buildRec(tree, elts, cardinalities, mid + 1, hi);
+    tree->nodes[idx].left = left;
+    tree->nodes[idx].right = right;
+    updateNode(tree, idx);
+    return idx;
+}
+
+void tr_build(Tree *tree, const float *elts, const int *cardinalities, int nb)
+{
+    myassert(tr_isEmpty(tree), "l'arbre doit être vide");
+
+    tree->root = buildRec(tree, elts, cardinalities, 0, nb);
+    for (int i = 0; i < nb; i++)
+    {
+        tree->nbElements += cardinalities[i];
+        tree->sum += elts[i] * cardinalities[i];
+    }
+}
+
+
+/************************************************************************
+ * Requêtes
+ ************************************************************************/
+bool tr_isEmpty(const Tree *tree)
+{
+    myassert(tree != NULL, "il faut un arbre");
+    return tree->root == NIL;
+}
+
+void tr_howMany(const Tree *tree, int *nbElements, int *nbDistinctElements)
+{
+    myassert(tree != NULL, "il faut un arbre");
+    *nbElements = tree->nbElements;
+    // pas de suppression : chaque noeud alloué est un élément distinct
+    *nbDistinctElements = tree->size;
+}
+
+float tr_minimum(const Tree *tree)
+{
+    myassert(! tr_isEmpty(tree), "ensemble vide");
+
+    int idx = tree->root;
+    while (tree->nodes[idx].left != NIL)
+        idx = tree->nodes[idx].left;
+    return tree->nodes[idx].elt;
+}
+
+float tr_maximum(const Tree *tree)
+{
+    myassert(! tr_isEmpty(tree), "ensemble vide");
+
+    int idx = tree->root;
+    while (tree->nodes[idx].right != NIL)
+        idx = tree->nodes[idx].right;
+    return tree->nodes[idx].elt;
+}
+
+int tr_exist(const Tree *tree, float elt)
+{
+    myassert(tree != NULL, "il faut un arbre");
+
+    int idx = tree->root;
+    while (idx != NIL)
+    {
+        const Node *node = &(tree->nodes[idx]);
+        if (elt == node->elt)
+            return node->cardinality;
+        idx = (elt < node->elt) ? node->left : node->right;
+    }
+    return 0;
+}
+
+float tr_sum(const Tree *tree)
+{
+    myassert(tree != NULL, "il faut un arbre");
+    return tree->sum;
+}
+
+// loIn (hiIn) : tous les éléments du sous-arbre <idx> sont >= a (< b) ;
+// un sous-arbre entièrement dans [a,b[ est compté par ses cumuls, on ne
+// descend donc que le long des chemins vers a et b
+static void rangeRec(const Tree *tree, int idx, float a, float b, bool loIn, bool hiIn,
+                     int *nbElements, float *sum)
+{
+    if (idx == NIL)
+        return;
+    const Node *node = &(tree->nodes[idx]);
+    if (loIn && hiIn)
+    {
+        *nbElements += node->nbElements;
+        *sum += node->sum;
+        return;
+    }
+
+    if (node->elt < a)
+    {
+        rangeRec(tree, node->right, a, b, loIn, hiIn, nbElements, sum);
+    }
+    else if (node->elt >= b)
+    {
+        rangeRec(tree, node->left, a, b, loIn, hiIn, nbElements, sum);
+    }
+    else
+    {
+        *nbElements += node->cardinality;
+        *sum += node->elt * node->cardinality;
+        rangeRec(tree, node->left, a, b, loIn, true, nbElements, sum);
+        rangeRec(tree, node->right, a, b, true, hiIn, nbElements, sum);
+    }
+}
+
+void tr_range(const Tree *tree, float a, float b, int *nbElements, float *sum)
+{
+    myassert(tree != NULL, "il faut un arbre");
+    *nbElements = 0;
+    *sum = 0;
+    if (a < b)
+        rangeRec(tree, tree->root, a, b, false, false, nbElements, sum);
+}
+
+// descente guidée par le nombre d'éléments des sous-arbres gauches
+float tr_kth(const Tree *tree, int k)
+{
+    myassert(tree != NULL, "il faut un arbre");
+    myassert(k >= 1 && k <= tree->nbElements, "rang hors de l'ensemble");
+
+    int idx = tree->root;
+    while (true)
+    {
+        const Node *node = &(tree->nodes[idx]);
+        int nbLeft = (node->left == NIL) ? 0 : tree->nodes[node->left].nbElements;
+        if (k <= nbLeft)
+            idx = node->left;
+        else if (k <= nbLeft + node->cardinality)
+            return node->elt;
+        else
+        {
+            k -= nbLeft + node->cardinality;
+            idx = node->right;
+        }
+    }
+}
+
+int tr_rank(const Tree *tree, float x)
+{
+    myassert(tree != NULL, "il faut un arbre");
+
+    int rank = 0;
+    int idx = tree->root;
+    while (idx != NIL)
+    {
+        const Node *node = &(tree->nodes[idx]);
+        if (x <= node->elt)
+            idx = node->left;
+        else
+        {
+            rank += node->cardinality;
+            if (node->left != NIL)
+                rank += tree->nodes[node->left].nbElements;
+            idx = node->right;
+        }
+    }
+    return rank;
+}
+
+int tr_depth(const Tree *tree)
+{
+    myassert(tree != NULL, "il faut un arbre");
+    return height(tree, tree->root);
+}
+
+// renvoie l'indice suivant le bloc du sous-arbre <idx>
+static int exportRec(const Tree *tree, int idx, float *elts, int *cardinalities, int pos)
+{
+    if (idx == NIL)
+        return pos;
+    pos = exportRec(tree, tree->nodes[idx].left, elts, cardinalities, pos);
+    elts[pos] = tree->nodes[idx].elt;
+    cardinalities[pos] = tree->nodes[idx].cardinality;
+    return exportRec(tree, tree->nodes[idx].right, elts, cardinalities, pos + 1);
+}
+
+void tr_export(const Tree *tree, float *elts, int *cardinalities)
+{
+    myassert(tree != NULL, "il faut un arbre");
+    exportRec(tree, tree->root, elts, cardinalities, 0);
+}
+
+// renvoie le nombre d'éléments rangés à partir de <pos>
+static int scanRec(const Tree *tree, int idx, float after, int limit, float *elts, int *cardinalities, int pos)
+{
+    if (idx == NIL || pos == limit)
+        return pos;
+    const Node *node = &(tree->nodes[idx]);
+    if (node->elt > after)
+    {
+        pos = scanRec(tree, node->left, after, limit, elts, cardinalities, pos);
+        if (pos == limit)
+            return pos;
+        elts[pos] = node->elt;
+        cardinalities[pos] = node->cardinality;
+        pos++;
+    }
+    return scanRec(tree, node->right, after, limit, elts, cardinalities, pos);
+}
+
+int tr_scan(const Tree *tree, float after, int limit, float *elts, int *cardinalities)
+{
+    myassert(tree != NULL, "il faut un arbre");
+    return scanRec(tree, tree->root, after, limit, elts, cardinalities, 0);
+}
+
+static void printRec(const Tree *tree, int idx)
+{
+    if (idx == NIL)
+        return;
+    printRec(tree, tree->nodes[idx].left);
+    printf("Element: %g, Cardinality: %d\n", tree->nodes[idx].elt, tree->nodes[idx].cardinality);
+    printRec(tree, tree->nodes[idx].right);
+}
+
+void tr_print(const Tree *tree)
+{
+    myassert(tree != NULL, "il faut un arbre");
+    printRec(tree, tree->root);
+    fflush(stdout);
+}
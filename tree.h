@@ -0,0 +1,69 @@
+#ifndef TREE_H
+#define TREE_H
+
+#include <stdbool.h>
+
+/************************************************************************
+ * Ensemble ordonné (multi-ensemble) géré directement par le master
+ *
+ * C'est une alternative à l'arbre de workers : au lieu d'un processus
+ * par bloc d'éléments distincts, les noeuds sont rangés dans une arène (un seul
+ * tableau qui grossit par doublement) et chaînés par indices.
+ * L'arbre est un AVL : sa profondeur reste logarithmique même si les
+ * éléments sont insérés dans l'ordre.
+ ************************************************************************/
+
+typedef struct Tree Tree;
+
+// création et libération (l'arène entière est libérée d'un coup)
+Tree * tr_create();
+void tr_destroy(Tree *tree);
+
+// ajout d'un exemplaire de <elt>
+void tr_insert(Tree *tree, float elt);
+
+// construction directe d'un arbre équilibré à partir de <nb> éléments
+// distincts triés et de leurs cardinalités (pré-condition : arbre vide)
+void tr_build(Tree *tree, const float *elts, const int *cardinalities, int nb);
+
+bool tr_isEmpty(const Tree *tree);
+
+// nombre d'éléments (avec et sans les doublons)
+void tr_howMany(const Tree *tree, int *nbElements, int *nbDistinctElements);
+
+// pré-condition : ensemble non vide
+float tr_minimum(const Tree *tree);
+float tr_maximum(const Tree *tree);
+
+// cardinalité de <elt> (0 s'il est absent)
+int tr_exist(const Tree *tree, float elt);
+
+float tr_sum(const Tree *tree);
+
+// nombre (cardinalités comprises) et somme des éléments de [a,b[ ; ne
+// parcourt que O(profondeur) noeuds
+void tr_range(const Tree *tree, float a, float b, int *nbElements, float *sum);
+
+// <k>-ième plus petit élément, cardinalités comprises (1 : le minimum)
+// pré-condition : 1 <= k <= nombre d'éléments
+float tr_kth(const Tree *tree, int k);
+
+// nombre d'éléments strictement inférieurs à <x>
+int tr_rank(const Tree *tree, float x);
+
+// profondeur de l'arbre (0 si vide)
+int tr_depth(const Tree *tree);
+
+// éléments distincts triés et leurs cardinalités (tableaux de la taille
+// du nombre d'éléments distincts, cf. tr_howMany)
+void tr_export(const Tree *tree, float *elts, int *cardinalities);
+
+// au plus <limit> éléments distincts strictement supérieurs à <after>,
+// triés, et leurs cardinalités ; renvoie leur nombre (parcours infixe qui
+// part du successeur de <after> et s'arrête une fois la page pleine)
+int tr_scan(const Tree *tree, float after, int limit, float *elts, int *cardinalities);
+
+// affichage trié sur la sortie standard
+void tr_print(const Tree *tree);
+
+#endif
@@ -2,11 +2,17 @@
 #include "config.h"
 #endif
 
+// clock_gettime, posix_memalign
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <time.h>
+#include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <pthread.h>
 //TODO d'autres include éventuellement
 
 #include "utils.h"
@@ -51,6 +57,12 @@ float * ut_generateTab(int size, float min, float max, int precision)
 {
     float *t = malloc(size * sizeof(float));
     myassert(t != NULL, "allocation mémoire génération tableau float");
+    ut_fillTab(t, size, min, max, precision);
+    return t;
+}
+
+void ut_fillTab(float *t, int size, float min, float max, int precision)
+{
     for (int i = 0; i < size; i++)
         t[i] = ut_getAleaFloat(min, max, precision);
 
@@ -67,8 +79,321 @@ float * ut_generateTab(int size, float min, float max, int precision)
         }
         printf("]\n");
     }
+}
+
+// PCG32 (XSH RR) : congruence linéaire 64 bits, sortie permutée sur 32 bits
+uint32_t ut_random(UtRandom *g)
+{
+    uint64_t old = g->state;
+    g->state = old * 6364136223846793005ULL + g->inc;
+    uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+    uint32_t rot = old >> 59;
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+void ut_randomSeed(UtRandom *g, uint64_t seed, uint64_t stream)
+{
+    g->state = 0;
+    g->inc = (stream << 1) | 1;
+    ut_random(g);
+    g->state += seed;
+    ut_random(g);
+}
+
+// tirage dans [min,max[ arrondi à 1/<puiss> ; 24 bits : tous les floats
+// de [0,1[ ainsi obtenus sont exacts
+static inline float randomFloat(UtRandom *g, float min, float max, int puiss)
+{
+    float r;
+    do
+    {
+        float u = (ut_random(g) >> 8) * (1.0f / 16777216.0f);
+        r = u * (max - min) + min;
+        r = floorf(r*puiss)/puiss;
+    } while (r >= max);
+    return r;
+}
+
+static int power10(int precision)
+{
+    myassert(precision >= 0, "la précision doit être positive");
+    int puiss = 1;
+    for (int i = 0; i < precision; i++)
+        puiss *= 10;
+    return puiss;
+}
+
+float ut_randomFloat(UtRandom *g, float min, float max, int precision)
+{
+    myassert(min < max, "min doit être strictement inférieur à max");
+    return randomFloat(g, min, max, power10(precision));
+}
+
+void ut_randomFillTab(UtRandom *g, float *t, int size, float min, float max, int precision)
+{
+    myassert(min < max, "min doit être strictement inférieur à max");
+    int puiss = power10(precision);
+    for (int i = 0; i < size; i++)
+        t[i] = randomFloat(g, min, max, puiss);
+}
+
+// nombre de [0,1[ en double (32 bits aléatoires)
+static double randomUnit(UtRandom *g)
+{
+    return ut_random(g) * (1.0 / 4294967296.0);
+}
+
+static const char * const distNames[UT_NB_DISTRIBUTIONS] =
+    { "uniform", "zipf", "normal", "sorted", "reverse", "few" };
+
+int ut_distributionFromName(const char *name)
+{
+    for (int d = 0; d < UT_NB_DISTRIBUTIONS; d++)
+        if (strcmp(name, distNames[d]) == 0)
+            return d;
+    return -1;
+}
+
+const char * ut_distributionName(UtDistribution dist)
+{
+    myassert(dist >= 0 && dist < UT_NB_DISTRIBUTIONS, "distribution inconnue");
+    return distNames[dist];
+}
+
+// Zipf : la grille des valeurs possibles est {(m0 + k) / puiss}, k dans
+// [0, n[ ; la fonction de répartition est tabulée une fois, chaque tirage
+// est une recherche dichotomique. La table est bornée : au-delà de
+// ZIPF_MAX_VALUES valeurs, les rangs suivants (de probabilité
+// négligeable) ne sont jamais tirés.
+#define ZIPF_MAX_VALUES (1 << 20)
+
+static void fillZipf(UtRandom *g, float *t, int size, float min, float max, int puiss)
+{
+    double m0 = ceil((double) min * puiss);
+    double n = ceil((double) max * puiss) - m0;
+    myassert(n >= 1, "aucune valeur de la grille dans [min,max[");
+    int nbValues = (n > ZIPF_MAX_VALUES) ? ZIPF_MAX_VALUES : (int) n;
+
+    double *cdf = malloc(nbValues * sizeof(double));
+    myassert(cdf != NULL, "allocation mémoire table Zipf");
+    double total = 0;
+    for (int k = 0; k < nbValues; k++)
+    {
+        total += 1.0 / (k + 1);
+        cdf[k] = total;
+    }
+
+    for (int i = 0; i < size; i++)
+    {
+        double u = randomUnit(g) * total;
+        int lo = 0, hi = nbValues - 1;       // premier k tel que u < cdf[k]
+        while (lo < hi)
+        {
+            int mid = lo + (hi - lo) / 2;
+            if (u < cdf[mid])
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        t[i] = (float) ((m0 + lo) / puiss);
+    }
+    free(cdf);
+}
+
+// gaussienne par Box-Muller (deux tirages par paire de valeurs)
+static void fillNormal(UtRandom *g, float *t, int size, float min, float max, int puiss)
+{
+    const double twoPi = 6.283185307179586;
+    double mean = ((double) min + max) / 2;
+    double sigma = ((double) max - min) / 6;
+    int i = 0;
+    while (i < size)
+    {
+        double u1 = 1.0 - randomUnit(g);     // ]0,1] : log défini
+        double u2 = randomUnit(g);
+        double radius = sqrt(-2 * log(u1)) * sigma;
+        double pair[2] = { mean + radius * cos(twoPi * u2), mean + radius * sin(twoPi * u2) };
+        for (int j = 0; j < 2 && i < size; j++)
+        {
+            float r = floorf((float) pair[j] * puiss) / puiss;
+            if (r >= min && r < max)
+                t[i++] = r;
+        }
+    }
+}
+
+static void fillFew(UtRandom *g, float *t, int size, float min, float max, int puiss)
+{
+    float values[UT_FEW_VALUES];
+    for (int v = 0; v < UT_FEW_VALUES; v++)
+        values[v] = randomFloat(g, min, max, puiss);
+    for (int i = 0; i < size; i++)
+        t[i] = values[ut_random(g) % UT_FEW_VALUES];
+}
+
+static int cmpFloat(const void *a, const void *b)
+{
+    float x = *(const float *) a, y = *(const float *) b;
+    return (x > y) - (x < y);
+}
+
+// la plus petite valeur de la grille >= min doit être < max (même calcul
+// que fillZipf)
+bool ut_gridHasValue(float min, float max, int precision)
+{
+    int puiss = power10(precision);
+    return min < max && ceil((double) min * puiss) / puiss < max;
+}
+
+void ut_fillDist(UtRandom *g, UtDistribution dist, float *t, int size, float min, float max, int precision)
+{
+    // vérifié une fois pour toutes : sans valeur possible, normal tirerait
+    // sans fin et zipf n'aurait pas de table
+    myassert(ut_gridHasValue(min, max, precision), "aucune valeur de la grille dans [min,max[");
+    int puiss = power10(precision);
+
+    switch (dist)
+    {
+    case UT_ZIPF:
+        fillZipf(g, t, size, min, max, puiss);
+        break;
+    case UT_NORMAL:
+        fillNormal(g, t, size, min, max, puiss);
+        break;
+    case UT_FEW_DISTINCT:
+        fillFew(g, t, size, min, max, puiss);
+        break;
+    case UT_UNIFORM:
+    case UT_SORTED:
+    case UT_REVERSE_SORTED:
+        for (int i = 0; i < size; i++)
+            t[i] = randomFloat(g, min, max, puiss);
+        if (dist != UT_UNIFORM)
+            qsort(t, size, sizeof(float), cmpFloat);
+        if (dist == UT_REVERSE_SORTED)
+        {
+            for (int i = 0, j = size - 1; i < j; i++, j--)
+            {
+                float tmp = t[i];
+                t[i] = t[j];
+                t[j] = tmp;
+            }
+        }
+        break;
+    default:
+        myassert(false, "distribution inconnue");
+    }
+}
+
+float * ut_generateDist(UtRandom *g, UtDistribution dist, int size, float min, float max, int precision)
+{
+    float *t = malloc(size * sizeof(float));
+    myassert(t != NULL, "allocation mémoire génération tableau float");
+    ut_fillDist(g, dist, t, size, min, max, precision);
     return t;
 }
 
 
+/******************************************
+ * mesure du temps
+ ******************************************/
+double ut_now()
+{
+    struct timespec ts;
+    int ret = clock_gettime(CLOCK_MONOTONIC, &ts);
+    myassert(ret == 0, "Erreur");
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/******************************************
+ * boucle parallèle
+ ******************************************/
+#define UT_CACHE_LINE 64
+
+// état commun : seul le curseur est modifié, une fois par morceau
+typedef struct
+{
+    int nb;
+    int chunk;
+    long cursor;            // prochain indice à distribuer (chaque thread le
+                            // dépasse d'un morceau à la fin : pas d'int)
+    UtLoopBody body;
+    void *arg;
+} Loop;
+
+// état propre à un thread, seul sur sa ligne de cache (pas de faux partage
+// entre accumulateurs voisins)
+typedef union
+{
+    struct
+    {
+        long accumulator;
+        UtThreadStats stats;
+        Loop *loop;
+        pthread_t thread;
+    } s;
+    char pad[UT_CACHE_LINE];
+} Slot;
+
+static void * runSlot(void *arg)
+{
+    Slot *slot = arg;
+    Loop *loop = slot->s.loop;
+    double start = ut_now();
+
+    for (;;)
+    {
+        long begin = __atomic_fetch_add(&(loop->cursor), loop->chunk, __ATOMIC_RELAXED);
+        if (begin >= loop->nb)
+            break;
+        int end = (loop->nb - begin < loop->chunk) ? loop->nb : begin + loop->chunk;
+        loop->body(begin, end, &(slot->s.accumulator), loop->arg);
+        slot->s.stats.nbIndices += end - begin;
+        slot->s.stats.nbChunks++;
+    }
+
+    slot->s.stats.seconds = ut_now() - start;
+    return NULL;
+}
+
+long ut_parallelFor(int nb, int chunk, int nbThreads, UtLoopBody body, void *arg, UtThreadStats *stats)
+{
+    myassert(nb >= 0 && chunk > 0 && nbThreads > 0, "paramètres de boucle incorrects");
+    myassert(sizeof(Slot) == UT_CACHE_LINE, "état d'un thread plus grand qu'une ligne de cache");
+
+    Loop loop = { nb, chunk, 0, body, arg };
+
+    Slot *slots;
+    int ret = posix_memalign((void **) &slots, UT_CACHE_LINE, nbThreads * sizeof(Slot));
+    myassert(ret == 0, "allocation des états des threads");
+    memset(slots, 0, nbThreads * sizeof(Slot));
+
+    for (int i = 0; i < nbThreads; i++)
+    {
+        slots[i].s.loop = &loop;
+        if (i > 0)
+        {
+            ret = pthread_create(&(slots[i].s.thread), NULL, runSlot, &(slots[i]));
+            myassert(ret == 0, "création d'un thread");
+        }
+    }
+    runSlot(&(slots[0]));
+
+    long result = slots[0].s.accumulator;
+    for (int i = 1; i < nbThreads; i++)
+    {
+        ret = pthread_join(slots[i].s.thread, NULL);
+        myassert(ret == 0, "Erreur");
+        result += slots[i].s.accumulator;
+    }
+    if (stats != NULL)
+        for (int i = 0; i < nbThreads; i++)
+            stats[i] = slots[i].s.stats;
+
+    free(slots);
+    return result;
+}
+
+
 //TODO d'autres fonctions utilitaires éventuellement
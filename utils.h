@@ -2,6 +2,8 @@
 #define UTILS_H
 
 //TODO d'autres include éventuellement
+#include <stdbool.h>
+#include <stdint.h>
 
 
 /******************************************
@@ -12,6 +14,94 @@ float ut_getAleaFloat(float min, float max, int precision);
 
 // tableau de float aléatoires utilisant la fonction ci-dessus
 float * ut_generateTab(int size, float min, float max, int precision);
+// idem dans un tableau déjà alloué (mémoire partagée par exemple)
+void ut_fillTab(float *t, int size, float min, float max, int precision);
+
+// générateur PCG32 à état explicite : rapide, sans état global (un par
+// thread), et reproductible. Deux flux (<stream>) différents d'une même
+// graine donnent des suites indépendantes : on peut attribuer un flux à
+// chaque morceau de travail pour que le résultat ne dépende pas du nombre
+// de threads ni de l'ordonnancement.
+typedef struct
+{
+    uint64_t state;
+    uint64_t inc;           // toujours impair, fixe le flux
+} UtRandom;
+
+// (ré)initialise <g> sur le flux <stream> de la graine <seed>
+void ut_randomSeed(UtRandom *g, uint64_t seed, uint64_t stream);
+// 32 bits aléatoires
+uint32_t ut_random(UtRandom *g);
+// comme ut_getAleaFloat, mais tiré de <g>
+float ut_randomFloat(UtRandom *g, float min, float max, int precision);
+// comme ut_fillTab, mais tiré de <g>
+void ut_randomFillTab(UtRandom *g, float *t, int size, float min, float max, int precision);
+
+// distributions de charge, pour reproduire un incident ou un pire cas.
+// Toutes tirent dans [min,max[ des valeurs arrondies à <precision>
+// chiffre(s) après la virgule :
+// - UT_UNIFORM : comme ut_randomFillTab
+// - UT_ZIPF : la k-ième valeur de la grille (à partir de min) avec une
+//   probabilité proportionnelle à 1/k ; les petites valeurs sont "chaudes"
+// - UT_NORMAL : gaussienne centrée au milieu, écart-type (max-min)/6,
+//   tirages hors de l'intervalle rejetés
+// - UT_SORTED, UT_REVERSE_SORTED : uniforme, puis trié (in)croissant ;
+//   insérés dans cet ordre, ils déséquilibrent l'arbre des workers
+// - UT_FEW_DISTINCT : UT_FEW_VALUES valeurs uniformes, chaque élément est
+//   l'une d'elles
+typedef enum
+{
+    UT_UNIFORM,
+    UT_ZIPF,
+    UT_NORMAL,
+    UT_SORTED,
+    UT_REVERSE_SORTED,
+    UT_FEW_DISTINCT,
+    UT_NB_DISTRIBUTIONS
+} UtDistribution;
+
+#define UT_FEW_VALUES 8
+
+// [min,max[ contient-il au moins une valeur arrondie à <precision>
+// chiffre(s) après la virgule ? (sinon ut_fillDist refuse l'intervalle)
+bool ut_gridHasValue(float min, float max, int precision);
+// distribution de nom <name> ("uniform", "zipf", "normal", "sorted",
+// "reverse", "few"), -1 si le nom est inconnu
+int ut_distributionFromName(const char *name);
+const char * ut_distributionName(UtDistribution dist);
+// remplit t[0..size[ selon <dist>, en une fois (tri, tables), depuis <g>
+void ut_fillDist(UtRandom *g, UtDistribution dist, float *t, int size, float min, float max, int precision);
+// idem dans un tableau alloué (à libérer)
+float * ut_generateDist(UtRandom *g, UtDistribution dist, int size, float min, float max, int precision);
+
+/******************************************
+ * mesure du temps
+ ******************************************/
+// instant courant en secondes (horloge monotone, origine quelconque)
+double ut_now();
+
+/******************************************
+ * boucle parallèle
+ ******************************************/
+// travail fait par un thread d'une boucle parallèle
+typedef struct
+{
+    int nbIndices;          // indices traités
+    int nbChunks;           // morceaux pris
+    double seconds;         // durée, de son départ à sa fin
+} UtThreadStats;
+
+// corps de boucle : traite les indices [begin, end[ et cumule son résultat
+// dans <local>, l'accumulateur propre au thread
+typedef void (*UtLoopBody)(int begin, int end, long *local, void *arg);
+
+// exécute <body> sur [0, nb[ avec <nbThreads> threads (l'appelant est le
+// thread 0) ; les morceaux de <chunk> indices sont pris à la demande (un
+// curseur atomique) : un thread retardé en traite simplement moins. Chaque
+// thread a son accumulateur sur sa propre ligne de cache, ils ne sont
+// additionnés qu'à la fin : c'est le résultat renvoyé. <stats> (nbThreads
+// cases) reçoit le travail de chaque thread, s'il n'est pas NULL.
+long ut_parallelFor(int nb, int chunk, int nbThreads, UtLoopBody body, void *arg, UtThreadStats *stats);
 
 //TODO d'autres fonctions utilitaires éventuellement
 
@@ -0,0 +1,210 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// ftruncate, fdatasync
+#define _XOPEN_SOURCE 500
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "myassert.h"
+
+#include "wal.h"
+
+// taille initiale du groupe en mémoire (octets)
+#define INIT_CAPACITY  4096
+
+
+/************************************************************************
+ * Structures
+ ************************************************************************/
+typedef struct
+{
+    int magic;                  // WL_MAGIC
+    int version;                // WL_VERSION
+} WalHeader;
+
+struct Wal
+{
+    int fd;
+
+    // groupe en cours : enregistrements pas encore écrits
+    char *buffer;
+    int size;
+    int capacity;
+    int nbRecords;
+};
+
+
+/************************************************************************
+ * Ouverture, fermeture
+ ************************************************************************/
+static void writeAll(int fd, const void *buf, int size)
+{
+    const char *p = buf;
+    while (size > 0)
+    {
+        int ret = write(fd, p, size);
+        myassert(ret > 0, "écriture du journal");
+        p += ret;
+        size -= ret;
+    }
+}
+
+Wal * wl_open(const char *path)
+{
+    Wal *wal = malloc(sizeof(Wal));
+    myassert(wal != NULL, "Erreur");
+
+    wal->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    myassert(wal->fd != -1, "ouverture du journal");
+    // les workers n'en héritent pas
+    int ret = fcntl(wal->fd, F_SETFD, FD_CLOEXEC);
+    myassert(ret == 0, "Erreur");
+
+    struct stat st;
+    ret = fstat(wal->fd, &st);
+    myassert(ret == 0, "Erreur");
+    if (st.st_size == 0)
+    {
+        WalHeader header = { WL_MAGIC, WL_VERSION };
+        writeAll(wal->fd, &header, sizeof(WalHeader));
+        ret = fdatasync(wal->fd);
+        myassert(ret == 0, "Erreur");
+    }
+
+    wal->buffer = malloc(INIT_CAPACITY);
+    myassert(wal->buffer != NULL, "Erreur");
+    wal->size = 0;
+    wal->capacity = INIT_CAPACITY;
+    wal->nbRecords = 0;
+    return wal;
+}
+
+void wl_close(Wal *wal)
+{
+    myassert(! wl_pending(wal), "groupe non synchronisé");
+    int ret = close(wal->fd);
+    myassert(ret == 0, "Erreur");
+    free(wal->buffer);
+    free(wal);
+}
+
+
+/************************************************************************
+ * Relecture
+ ************************************************************************/
+float * wl_replay(Wal *wal, int *nb)
+{
+    struct stat st;
+    int ret = fstat(wal->fd, &st);
+    myassert(ret == 0, "Erreur");
+    long size = st.st_size;
+
+    char *content = malloc(size);
+    myassert(content != NULL, "Erreur");
+    long done = 0;
+    while (done < size)
+    {
+        ret = pread(wal->fd, content + done, size - done, done);
+        myassert(ret > 0, "lecture du journal");
+        done += ret;
+    }
+
+    WalHeader header;
+    myassert(size >= (long) sizeof(WalHeader), "journal tronqué");
+    memcpy(&header, content, sizeof(WalHeader));
+    myassert(header.magic == WL_MAGIC && header.version == WL_VERSION, "ce fichier n'est pas un journal");
+
+    // premier passage : enregistrements complets
+    long pos = sizeof(WalHeader);
+    *nb = 0;
+    while (pos + (long) sizeof(int) <= size)
+    {
+        int count;
+        memcpy(&count, content + pos, sizeof(int));
+        long end = pos + sizeof(int) + (long) count * sizeof(float);
+        if (count <= 0 || end > size)
+            break;
+        *nb += count;
+        pos = end;
+    }
+
+    // enregistrement incomplet en fin de fichier : il n'a jamais été acquitté
+    if (pos != size)
+    {
+        ret = ftruncate(wal->fd, pos);
+        myassert(ret == 0, "Erreur");
+        ret = fdatasync(wal->fd);
+        myassert(ret == 0, "Erreur");
+    }
+
+    float *elts = NULL;
+    if (*nb > 0)
+    {
+        elts = malloc(*nb * sizeof(float));
+        myassert(elts != NULL, "Erreur");
+        long end = pos;
+        int idx = 0;
+        for (pos = sizeof(WalHeader); pos < end; )
+        {
+            int count;
+            memcpy(&count, content + pos, sizeof(int));
+            memcpy(elts + idx, content + pos + sizeof(int), count * sizeof(float));
+            idx += count;
+            pos += sizeof(int) + (long) count * sizeof(float);
+        }
+    }
+
+    free(content);
+    return elts;
+}
+
+
+/************************************************************************
+ * Groupes
+ ************************************************************************/
+void wl_append(Wal *wal, const float *elts, int nb)
+{
+    myassert(nb > 0, "enregistrement vide");
+
+    int size = sizeof(int) + nb * sizeof(float);
+    if (wal->size + size > wal->capacity)
+    {
+        while (wal->size + size > wal->capacity)
+            wal->capacity *= 2;
+        wal->buffer = realloc(wal->buffer, wal->capacity);
+        myassert(wal->buffer != NULL, "Erreur");
+    }
+
+    memcpy(wal->buffer + wal->size, &nb, sizeof(int));
+    memcpy(wal->buffer + wal->size + sizeof(int), elts, nb * sizeof(float));
+    wal->size += size;
+    wal->nbRecords++;
+}
+
+bool wl_pending(const Wal *wal)
+{
+    return wal->nbRecords > 0;
+}
+
+int wl_commit(Wal *wal)
+{
+    int nbRecords = wal->nbRecords;
+    if (nbRecords == 0)
+        return 0;
+
+    writeAll(wal->fd, wal->buffer, wal->size);
+    int ret = fdatasync(wal->fd);
+    myassert(ret == 0, "synchronisation du journal");
+
+    wal->size = 0;
+    wal->nbRecords = 0;
+    return nbRecords;
+}
@@ -0,0 +1,40 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <stdbool.h>
+
+/************************************************************************
+ * Journal des insertions (master --wal)
+ *
+ * Fichier en ajout seul : un en-tête (numéro magique, version) puis un
+ * enregistrement par ordre d'insertion (nombre d'éléments, éléments).
+ * Les enregistrements sont accumulés en mémoire puis écrits et
+ * synchronisés ensemble (wl_commit : une écriture et un fdatasync pour
+ * tout un groupe) ; une insertion n'est acquittée qu'une fois dans un
+ * groupe synchronisé.
+ * Au démarrage le journal est relu (wl_replay) ; un dernier enregistrement
+ * incomplet (arrêt brutal pendant l'écriture) est retiré du fichier.
+ ************************************************************************/
+
+#define WL_MAGIC        0x314c4157      // "WAL1" en petit-boutiste
+#define WL_VERSION      1
+
+typedef struct Wal Wal;
+
+// ouverture (création si besoin) ; arrête le programme si le fichier
+// n'est pas un journal
+Wal * wl_open(const char *path);
+void wl_close(Wal *wal);
+
+// tous les éléments journalisés, dans l'ordre (tableau à libérer, NULL
+// si le journal est vide) ; à appeler une fois, juste après wl_open
+float * wl_replay(Wal *wal, int *nb);
+
+// ajout d'un enregistrement au groupe en cours (aucun appel système)
+void wl_append(Wal *wal, const float *elts, int nb);
+bool wl_pending(const Wal *wal);
+// écriture et synchronisation du groupe en cours ; renvoie le nombre
+// d'enregistrements synchronisés
+int wl_commit(Wal *wal);
+
+#endif
@@ -6,12 +6,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/socket.h>
+#include <poll.h>
 
 #include "utils.h"
 #include "myassert.h"
+#include "frame.h"
+#include "snapshot.h"
 
 #include "master_worker.h"
 
@@ -19,92 +25,360 @@
 /************************************************************************
  * Données persistantes d'un worker
  ************************************************************************/
+// ce que le worker sait de chacun de ses fils
 typedef struct
 {
-    // données internes (valeur de l'élément, cardinalité)
-    float elt;
-    int cardinality;
-    pid_t leftChildPid;
-    pid_t rightChildPid;
+    int fd;             // socket vers le fils, -1 si le fils n'existe pas
+    int height;         // hauteur du sous-arbre du fils (0 si absent)
+    int balance;        // déséquilibre du fils (hauteur gauche - hauteur droite)
+    Summary summary;    // résumé du sous-arbre du fils (cf. master_worker.h)
+    int inFlight;       // insertions transmises au fils et pas encore acquittées
+} Child;
+
+typedef struct
+{
+    // données internes : bloc trié de paires (élément, cardinalité), jamais
+    // vide (cf. MW_BLOCK_SIZE)
+    ExportEntry block[MW_BLOCK_SIZE];
+    int nbEntries;
 
-    // communication avec le père (2 tubes)
+    // hauteur et résumé du sous-arbre dont le worker est la racine
+    int height;
+    Summary summary;
+
+    // communication avec le père (2 tubes pour le premier worker,
+    // une même socket dans les deux sens pour les autres)
     int parentToWorker[2];
     int workerToParent[2];
 
     // communication avec le master (1 tube en écriture)
     int workerToMaster[2];
 
-    // communication avec le fils gauche s'il existe (2 tubes)
-    int leftChildToWorker[2];
-    int workerToLeftChild[2];
+    // arêtes avec les fils en mémoire partagée (cf. MW_TRANSPORT_RING)
+    bool ring;
+
+    // demandes de fils aux zygotes (cf. MW_ZYGOTE), -1 : fork + exec
+    int poolOut;
 
-    // communication avec le fils droit s'il existe (2 tubes)
-    int rightChildToWorker[2];
-    int workerToRightChild[2];
+    // communication avec les fils : child[MW_LEFT] et child[MW_RIGHT]
+    // (une socket par fils)
+    // Les fils ne sont pas forcément des processus fils : une rotation
+    // fait passer un sous-arbre d'un worker à un autre.
+    Child child[2];
 
 } Data;
 
 
+/************************************************************************
+ * Bloc trié (cf. MW_BLOCK_SIZE)
+ ************************************************************************/
+// premier indice de <entries> (trié) dont l'élément n'est pas < elt
+static int lowerBound(const ExportEntry *entries, int nb, float elt)
+{
+    int lo = 0, hi = nb;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (entries[mid].elt < elt)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// premier indice de <entries> (trié) dont l'élément est > elt
+static int upperBound(const ExportEntry *entries, int nb, float elt)
+{
+    int lo = 0, hi = nb;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (entries[mid].elt <= elt)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static float blockMin(const Data *data)
+{
+    return data->block[0].elt;
+}
+
+static float blockMax(const Data *data)
+{
+    return data->block[data->nbEntries - 1].elt;
+}
+
+// un élément entre les extrêmes du bloc ne peut être que dans le bloc
+static bool inBlock(const Data *data, float elt)
+{
+    return blockMin(data) <= elt && elt <= blockMax(data);
+}
+
+// nombre d'éléments du bloc, cardinalités comprises
+static int blockElements(const Data *data)
+{
+    int nb = 0;
+    for (int i = 0; i < data->nbEntries; i++)
+        nb += data->block[i].cardinality;
+    return nb;
+}
+
+// ajout d'une paire à l'indice <pos> (il reste de la place)
+static void insertEntry(Data *data, int pos, float elt, int cardinality)
+{
+    myassert(data->nbEntries < MW_BLOCK_SIZE, "bloc plein");
+    memmove(data->block + pos + 1, data->block + pos, (data->nbEntries - pos) * sizeof(ExportEntry));
+    data->block[pos].elt = elt;
+    data->block[pos].cardinality = cardinality;
+    data->nbEntries++;
+}
+
+// retrait de la paire d'indice <pos>
+static ExportEntry removeEntry(Data *data, int pos)
+{
+    ExportEntry entry = data->block[pos];
+    memmove(data->block + pos, data->block + pos + 1, (data->nbEntries - pos - 1) * sizeof(ExportEntry));
+    data->nbEntries--;
+    return entry;
+}
+
+
+/************************************************************************
+ * Forme du sous-arbre : hauteur, déséquilibre et résumé
+ ************************************************************************/
+// à appeler dès que le bloc ou un des fils change
+static void updateShape(Data *data)
+{
+    const Child *left = &(data->child[MW_LEFT]);
+    const Child *right = &(data->child[MW_RIGHT]);
+
+    data->height = 1 + (left->height > right->height ? left->height : right->height);
+
+    Summary *summary = &(data->summary);
+    summary->nbElements = 0;
+    summary->nbDistinctElements = data->nbEntries;
+    summary->sum = 0;
+    for (int i = 0; i < data->nbEntries; i++)
+    {
+        summary->nbElements += data->block[i].cardinality;
+        summary->sum += data->block[i].elt * data->block[i].cardinality;
+    }
+    summary->min = blockMin(data);
+    summary->max = blockMax(data);
+    for (int side = MW_LEFT; side <= MW_RIGHT; side++)
+    {
+        if (data->child[side].fd == -1)
+            continue;
+        summary->nbElements += data->child[side].summary.nbElements;
+        summary->nbDistinctElements += data->child[side].summary.nbDistinctElements;
+        summary->sum += data->child[side].summary.sum;
+    }
+    // arbre de recherche : les extrêmes sont dans les sous-arbres extrêmes
+    if (left->fd != -1)
+        summary->min = left->summary.min;
+    if (right->fd != -1)
+        summary->max = right->summary.max;
+}
+
+static int balance(const Data *data)
+{
+    return data->child[MW_LEFT].height - data->child[MW_RIGHT].height;
+}
+
+// aucune insertion en cours dans les sous-arbres : rotations possibles
+static bool isQuiet(const Data *data)
+{
+    return data->child[MW_LEFT].inFlight == 0 && data->child[MW_RIGHT].inFlight == 0;
+}
+
+static void writeShape(const Data *data, int fd)
+{
+    writeToWorker(data->height, fd);
+    writeToWorker(balance(data), fd);
+    writeSummaryToWorker(&(data->summary), fd);
+}
+
+// lecture de la forme envoyée par writeShape
+static void readShape(Child *child, int fd)
+{
+    child->height = readWorker(fd);
+    child->balance = readWorker(fd);
+    readSummaryWorker(&(child->summary), fd);
+}
+
+// transmission complète d'un fils (socket comprise) à un autre worker
+static void writeChild(const Child *child, int fd)
+{
+    myassert(child->inFlight == 0, "sous-arbre en cours de modification");
+    writeFdToWorker(child->fd, fd);
+    writeToWorker(child->height, fd);
+    writeToWorker(child->balance, fd);
+    writeSummaryToWorker(&(child->summary), fd);
+}
+
+static void readChild(Child *child, int fd)
+{
+    child->fd = readFdWorker(fd);
+    readShape(child, fd);
+    child->inFlight = 0;
+}
+
+// réponse attendue d'un fils lors d'un échange synchrone (aucune
+// insertion en cours avec lui, donc pas d'autre message possible)
+static void expectAnswer(int fd, int expected)
+{
+    int reqId;
+    int answer = readHeaderWorker(fd, &reqId);
+    myassert(answer == expected, "réponse inattendue");
+}
+
+// les fils de <pending> ont reçu le même ordre en même temps : on attend
+// sur les deux canaux à la fois (comme loop) le premier qui répond ;
+// renvoie son côté, retiré de <pending>, le contenu de la réponse reste à
+// lire
+static int gatherAnswer(const Data *data, bool pending[2], int expected)
+{
+    myassert(pending[MW_LEFT] || pending[MW_RIGHT], "aucune réponse attendue");
+
+    for (;;)
+    {
+        struct pollfd fds[2];
+        bool ready = false;
+        for (int side = MW_LEFT; side <= MW_RIGHT; side++)
+        {
+            fds[side].fd = pending[side] ? data->child[side].fd : -1;
+            fds[side].events = POLLIN;
+            fds[side].revents = fr_hasData(fds[side].fd) ? POLLIN : 0;
+            ready = ready || (fds[side].revents != 0);
+        }
+
+        if (! ready)
+        {
+            fr_flushAll();
+            for (int side = MW_LEFT; side <= MW_RIGHT; side++)
+                ready = ready || ! fr_sleep(fds[side].fd);
+        }
+        if (! ready)
+        {
+            int ret = poll(fds, 2, -1);
+            myassert(ret > 0, "Erreur");
+
+            // un anneau peut réveiller sans trame (cf. frame.h)
+            for (int side = MW_LEFT; side <= MW_RIGHT; side++)
+                if (fds[side].revents != 0 && ! fr_ready(fds[side].fd))
+                    fds[side].revents = 0;
+        }
+
+        for (int side = MW_LEFT; side <= MW_RIGHT; side++)
+        {
+            if (fds[side].revents != 0)
+            {
+                pending[side] = false;
+                expectAnswer(fds[side].fd, expected);
+                return side;
+            }
+        }
+    }
+}
+
+
 /************************************************************************
  * Usage et analyse des arguments passés en ligne de commande
  ************************************************************************/
 static void usage(const char *exeName, const char *message)
 {
-    fprintf(stderr, "usage : %s <elt> <fdIn> <fdOut> <fdToMaster>\n", exeName);
-    fprintf(stderr, "   <elt> : élément géré par le worker\n");
+    fprintf(stderr, "usage : %s <elt> <cardinality> <fdIn> <fdOut> <fdToMaster> <transport> <fdRing> <fdPool>\n", exeName);
+    fprintf(stderr, "        %s " MW_ZYGOTE " <fdPoolIn> <fdPoolOut> <fdToMaster> <transport>\n", exeName);
+    fprintf(stderr, "   <elt> : premier élément géré par le worker\n");
+    fprintf(stderr, "   <cardinality> : cardinalité de cet élément\n");
     fprintf(stderr, "   <fdIn> : canal d'entrée (en provenance du père)\n");
     fprintf(stderr, "   <fdOut> : canal de sortie (vers le père)\n");
     fprintf(stderr, "   <fdToMaster> : canal de sortie directement vers le master\n");
+    fprintf(stderr, "   <transport> : " MW_TRANSPORT_SOCKET " ou " MW_TRANSPORT_RING " (arêtes vers les fils)\n");
+    fprintf(stderr, "   <fdRing> : anneau de l'arête avec le père, -1 si aucun\n");
+    fprintf(stderr, "   <fdPool> : demandes de fils aux zygotes, -1 si aucun\n");
     if (message != NULL)
         fprintf(stderr, "message : %s\n", message);
     exit(EXIT_FAILURE);
 }
-static void parseArgs(int argc, char * argv[], Data *data)
+// un worker démarre soit par exec (parseArgs), soit forké par un zygote
+static void initData(Data *data, float elt, int cardinality, int fdIn, int fdOut, int fdToMaster, bool ring,
+                     int fdRing, int poolOut)
 {
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    if (argc != 5)
-        usage(argv[0], "Nombre d'arguments incorrect");
-
     //TODO initialisation data
 
-    data->elt = strtof(argv[1], NULL);
-    data->leftChildPid = -1;
-    data->rightChildPid = -1;
+    data->block[0].elt = elt;
+    data->block[0].cardinality = cardinality;
+    data->nbEntries = 1;
 
-    // Communication avec le père (2 tubes)
+    // Communication avec le père
     data->parentToWorker[1] = -1;
-    data->parentToWorker[0] = atoi(argv[2]);
+    data->parentToWorker[0] = fdIn;
 
-    data->workerToParent[1] = atoi(argv[3]);
+    data->workerToParent[1] = fdOut;
     data->workerToParent[0] = -1;
 
     // Communication avec le master (1 tube en écriture)
     data->workerToMaster[0] = -1;
-    data->workerToMaster[1] = atoi(argv[4]);
-
-//    // Communication avec le fils gauche s'il existe (2 tubes)
-//    ret = pipe(data->leftChildToWorker);
-//    myassert(ret == 0, "Erreur");
-//    ret = pipe(data->workerToLeftChild);
-//    myassert(ret == 0, "Erreur");
+    data->workerToMaster[1] = fdToMaster;
+
+    // les fils ne doivent pas hériter du canal avec le père, sinon le
+    // père ne verrait jamais la fin de ce worker ; le canal vers le master
+    // est en revanche partagé par tous les workers
+    setCloseOnExec(data->parentToWorker[0], true);
+    setCloseOnExec(data->workerToParent[1], true);
+
+    // transport des arêtes
+    data->ring = ring;
+    data->poolOut = poolOut;
+    if (fdRing != -1)
+    {
+        setCloseOnExec(fdRing, true);
+        fr_ringAttach(data->parentToWorker[0], fdRing);
+    }
 
-//    // Communication avec le fils droit s'il existe (2 tubes)
-//    ret = pipe(data->rightChildToWorker);
-//    myassert(ret == 0, "Erreur");
-//    ret = pipe(data->workerToRightChild);
-//    myassert(ret == 0, "Erreur");
+    // Communication avec les fils : les sockets sont créées à l'insertion
+    for (int side = MW_LEFT; side <= MW_RIGHT; side++)
+    {
+        data->child[side].fd = -1;
+        data->child[side].height = 0;
+        data->child[side].balance = 0;
+        data->child[side].inFlight = 0;
+    }
+    updateShape(data);
 
     //END TODO
 }
 
+static bool parseTransport(const char *exeName, const char *arg)
+{
+    if (strcmp(arg, MW_TRANSPORT_SOCKET) != 0 && strcmp(arg, MW_TRANSPORT_RING) != 0)
+        usage(exeName, "transport inconnu");
+    return strcmp(arg, MW_TRANSPORT_RING) == 0;
+}
+
+static void parseArgs(int argc, char * argv[], Data *data)
+{
+    if (argc != 9)
+        usage(argv[0], "Nombre d'arguments incorrect");
+
+    initData(data, strtof(argv[1], NULL), atoi(argv[2]), atoi(argv[3]), atoi(argv[4]), atoi(argv[5]),
+             parseTransport(argv[0], argv[6]), atoi(argv[7]), atoi(argv[8]));
+}
+
 
 /************************************************************************
  * Stop
  ************************************************************************/
 void stopAction(Data *data)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre stop\n", getpid(), getppid(), data->elt /*TODO élément*/);
+    TRACE3("    [worker (%d, %d) {%g}] : ordre stop\n", getpid(), getppid(), data->block[0].elt /*TODO élément*/);
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
     //TODO
@@ -113,27 +387,31 @@ void stopAction(Data *data)
     // - envoyer au worker droit ordre de fin (cf. master_worker.h)
     // - attendre la fin des deux fils
     //END TODO
-    int ret;
-
-    // Traiter les cas où les fils n'existent pas
-    if (data->leftChildPid == -1 && data->rightChildPid == -1){
-        // Rien à faire
-    }
 
-    // Envoyer l'ordre de fin au worker gauche s'il existe
-    if (data->leftChildPid != -1){
-        writeToWorker(MW_ORDER_STOP, data->workerToLeftChild[1]);
+    myassert(isQuiet(data), "ordre de fin pendant une insertion");
 
-        ret = waitpid(data->leftChildPid, NULL, 0);
-        myassert(ret != -1, "Erreur");
+    // Envoyer l'ordre de fin aux fils qui existent
+    for (int side = MW_LEFT; side <= MW_RIGHT; side++)
+    {
+        if (data->child[side].fd != -1)
+        {
+            writeHeaderToWorker(MW_ORDER_STOP, MW_NO_REQUEST, data->child[side].fd);
+            endMessageToWorker(data->child[side].fd);
+        }
     }
 
-    // Envoyer l'ordre de fin au worker droit s'il existe
-    if (data->rightChildPid != -1){
-        writeToWorker(MW_ORDER_STOP, data->workerToRightChild[1]);
-
-        ret = waitpid(data->rightChildPid, NULL, 0);
-        myassert(ret != -1, "Erreur");
+    // Attendre la fin des deux fils : après des rotations un fils n'est pas
+    // forcément un processus fils, on attend donc la fermeture de sa socket
+    for (int side = MW_LEFT; side <= MW_RIGHT; side++)
+    {
+        if (data->child[side].fd != -1)
+        {
+            FrameHeader header;
+            bool more = fr_next(data->child[side].fd, &header);
+            myassert(! more, "le fils ne doit plus rien envoyer");
+            closeWorker(data->child[side].fd);
+            data->child[side].fd = -1;
+        }
     }
 }
 
@@ -141,503 +419,1080 @@ void stopAction(Data *data)
 /************************************************************************
  * Combien d'éléments
  ************************************************************************/
-static void howManyAction(Data *data)
+static void howManyAction(Data *data, int reqId)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre how many\n", getpid(), getppid(), data->elt /*TODO élément*/);
+    TRACE3("    [worker (%d, %d) {%g}] : ordre how many\n", getpid(), getppid(), data->block[0].elt /*TODO élément*/);
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    //TODO
-    // - traiter les cas où les fils n'existent pas
-    // - pour chaque fils
-    //       . envoyer ordre howmany (cf. master_worker.h)
-    //       . recevoir accusé de réception (cf. master_worker.h)
-    //       . recevoir deux résultats (nb elts, nb elts distincts) venant du fils
-    // - envoyer l'accusé de réception au père (cf. master_worker.h)
-    // - envoyer les résultats (les cumuls des deux quantités + la valeur locale) au père
-    //END TODO
-
-    int ret;
-    int nbElements = 1;  // first woerker
-    int nbDistinctElements = 1;  // first worker
-
-    // Traiter les cas où les fils n'existent pas
-    if (data->leftChildPid == -1 && data->rightChildPid == -1)
-    {
-        ret = write(data->workerToMaster[1], &nbElements, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-
-        ret = write(data->workerToMaster[1], &nbDistinctElements, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-    }
-
-    // à chaque fils
-    if (data->leftChildPid != -1)
-    {
-        // Envoyer ordre howmany
-        writeToWorker(data->workerToLeftChild[1], MW_ORDER_HOW_MANY);
-
-        // Recevoir accusé de réception du fils gauche
-        int ackLeft = readWorker(data->leftChildToWorker[0]);
-        myassert(ackLeft == MW_ANSWER_HOW_MANY, "Erreur");
-
-        // Recevoir deux résultats du fils gauche
-        int nbElementsLeft = readWorker(data->leftChildToWorker[0]);
-        int nbDistinctElementsLeft = readWorker(data->leftChildToWorker[0]);
+    // le résumé du sous-arbre est à jour : pas besoin d'interroger les fils
 
-        // Cumuler les résultats du fils gauche
-        nbElements += nbElementsLeft;
-        nbDistinctElements += nbDistinctElementsLeft;
-    }
-
-    if (data->rightChildPid != -1)
-    {
-
-        // Envoyer ordre howmany
-        writeToWorker(data->workerToLeftChild[1], MW_ORDER_HOW_MANY);
+    // Envoyer l'accusé de réception au père
+    writeHeaderToWorker(MW_ANSWER_HOW_MANY, reqId, data->workerToParent[1]);
 
-        // Recevoir accusé de réception du fils droit
-        int ackRight = readWorker(data->rightChildToWorker[0]);
-        myassert(ackRight == MW_ANSWER_HOW_MANY, "Erreur");
+    // Envoyer les résultats cumulés au père
+    writeToWorker(data->summary.nbElements, data->workerToParent[1]);
+    writeToWorker(data->summary.nbDistinctElements, data->workerToParent[1]);
+    endMessageToWorker(data->workerToParent[1]);
+}
 
-        // Recevoir deux résultats du fils gauche
-        int nbElementsRight = readWorker(data->rightChildToWorker[0]);
-        int nbDistinctElementsRight = readWorker(data->rightChildToWorker[0]);
 
-        // Cumuler les résultats du fils gauche
-        nbElements += nbElementsRight;
-        nbDistinctElements += nbDistinctElementsRight;
-    }
+/************************************************************************
+ * Minimum
+ ************************************************************************/
+static void minimumAction(Data *data, int reqId)
+{
+    TRACE3("    [worker (%d, %d) {%g}] : ordre minimum\n", getpid(), getppid(), data->block[0].elt /*TODO élément*/);
+    myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    // Envoyer l'accusé de réception au père
-    writeToWorker(data->workerToParent[1], MW_ANSWER_HOW_MANY);
+    // le minimum du sous-arbre est connu : réponse directe au master
+    DirectAnswer answer = { MW_ANSWER_MINIMUM, reqId, data->summary.min, 0 };
+    writeDirectAnswerToMaster(&answer, data->workerToMaster[1]);
+}
 
-    // Envoyer les résultats cumulés au père
-    writeToWorker(data->workerToParent[1], nbElements);
-    writeToWorker(data->workerToParent[1], nbDistinctElements);
 
+/************************************************************************
+ * Maximum
+ ************************************************************************/
+static void maximumAction(Data *data, int reqId)
+{
+    TRACE3("    [worker (%d, %d) {%g}] : ordre maximum\n", getpid(), getppid(), data->block[0].elt /*TODO élément*/);
+    myassert(data != NULL, "il faut l'environnement d'exécution");
 
+    // le maximum du sous-arbre est connu : réponse directe au master
+    DirectAnswer answer = { MW_ANSWER_MAXIMUM, reqId, data->summary.max, 0 };
+    writeDirectAnswerToMaster(&answer, data->workerToMaster[1]);
 }
 
 
 /************************************************************************
- * Minimum
+ * Existence
  ************************************************************************/
-static void minimumAction(Data *data)
+static void existAction(Data *data, int reqId)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre minimum\n", getpid(), getppid(), data->elt /*TODO élément*/);
+    TRACE3("    [worker (%d, %d) {%g}] : ordre exist\n", getpid(), getppid(), data->block[0].elt /*TODO élément*/);
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
     //TODO
-    // - si le fils gauche n'existe pas (on est sur le minimum)
-    //       . envoyer l'accusé de réception au master (cf. master_worker.h)
-    //       . envoyer l'élément du worker courant au master
+    // - recevoir l'élément à tester en provenance du père
+    // - si élément à tester entre les extrêmes du bloc
+    //       . le chercher dans le bloc (dichotomie)
+    //       . envoyer au master l'accusé de réception de réussite (et la
+    //         cardinalité) ou d'échec (cf. master_worker.h)
+    // - sinon si pas de fils du côté de l'élément, ou élément hors de
+    //   l'intervalle [min,max] du sous-arbre de ce fils
+    //       . envoyer au master l'accusé de réception d'échec (cf. master_worker.h)
     // - sinon
-    //       . envoyer au worker gauche ordre minimum (cf. master_worker.h)
+    //       . envoyer au fils ordre exist (cf. master_worker.h)
+    //       . envoyer au fils élément à tester
     //       . note : c'est un des descendants qui enverra le résultat au master
     //END TODO
 
-    // Si le fils gauche n'existe pas (on est sur le minimum)
-    if (data->leftChildPid == -1)
+    // Recevoir l'élément à tester en provenance du père
+    float eltToTest = readFloatWorker(data->parentToWorker[0]);
+
+    // Si élément à tester entre les extrêmes du bloc : il est ici ou nulle part
+    if (inBlock(data, eltToTest))
+    {
+        // Envoyer au master l'accusé de réception et la cardinalité
+        int pos = lowerBound(data->block, data->nbEntries, eltToTest);
+        const ExportEntry *entry = &(data->block[pos]);
+        DirectAnswer answer = { MW_ANSWER_EXIST_NO, reqId, eltToTest, 0 };
+        if (entry->elt == eltToTest)
+        {
+            answer.answer = MW_ANSWER_EXIST_YES;
+            answer.cardinality = entry->cardinality;
+        }
+        writeDirectAnswerToMaster(&answer, data->workerToMaster[1]);
+        return;
+    }
+
+    int side = (eltToTest < blockMin(data)) ? MW_LEFT : MW_RIGHT;
+    const Child *child = &(data->child[side]);
+    if (child->fd == -1 || eltToTest < child->summary.min || eltToTest > child->summary.max)
     {
-        writeToWorker(data->workerToParent[1], MW_ANSWER_MINIMUM);
-        writeToWorker(data->workerToParent[1], data->elt);
+        // Envoyer au master l'accusé de réception d'échec
+        DirectAnswer answer = { MW_ANSWER_EXIST_NO, reqId, eltToTest, 0 };
+        writeDirectAnswerToMaster(&answer, data->workerToMaster[1]);
     }
     else
     {
-        // Envoyer au worker gauche l'ordre minimum
-        writeToWorker(data->workerToLeftChild[1], MW_ORDER_MINIMUM);
-
+        // Envoyer au fils l'ordre exist et l'élément à tester
+        writeHeaderToWorker(MW_ORDER_EXIST, reqId, child->fd);
+        writeFloatToWorker(eltToTest, child->fd);
+        endMessageToWorker(child->fd);
     }
+}
+
+
+/************************************************************************
+ * Somme
+ ************************************************************************/
+static void sumAction(Data *data, int reqId)
+{
+    TRACE3("    [worker (%d, %d) {%g}] : ordre sum\n", getpid(), getppid(), data->block[0].elt /*TODO élément*/);
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    // le résumé du sous-arbre est à jour : pas besoin d'interroger les fils
 
+    // Envoyer l'accusé de réception et le résultat au père
+    writeHeaderToWorker(MW_ANSWER_SUM, reqId, data->workerToParent[1]);
+    writeFloatToWorker(data->summary.sum, data->workerToParent[1]);
+    endMessageToWorker(data->workerToParent[1]);
 }
 
 
 /************************************************************************
- * Maximum
+ * Nombre et somme des éléments d'un intervalle [a,b[
  ************************************************************************/
-static void maximumAction(Data *data)
+static void rangeAction(Data *data, int order, int reqId)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre maximum\n", getpid(), getppid(), data->elt /*TODO élément*/);
+    TRACE3("    [worker (%d, %d) {%g}] : ordre range\n", getpid(), getppid(), blockMin(data));
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    //TODO
-    // cf. explications pour le minimum
-    //END TODO
+    // les résumés des fils doivent être complets (cf. master)
+    myassert(isQuiet(data), "intervalle pendant une insertion");
 
-    if (data->rightChildPid == -1)
+    float a = readFloatWorker(data->parentToWorker[0]);
+    float b = readFloatWorker(data->parentToWorker[0]);
+
+    int nbElements = 0;
+    float sum = 0;
+    for (int i = lowerBound(data->block, data->nbEntries, a); i < data->nbEntries && data->block[i].elt < b; i++)
     {
-        writeToWorker(data->workerToParent[1], MW_ANSWER_MAXIMUM);
-        writeToWorker(data->workerToParent[1], data->elt);
+        nbElements += data->block[i].cardinality;
+        sum += data->block[i].elt * data->block[i].cardinality;
     }
-    else
-    {
-        // Envoyer au worker droit l'ordre maximum
-        writeToWorker(data->workerToRightChild[1], MW_ORDER_MAXIMUM);
 
+    // un fils entièrement dans l'intervalle est compté avec son résumé,
+    // un fils entièrement dehors est ignoré, les autres sont interrogés
+    // (en parallèle)
+    bool pending[2];
+    for (int side = MW_LEFT; side <= MW_RIGHT; side++)
+    {
+        const Child *child = &(data->child[side]);
+        pending[side] = false;
+        if (child->fd == -1 || child->summary.max < a || child->summary.min >= b)
+            continue;
+        if (a <= child->summary.min && child->summary.max < b)
+        {
+            nbElements += child->summary.nbElements;
+            sum += child->summary.sum;
+            continue;
+        }
+        writeHeaderToWorker(order, reqId, child->fd);
+        writeFloatToWorker(a, child->fd);
+        writeFloatToWorker(b, child->fd);
+        endMessageToWorker(child->fd);
+        pending[side] = true;
     }
 
+    // les sommes des fils sont ajoutées dans un ordre fixe, quel que soit
+    // l'ordre d'arrivée : le résultat ne dépend pas du hasard
+    int answer = (order == MW_ORDER_RANGE_COUNT) ? MW_ANSWER_RANGE_COUNT : MW_ANSWER_RANGE_SUM;
+    int childCount[2] = { 0, 0 };
+    float childSum[2] = { 0, 0 };
+    while (pending[MW_LEFT] || pending[MW_RIGHT])
+    {
+        int side = gatherAnswer(data, pending, answer);
+        int fd = data->child[side].fd;
+        if (answer == MW_ANSWER_RANGE_COUNT)
+            childCount[side] = readWorker(fd);
+        else
+            childSum[side] = readFloatWorker(fd);
+    }
+    nbElements += childCount[MW_LEFT] + childCount[MW_RIGHT];
+    sum += childSum[MW_LEFT];
+    sum += childSum[MW_RIGHT];
+
+    // Envoyer l'accusé de réception et le résultat au père
+    writeHeaderToWorker(answer, reqId, data->workerToParent[1]);
+    if (answer == MW_ANSWER_RANGE_COUNT)
+        writeToWorker(nbElements, data->workerToParent[1]);
+    else
+        writeFloatToWorker(sum, data->workerToParent[1]);
+    endMessageToWorker(data->workerToParent[1]);
 }
 
 
 /************************************************************************
- * Existence
+ * K-ième élément et rang (un seul chemin, cf. master_worker.h)
  ************************************************************************/
-static void existAction(Data *data)
+// nombre d'éléments du sous-arbre du fils <side> (0 s'il n'existe pas) ;
+// exact même pendant une insertion (cf. insertAction)
+static int nbElementsOf(const Data *data, int side)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre exist\n", getpid(), getppid(), data->elt /*TODO élément*/);
-    myassert(data != NULL, "il faut l'environnement d'exécution");
+    const Child *child = &(data->child[side]);
+    return (child->fd == -1) ? 0 : child->summary.nbElements;
+}
 
-    //TODO
-    // - recevoir l'élément à tester en provenance du père
-    // - si élément courant == élément à tester
-    //       . envoyer au master l'accusé de réception de réussite (cf. master_worker.h)
-    //       . envoyer cardinalité de l'élément courant au master
-    // - sinon si (elt à tester < elt courant) et (pas de fils gauche)
-    //       . envoyer au master l'accusé de réception d'échec (cf. master_worker.h)
-    // - sinon si (elt à tester > elt courant) et (pas de fils droit)
-    //       . envoyer au master l'accusé de réception d'échec (cf. master_worker.h)
-    // - sinon si (elt à tester < elt courant)
-    //       . envoyer au worker gauche ordre exist (cf. master_worker.h)
-    //       . envoyer au worker gauche élément à tester
-    //       . note : c'est un des descendants qui enverra le résultat au master
-    // - sinon (donc elt à tester > elt courant)
-    //       . envoyer au worker droit ordre exist (cf. master_worker.h)
-    //       . envoyer au worker droit élément à tester
-    //       . note : c'est un des descendants qui enverra le résultat au master
-    //END TODO
+static void kthAction(Data *data, int reqId)
+{
+    TRACE3("    [worker (%d, %d) {%g}] : ordre kth\n", getpid(), getppid(), blockMin(data));
+    myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    int ret;
+    int k = readWorker(data->parentToWorker[0]);
 
-    // Recevoir l'élément à tester en provenance du père
-    int eltToTest;
-    ret = read(data->parentToWorker[0], &eltToTest, sizeof(int));
-    myassert(ret == sizeof(int), "Erreur");
+    // seul le premier worker peut recevoir un rang hors du sous-arbre
+    if (k < 1 || k > data->summary.nbElements)
+    {
+        DirectAnswer answer = { MW_ANSWER_KTH_NONE, reqId, 0, k };
+        writeDirectAnswerToMaster(&answer, data->workerToMaster[1]);
+        return;
+    }
 
-    // Si élément courant == élément à tester
-    if (data->elt == eltToTest)
+    int nbLeft = nbElementsOf(data, MW_LEFT);
+    int nbBlock = blockElements(data);
+    int side;
+    if (k <= nbLeft)
+        side = MW_LEFT;
+    else if (k <= nbLeft + nbBlock)
     {
-        // Envoyer au master l'accusé de réception de réussite
-        int ack = MW_ANSWER_EXIST_YES;
-        ret = write(data->workerToMaster[1], &ack, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
+        // c'est un élément du bloc : réponse directe au master
+        int rest = k - nbLeft;
+        int i = 0;
+        while (rest > data->block[i].cardinality)
+        {
+            rest -= data->block[i].cardinality;
+            i++;
+        }
+        DirectAnswer answer = { MW_ANSWER_KTH, reqId, data->block[i].elt, k };
+        writeDirectAnswerToMaster(&answer, data->workerToMaster[1]);
+        return;
+    }
+    else
+    {
+        side = MW_RIGHT;
+        k -= nbLeft + nbBlock;
+    }
 
-        // Envoyer la cardinalité de l'élément courant au master
-        ret = write(data->workerToMaster[1], &(data->cardinality), sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
+    // Envoyer au fils l'ordre kth et le rang dans son sous-arbre
+    int fd = data->child[side].fd;
+    writeHeaderToWorker(MW_ORDER_KTH, reqId, fd);
+    writeToWorker(k, fd);
+    endMessageToWorker(fd);
+}
 
-    }
-    else if (eltToTest < data->elt)
+static void rankAction(Data *data, int reqId)
+{
+    TRACE3("    [worker (%d, %d) {%g}] : ordre rank\n", getpid(), getppid(), blockMin(data));
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    float x = readFloatWorker(data->parentToWorker[0]);
+    int rank = readWorker(data->parentToWorker[0]);
+
+    // seuls les éléments à gauche de x comptent
+    int side = MW_LEFT;
+    if (x > blockMin(data))
     {
-        if (data->leftChildPid == -1)
+        rank += nbElementsOf(data, MW_LEFT);
+        int end = lowerBound(data->block, data->nbEntries, x);
+        for (int i = 0; i < end; i++)
+            rank += data->block[i].cardinality;
+
+        // x dans le bloc : le fils droit n'a que des éléments plus grands
+        if (end < data->nbEntries)
         {
-            // Envoyer au master l'accusé de réception d'échec
-            int ackNoL = MW_ANSWER_EXIST_NO;
-            ret = write(data->workerToMaster[1], &ackNoL, sizeof(int));
-            myassert(ret == sizeof(int), "Erreur");
+            DirectAnswer answer = { MW_ANSWER_RANK, reqId, x, rank };
+            writeDirectAnswerToMaster(&answer, data->workerToMaster[1]);
+            return;
         }
-        else
-        {
-            // Envoyer au worker gauche l'ordre exist
-            writeToWorker(data->workerToLeftChild[1], MW_ORDER_EXIST);
+        side = MW_RIGHT;
+    }
 
-            // Envoyer au worker gauche l'élément à tester
-            writeToWorker(data->workerToLeftChild[1], eltToTest);
+    // fils entièrement d'un côté de x : inutile de descendre
+    const Child *child = &(data->child[side]);
+    if (child->fd != -1 && x > child->summary.min && x <= child->summary.max)
+    {
+        writeHeaderToWorker(MW_ORDER_RANK, reqId, child->fd);
+        writeFloatToWorker(x, child->fd);
+        writeToWorker(rank, child->fd);
+        endMessageToWorker(child->fd);
+        return;
+    }
+    if (child->fd != -1 && x > child->summary.max)
+        rank += child->summary.nbElements;
 
-        }
+    DirectAnswer answer = { MW_ANSWER_RANK, reqId, x, rank };
+    writeDirectAnswerToMaster(&answer, data->workerToMaster[1]);
+}
+
+
+/************************************************************************
+ * Création d'un fils (socket + fork + exec, ou demande à un zygote)
+ ************************************************************************/
+static void createChild(Data *data, int side, float elt, int cardinality)
+{
+    int sv[2];
+    int ret = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    myassert(ret == 0, "Erreur");
+    setCloseOnExec(sv[0], true);
+    setCloseOnExec(sv[1], true);
+
+    // l'anneau est projeté par les deux côtés (le fils reçoit le memfd)
+    int fdRing = data->ring ? fr_ringCreate(sv[0]) : -1;
+
+    if (data->poolOut != -1)
+    {
+        // un zygote crée le fils (cf. MW_ZYGOTE) : ni fork ni exec ici
+        requestWorker(elt, cardinality, sv[1], fdRing, data->poolOut);
     }
-    else // eltToTest > data->elt
+    else
     {
-        if (data->rightChildPid == -1)
-        {
-            // Envoyer au master l'accusé de réception d'échec
-            int ackNoR = MW_ANSWER_EXIST_NO;
-            int ret = write(data->workerToMaster[1], &ackNoR, sizeof(int));
-            myassert(ret == sizeof(int), "Erreur");
-        }
-        else
-        {
-            // Envoyer au worker droit l'ordre exist
-             writeToWorker(data->workerToRightChild[1], MW_ORDER_EXIST);
+        pid_t pid = fork();
+        myassert(pid != -1, "fork n'a pas fonctionné");
 
-            // Envoyer au worker droit l'élément à tester
-             writeToWorker(data->workerToRightChild[1], eltToTest);
+        if (pid == 0)
+        {
+            // même socket pour lire les ordres du père et lui répondre
+            createWorker(elt, cardinality, sv[1], sv[1], data->workerToMaster[1], data->ring, fdRing,
+                         data->poolOut);
+            myassert(false, "Erreur");
         }
     }
+
+    // extrémité utilisée uniquement par le fils
+    ret = close(sv[1]);
+    myassert(ret == 0, "Erreur");
+
+    // forme d'une feuille
+    Child *child = &(data->child[side]);
+    child->fd = sv[0];
+    child->height = 1;
+    child->balance = 0;
+    child->inFlight = 0;
+    child->summary.nbElements = cardinality;
+    child->summary.nbDistinctElements = 1;
+    child->summary.sum = elt * cardinality;
+    child->summary.min = elt;
+    child->summary.max = elt;
 }
 
 
 /************************************************************************
- * Somme
+ * Rotations
+ *
+ * Rotation dans le sens <dir> (MW_RIGHT : le fils gauche remonte) :
+ * le worker courant garde sa place (et donc son père), c'est le contenu
+ * qui circule :
+ * - le worker envoie au fils qui remonte (côté up = !dir) son bloc et
+ *   son sous-arbre côté dir (le descripteur de la socket)
+ * - le fils prend ce bloc, met son ancien sous-arbre côté dir du
+ *   côté up, le sous-arbre reçu côté dir, et renvoie son ancien bloc
+ *   et son ancien sous-arbre côté up
+ * - le worker prend le bloc du fils, le fils passe côté dir et le
+ *   sous-arbre reçu côté up
  ************************************************************************/
-static void sumAction(Data *data)
+// un bloc circule dans un message (il tient dans une trame)
+static void writeBlock(const Data *data, int fd)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre sum\n", getpid(), getppid(), data->elt /*TODO élément*/);
-    myassert(data != NULL, "il faut l'environnement d'exécution");
+    writeToWorker(data->nbEntries, fd);
+    writeEntriesToWorker(data->block, data->nbEntries, fd);
+}
 
-    //TODO
-    // - traiter les cas où les fils n'existent pas
-    // - pour chaque fils
-    //       . envoyer ordre sum (cf. master_worker.h)
-    //       . recevoir accusé de réception (cf. master_worker.h)
-    //       . recevoir résultat (somme du fils) venant du fils
-    // - envoyer l'accusé de réception au père (cf. master_worker.h)
-    // - envoyer le résultat (le cumul des deux quantités + la valeur locale) au père
-    //END TODO
+static void readBlock(ExportEntry *block, int *nbEntries, int fd)
+{
+    *nbEntries = readWorker(fd);
+    myassert(*nbEntries > 0 && *nbEntries <= MW_BLOCK_SIZE, "bloc incorrect");
+    readEntriesWorker(block, *nbEntries, fd);
+}
+
+static void rotate(Data *data, int dir)
+{
+    int up = 1 - dir;
+    int fdUp = data->child[up].fd;
+    myassert(fdUp != -1, "rotation sans fils");
+
+    TRACE3("    [worker (%d, %d) {%g}] : rotation\n", getpid(), getppid(), blockMin(data));
+
+    // envoi au fils du bloc courant et du sous-arbre côté dir
+    writeHeaderToWorker(MW_ORDER_HANDOVER, MW_NO_REQUEST, fdUp);
+    writeToWorker(dir, fdUp);
+    writeBlock(data, fdUp);
+    writeChild(&(data->child[dir]), fdUp);
+    endMessageToWorker(fdUp);
+    if (data->child[dir].fd != -1)
+        closeWorker(data->child[dir].fd);
+
+    // réception de l'ancien bloc du fils et de son sous-arbre côté up
+    expectAnswer(fdUp, MW_ANSWER_HANDOVER);
+    readBlock(data->block, &(data->nbEntries), fdUp);
+    readChild(&(data->child[up]), fdUp);
+
+    // le fils est maintenant du côté dir
+    data->child[dir].fd = fdUp;
+    readShape(&(data->child[dir]), fdUp);
+
+    updateShape(data);
+}
 
-    int ret;
-    int sumLocal = data->elt * data->cardinality;
+// partie "fils" de la rotation décrite ci-dessus
+static void handoverAction(Data *data)
+{
+    int dir = readWorker(data->parentToWorker[0]);
+    int up = 1 - dir;
+
+    ExportEntry parentBlock[MW_BLOCK_SIZE];
+    int parentNbEntries;
+    readBlock(parentBlock, &parentNbEntries, data->parentToWorker[0]);
+    Child parentChild;
+    readChild(&parentChild, data->parentToWorker[0]);
+
+    TRACE3("    [worker (%d, %d) {%g}] : échange avec le père\n", getpid(), getppid(), blockMin(data));
+
+    // renvoi au père de l'ancien bloc et du sous-arbre côté up
+    writeHeaderToWorker(MW_ANSWER_HANDOVER, MW_NO_REQUEST, data->workerToParent[1]);
+    writeBlock(data, data->workerToParent[1]);
+    writeChild(&(data->child[up]), data->workerToParent[1]);
+    int fdGiven = data->child[up].fd;
+
+    // nouvel état
+    memcpy(data->block, parentBlock, parentNbEntries * sizeof(ExportEntry));
+    data->nbEntries = parentNbEntries;
+    data->child[up] = data->child[dir];
+    data->child[dir] = parentChild;
+
+    updateShape(data);
+    writeShape(data, data->workerToParent[1]);
+    endMessageToWorker(data->workerToParent[1]);
+
+    // le descripteur transmis ne part qu'avec la trame
+    if (fdGiven != -1)
+        closeWorker(fdGiven);
+}
 
-    // Traiter les cas où les fils n'existent pas
-    if (data->leftChildPid == -1 && data->rightChildPid == -1)
-    {
-        writeToWorker(data->workerToMaster[1], sumLocal);
+// après une rotation suivant un lot, le worker descendu (côté <side>) peut
+// recevoir un sous-arbre bien plus haut que l'autre : il se rééquilibre
+// à son tour (inutile pour une insertion simple)
+static void rebalanceChild(Data *data, int side)
+{
+    Child *child = &(data->child[side]);
+    if (child->fd == -1 || (child->balance <= 1 && child->balance >= -1))
+        return;
+
+    writeHeaderToWorker(MW_ORDER_REBALANCE, MW_NO_REQUEST, child->fd);
+    endMessageToWorker(child->fd);
+    expectAnswer(child->fd, MW_ANSWER_REBALANCE);
+    readShape(child, child->fd);
+    updateShape(data);
+}
 
-    }
-    // Si le fils gauche existe
-    if (data->leftChildPid != -1)
-    {
-        // Envoyer au worker gauche l'ordre sum
-        writeToWorker(data->leftChildToWorker[1], MW_ORDER_SUM);
+// demande d'une rotation par le père (cas des doubles rotations)
+static void rotateAction(Data *data)
+{
+    int dir = readWorker(data->parentToWorker[0]);
+    rotate(data, dir);
+    rebalanceChild(data, dir);
 
-        // Recevoir l'accusé de réception du worker gauche
-        ret = readWorker(data->leftChildToWorker[0]);
-        myassert(ret == MW_ANSWER_SUM, "Erreur");
+    writeHeaderToWorker(MW_ANSWER_ROTATE, MW_NO_REQUEST, data->workerToParent[1]);
+    writeShape(data, data->workerToParent[1]);
+    endMessageToWorker(data->workerToParent[1]);
+}
 
-        int sumLeft;
-        // Recevoir la somme du fils
-        ret = read(data->leftChildToWorker[0], &sumLeft, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-        sumLocal += sumLeft;
-    }
+// après une modification d'un des sous-arbres ; une insertion simple
+// demande au plus une (double) rotation, un lot peut en demander plusieurs
+static void rebalance(Data *data)
+{
+    myassert(isQuiet(data), "rotation pendant une insertion");
+    updateShape(data);
+    int bf = balance(data);
 
-    // Si le fils droit existe
-    if (data->rightChildPid != -1)
+    while (bf > 1 || bf < -1)
     {
-        // Envoyer au worker gauche l'ordre sum
-        writeToWorker(data->rightChildToWorker[1], MW_ORDER_SUM);
-
-        // Recevoir l'accusé de réception du worker gauche
-        ret = readWorker(data->rightChildToWorker[0]);
-        myassert(ret == MW_ANSWER_SUM, "Erreur");
+        // côté trop haut, et sens de la rotation qui le fait descendre
+        int heavy = (bf > 1) ? MW_LEFT : MW_RIGHT;
+        int dir = 1 - heavy;
+        Child *child = &(data->child[heavy]);
+
+        // cas "zig-zag" : le fils est penché de l'autre côté, il se
+        // retourne d'abord lui-même (double rotation)
+        if ((heavy == MW_LEFT && child->balance < 0) || (heavy == MW_RIGHT && child->balance > 0))
+        {
+            writeHeaderToWorker(MW_ORDER_ROTATE, MW_NO_REQUEST, child->fd);
+            writeToWorker(heavy, child->fd);
+            endMessageToWorker(child->fd);
+            expectAnswer(child->fd, MW_ANSWER_ROTATE);
+            readShape(child, child->fd);
+        }
 
-        // Recevoir la somme du fils
-        int sumRight;
-        ret = read(data->rightChildToWorker[0], &sumRight, sizeof(int));
-        myassert(ret == sizeof(int), "Erreur");
-        sumLocal += sumRight;
+        rotate(data, dir);
+        rebalanceChild(data, dir);
+        bf = balance(data);
     }
+}
 
-    // Envoyer l'accusé de réception au père
-    writeToWorker(data->workerToMaster[1], MW_ANSWER_SUM);
-
-    // Envoyer le résultat au père
-    writeToWorker(data->workerToParent[1], sumLocal);
+static void rebalanceAction(Data *data)
+{
+    TRACE3("    [worker (%d, %d) {%g}] : ordre rebalance\n", getpid(), getppid(), blockMin(data));
+    rebalance(data);
 
+    writeHeaderToWorker(MW_ANSWER_REBALANCE, MW_NO_REQUEST, data->workerToParent[1]);
+    writeShape(data, data->workerToParent[1]);
+    endMessageToWorker(data->workerToParent[1]);
 }
 
 
 /************************************************************************
  * Insertion d'un nouvel élément
  ************************************************************************/
-static void insertAction(Data *data)
+// après une insertion : rotations seulement si plus rien n'est en cours
+// dans les sous-arbres, sinon elles attendent la dernière réponse
+static void settle(Data *data)
+{
+    if (isQuiet(data))
+        rebalance(data);
+    else
+        updateShape(data);
+}
+
+static void writeInsertAnswer(const Data *data, int reqId)
+{
+    writeHeaderToWorker(MW_ANSWER_INSERT, reqId, data->workerToParent[1]);
+    writeShape(data, data->workerToParent[1]);
+    endMessageToWorker(data->workerToParent[1]);
+}
+
+// transmission au fils <side> (qui existe) d'une insertion ; c'est sa
+// réponse qui sera relayée au père (cf. childAnswerAction)
+static void forwardInsert(Data *data, int reqId, int side, float elt, int cardinality)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre insert\n", getpid(), getppid(), data->elt /*TODO élément*/);
+    Child *child = &(data->child[side]);
+    writeHeaderToWorker(MW_ORDER_INSERT, reqId, child->fd);
+    writeFloatToWorker(elt, child->fd);
+    writeToWorker(cardinality, child->fd);
+    endMessageToWorker(child->fd);
+    child->inFlight++;
+
+    // le résumé est complété tout de suite (sauf le nombre d'éléments
+    // distincts, connu à la réponse) : minimum, maximum et existence
+    // restent exacts pour les ordres qui suivent
+    child->summary.nbElements += cardinality;
+    child->summary.sum += elt * cardinality;
+    if (elt < child->summary.min)
+        child->summary.min = elt;
+    if (elt > child->summary.max)
+        child->summary.max = elt;
+    updateShape(data);
+}
+
+// l'élément va dans le sous-arbre <side> : transmis au fils, ou fils créé
+// avec cet élément ; renvoie false si la réponse viendra du fils
+static bool insertInChild(Data *data, int reqId, int side, float elt, int cardinality)
+{
+    if (data->child[side].fd != -1)
+    {
+        forwardInsert(data, reqId, side, elt, cardinality);
+        return false;
+    }
+    createChild(data, side, elt, cardinality);
+    settle(data);
+    return true;
+}
+
+static void insertAction(Data *data, int reqId)
+{
+    TRACE3("    [worker (%d, %d) {%g}] : ordre insert\n", getpid(), getppid(), data->block[0].elt /*TODO élément*/);
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
     //TODO
-    // - recevoir l'élément à insérer en provenance du père
-    // - si élément courant == élément à tester
-    //       . incrémenter la cardinalité courante
-    //       . envoyer au master l'accusé de réception (cf. master_worker.h)
-    // - sinon si (elt à tester < elt courant) et (pas de fils gauche)
-    //       . créer un worker à gauche avec l'élément reçu du client
-    //       . note : c'est ce worker qui enverra l'accusé de réception au master
-    // - sinon si (elt à tester > elt courant) et (pas de fils droit)
-    //       . créer un worker à droite avec l'élément reçu du client
-    //       . note : c'est ce worker qui enverra l'accusé de réception au master
-    // - sinon si (elt à insérer < elt courant)
-    //       . envoyer au worker gauche ordre insert (cf. master_worker.h)
-    //       . envoyer au worker gauche élément à insérer
-    //       . note : c'est un des descendants qui enverra l'accusé de réception au master
-    // - sinon (donc elt à insérer > elt courant)
-    //       . envoyer au worker droit ordre insert (cf. master_worker.h)
-    //       . envoyer au worker droit élément à insérer
-    //       . note : c'est un des descendants qui enverra l'accusé de réception au master
+    // - recevoir l'élément à insérer (et sa cardinalité) en provenance du père
+    // - si élément entre les extrêmes du bloc
+    //       . s'il y est, ajouter la cardinalité
+    //       . sinon l'ajouter au bloc ; un bloc plein cède un extrême au
+    //         fils le moins haut (cf. MW_BLOCK_SIZE)
+    // - sinon si pas de fils du côté de l'élément
+    //       . l'ajouter au bloc s'il reste de la place
+    //       . sinon créer un worker de ce côté avec l'élément reçu
+    // - sinon
+    //       . envoyer au fils ordre insert et élément à insérer (cf. master_worker.h)
+    //       . ne pas attendre sa réponse : cf. childAnswerAction
+    // - mettre à jour le résumé, se rééquilibrer si besoin (rotations)
+    // - envoyer au père l'accusé de réception et la forme du sous-arbre
     //END TODO
 
-    int ret;
-
     // Recevoir l'élément à insérer en provenance du père
-    int elementToInsert;
-    ret = read(data->parentToWorker[0], &elementToInsert, sizeof(int));
-    myassert(ret == sizeof(int), "Erreur");
+    float elementToInsert = readFloatWorker(data->parentToWorker[0]);
+    int cardinality = readWorker(data->parentToWorker[0]);
 
-    // Comparer l'élément à insérer avec l'élément courant
-    if (elementToInsert == data->elt)
+    bool answer = true;
+    if (inBlock(data, elementToInsert))
     {
-        // Incrémenter la cardinalité courante
-        data->cardinality++;
-        // Envoyer au master l'accusé de réception (cf. master_worker.h)
-        writeToWorker(data->workerToParent[1], MW_ANSWER_INSERT);
+        int pos = lowerBound(data->block, data->nbEntries, elementToInsert);
+        if (data->block[pos].elt == elementToInsert)
+            data->block[pos].cardinality += cardinality;
+        else if (data->nbEntries < MW_BLOCK_SIZE)
+            insertEntry(data, pos, elementToInsert, cardinality);
+        else
+        {
+            // bloc plein : un extrême descend du côté le moins haut, où il
+            // devient l'élément le plus proche du bloc
+            int side = (data->child[MW_LEFT].height <= data->child[MW_RIGHT].height) ? MW_LEFT : MW_RIGHT;
+            ExportEntry evicted = removeEntry(data, (side == MW_LEFT) ? 0 : data->nbEntries - 1);
+            if (side == MW_LEFT)
+                pos--;
+            insertEntry(data, pos, elementToInsert, cardinality);
+            answer = insertInChild(data, reqId, side, evicted.elt, evicted.cardinality);
+        }
+        updateShape(data);
     }
-    else if (elementToInsert < data->elt)
+    else
     {
-        // Si pas de fils gauche, créer un worker à gauche avec l'élément reçu du client
-        if (data->leftChildPid == -1)
-        {
-             // Communication avec le fils gauche s'il existe (2 tubes)
-            ret = pipe(data->leftChildToWorker);
-            myassert(ret == 0, "Erreur");
-            ret = pipe(data->workerToLeftChild);
-            myassert(ret == 0, "Erreur");
+        int side = (elementToInsert < blockMin(data)) ? MW_LEFT : MW_RIGHT;
 
-            data->leftChildPid = fork();
-            myassert(data->leftChildPid != -1, "fork n'a pas fonctionné");
-
-            if (data->leftChildPid == 0)
-            {
-                createWorker(elementToInsert, data->workerToLeftChild[0], data->leftChildToWorker[1], data->workerToMaster[1] );
-                myassert(false, "Erreur");
-            }
-        }
-        else
+        if (data->child[side].fd == -1 && data->nbEntries < MW_BLOCK_SIZE)
         {
-            // Envoyer au worker gauche ordre insert (cf. master_worker.h)
-            writeToWorker(MW_ORDER_INSERT, data->leftChildToWorker[1]);
-
-            // Envoyer au worker gauche l'élément à insérer
-            writeToWorker(elementToInsert, data->leftChildToWorker[1]);
+            // pas de fils de ce côté : le bloc s'étend tant qu'il a de la place
+            insertEntry(data, (side == MW_LEFT) ? 0 : data->nbEntries, elementToInsert, cardinality);
+            updateShape(data);
         }
+        else
+            answer = insertInChild(data, reqId, side, elementToInsert, cardinality);
     }
-    else // (elementToInsert > data->elt)
+
+    // Envoyer au père l'accusé de réception (cf. master_worker.h), sauf si
+    // c'est un fils qui répondra
+    if (answer)
+        writeInsertAnswer(data, reqId);
+}
+
+// réponse d'un fils à une insertion transmise par insertAction
+static void childAnswerAction(Data *data, int side)
+{
+    Child *child = &(data->child[side]);
+
+    int reqId;
+    int answer = readHeaderWorker(child->fd, &reqId);
+    myassert(answer == MW_ANSWER_INSERT, "réponse inattendue");
+    readShape(child, child->fd);
+    myassert(child->inFlight > 0, "réponse sans insertion");
+    child->inFlight--;
+
+    TRACE3("    [worker (%d, %d) {%g}] : réponse insert d'un fils\n", getpid(), getppid(), blockMin(data));
+
+    settle(data);
+    writeInsertAnswer(data, reqId);
+}
+
+
+/************************************************************************
+ * Insertion d'un lot d'éléments (triés)
+ ************************************************************************/
+// envoi d'un lot trié au fils <side>, créé si besoin avec la paire médiane ;
+// renvoie false si le fils n'a pas de réponse à envoyer (lot réduit au médian)
+static bool sendBatch(Data *data, int reqId, int side, ExportEntry *entries, int nb)
+{
+    if (data->child[side].fd == -1)
     {
-        // Si pas de fils droit, créer un worker à droite avec l'élément reçu du client
-        if (data->rightChildPid == -1)
-        {
-             // Communication avec le fils droit s'il existe (2 tubes)
-            ret = pipe(data->rightChildToWorker);
-            myassert(ret == 0, "Erreur");
-            ret = pipe(data->workerToRightChild);
-            myassert(ret == 0, "Erreur");
+        int median = nb / 2;
+        createChild(data, side, entries[median].elt, entries[median].cardinality);
+        if (nb == 1)
+            return false;
+
+        // la paire médiane est retirée du lot, qui reste d'un seul tenant
+        // (un seul envoi, sans copie)
+        memmove(entries + median, entries + median + 1, (nb - median - 1) * sizeof(ExportEntry));
+        nb--;
+    }
 
-            data->rightChildPid = fork();
-            myassert(data->rightChildPid != -1, "fork n'a pas fonctionné");
+    int fd = data->child[side].fd;
+    writeHeaderToWorker(MW_ORDER_INSERT_BATCH, reqId, fd);
+    writeToWorker(nb, fd);
+    endEntriesToWorker(entries, nb, fd);
+    return true;
+}
 
-            if (data->rightChildPid == 0)
-            {
-                createWorker(elementToInsert, data->workerToRightChild[0], data->rightChildToWorker[1], data->workerToMaster[1] );
-                myassert(false, "Erreur");
-            }
-        }
+static void insertBatchAction(Data *data, int reqId)
+{
+    TRACE3("    [worker (%d, %d) {%g}] : ordre insert batch\n", getpid(), getppid(), blockMin(data));
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    // le père n'envoie un lot que lorsque plus rien n'est en cours chez nous
+    myassert(isQuiet(data), "lot pendant une insertion");
+
+    // Recevoir le lot (trié, sans doublon) en provenance du père, avec de
+    // la place pour y fusionner le bloc
+    int nb = readWorker(data->parentToWorker[0]);
+    myassert(nb > 0, "lot vide");
+    ExportEntry *entries = malloc((nb + data->nbEntries) * sizeof(ExportEntry));
+    myassert(entries != NULL, "Erreur");
+    readEntriesWorker(entries, nb, data->parentToWorker[0]);
+
+    // découpage : [0, lo[ à gauche, [lo, hi[ entre les extrêmes du bloc,
+    // [hi, nb[ à droite ; le milieu est fusionné avec le bloc, en place
+    int lo = lowerBound(entries, nb, blockMin(data));
+    int hi = upperBound(entries, nb, blockMax(data));
+    memmove(entries + hi + data->nbEntries, entries + hi, (nb - hi) * sizeof(ExportEntry));
+    ExportEntry *middle = malloc((hi - lo + 1) * sizeof(ExportEntry));
+    myassert(middle != NULL, "Erreur");
+    memcpy(middle, entries + lo, (hi - lo) * sizeof(ExportEntry));
+    int i = 0, j = 0, end = lo;
+    while (i < data->nbEntries || j < hi - lo)
+    {
+        if (j == hi - lo || (i < data->nbEntries && data->block[i].elt < middle[j].elt))
+            entries[end++] = data->block[i++];
+        else if (i == data->nbEntries || middle[j].elt < data->block[i].elt)
+            entries[end++] = middle[j++];
         else
         {
-            // Envoyer au worker gauche ordre insert (cf. master_worker.h)
-            writeToWorker(MW_ORDER_INSERT, data->rightChildToWorker[1]);
-
-            // Envoyer au worker gauche l'élément à insérer
-            writeToWorker(elementToInsert, data->rightChildToWorker[1]);
+            entries[end] = data->block[i++];
+            entries[end++].cardinality += middle[j++].cardinality;
         }
     }
+    free(middle);
+    int total = end + nb - hi;
+    memmove(entries + end, entries + hi + data->nbEntries, (nb - hi) * sizeof(ExportEntry));
+
+    // nouveau bloc [first, last[ : le milieu, réduit de part et d'autre s'il
+    // déborde, ou complété par les voisins du côté d'un fils absent
+    int first = lo;
+    int last = end;
+    if (last - first > MW_BLOCK_SIZE)
+    {
+        first += (last - first - MW_BLOCK_SIZE) / 2;
+        last = first + MW_BLOCK_SIZE;
+    }
+    else
+    {
+        int room = MW_BLOCK_SIZE - (last - first);
+        int leftRoom = (data->child[MW_LEFT].fd == -1) ? first : 0;
+        int rightRoom = (data->child[MW_RIGHT].fd == -1) ? total - last : 0;
+        int takeRight = (rightRoom < room / 2) ? rightRoom : room / 2;
+        int takeLeft = (leftRoom < room - takeRight) ? leftRoom : room - takeRight;
+        takeRight = (rightRoom < room - takeLeft) ? rightRoom : room - takeLeft;
+        first -= takeLeft;
+        last += takeRight;
+    }
+    memcpy(data->block, entries + first, (last - first) * sizeof(ExportEntry));
+    data->nbEntries = last - first;
+
+    // les deux fils traitent leur partie en parallèle
+    bool pending[2];
+    pending[MW_LEFT] = (first > 0) && sendBatch(data, reqId, MW_LEFT, entries, first);
+    pending[MW_RIGHT] = (last < total) && sendBatch(data, reqId, MW_RIGHT, entries + last, total - last);
+    free(entries);
+
+    while (pending[MW_LEFT] || pending[MW_RIGHT])
+    {
+        Child *child = &(data->child[gatherAnswer(data, pending, MW_ANSWER_INSERT_BATCH)]);
+        readShape(child, child->fd);
+    }
+
+    rebalance(data);
+
+    // un seul accusé de réception pour tout le lot
+    writeHeaderToWorker(MW_ANSWER_INSERT_BATCH, reqId, data->workerToParent[1]);
+    writeShape(data, data->workerToParent[1]);
+    endMessageToWorker(data->workerToParent[1]);
 }
 
 
 /************************************************************************
- * Affichage
+ * Export trié dans le segment du master (cf. master_worker.h)
  ************************************************************************/
-static void printAction(Data *data)
+static void exportAction(Data *data, int reqId)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre print\n", getpid(), getppid(), data->elt /*TODO élément*/);
+    TRACE3("    [worker (%d, %d) {%g}] : ordre export\n", getpid(), getppid(), blockMin(data));
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    //TODO
-    // - si le fils gauche existe
-    //       . envoyer ordre print (cf. master_worker.h)
-    //       . recevoir accusé de réception (cf. master_worker.h)
-    // - afficher l'élément courant avec sa cardinalité
-    // - si le fils droit existe
-    //       . envoyer ordre print (cf. master_worker.h)
-    //       . recevoir accusé de réception (cf. master_worker.h)
-    // - envoyer l'accusé de réception au père (cf. master_worker.h)
-    //END TODO
+    // le nombre d'éléments distincts des fils doit être exact
+    myassert(isQuiet(data), "export pendant une insertion");
 
-    int ret;
+    pid_t masterPid = readWorker(data->parentToWorker[0]);
+    int start = readWorker(data->parentToWorker[0]);
+    int nb = readWorker(data->parentToWorker[0]);
 
-    // Si le fils gauche existe
-    if (data->leftChildPid != -1)
+    // chaque fils remplit sa partie pendant qu'on écrit notre bloc
+    const Child *left = &(data->child[MW_LEFT]);
+    int pos = start + ((left->fd == -1) ? 0 : left->summary.nbDistinctElements);
+    int childStart[2] = { start, pos + data->nbEntries };
+    bool pending[2];
+    for (int side = MW_LEFT; side <= MW_RIGHT; side++)
     {
-        // Envoyer ordre print au fils gauche
-        writeToWorker(MW_ORDER_PRINT, data->workerToLeftChild[1]);
-
-        // Recevoir accusé de réception du fils gauche
-        ret = readWorker(data->leftChildToWorker[0]);
-        myassert(ret == sizeof(int), "Erreur");
+        int fd = data->child[side].fd;
+        pending[side] = (fd != -1);
+        if (fd == -1)
+            continue;
+        writeHeaderToWorker(MW_ORDER_EXPORT, reqId, fd);
+        writeToWorker(masterPid, fd);
+        writeToWorker(childStart[side], fd);
+        writeToWorker(nb, fd);
+        endMessageToWorker(fd);
     }
+    fr_flushAll();
 
-    // Afficher l'élément courant avec sa cardinalité
-    printf("Element: %g, Cardinality: %d\n", data->elt, data->cardinality);
+    ExportEntry *entries = exportOpen(masterPid, nb);
+    myassert(pos + data->nbEntries <= nb, "segment d'export trop petit");
+    memcpy(entries + pos, data->block, data->nbEntries * sizeof(ExportEntry));
+    exportClose(entries, nb);
 
-    // Si le fils droit existe
-    if (data->rightChildPid != -1)
+    while (pending[MW_LEFT] || pending[MW_RIGHT])
+        gatherAnswer(data, pending, MW_ANSWER_EXPORT);
+
+    writeHeaderToWorker(MW_ANSWER_EXPORT, reqId, data->workerToParent[1]);
+    endMessageToWorker(data->workerToParent[1]);
+}
+
+
+/************************************************************************
+ * Parcours borné à partir d'un élément (cf. master_worker.h)
+ ************************************************************************/
+// au plus <limit> paires > after du fils <side>, rangées dans <entries> ;
+// renvoie leur nombre
+static int scanChild(Data *data, int side, int reqId, float after, int limit, ExportEntry *entries)
+{
+    const Child *child = &(data->child[side]);
+    if (child->fd == -1 || child->summary.max <= after)
+        return 0;
+
+    writeHeaderToWorker(MW_ORDER_SCAN, reqId, child->fd);
+    writeFloatToWorker(after, child->fd);
+    writeToWorker(limit, child->fd);
+    endMessageToWorker(child->fd);
+
+    expectAnswer(child->fd, MW_ANSWER_SCAN);
+    int nb = readWorker(child->fd);
+    myassert(nb <= limit, "page trop grande");
+    readEntriesWorker(entries, nb, child->fd);
+    return nb;
+}
+
+static void scanAction(Data *data, int reqId)
+{
+    TRACE3("    [worker (%d, %d) {%g}] : ordre scan\n", getpid(), getppid(), blockMin(data));
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+    myassert(isQuiet(data), "parcours pendant une insertion");
+
+    float after = readFloatWorker(data->parentToWorker[0]);
+    int limit = readWorker(data->parentToWorker[0]);
+    // vérifiée par le master (cf. orderScan)
+    myassert(limit > 0, "page vide");
+
+    ExportEntry *entries = malloc(limit * sizeof(ExportEntry));
+    myassert(entries != NULL, "Erreur");
+    int nb = 0;
+
+    // parcours infixe, arrêté dès que la page est pleine
+    if (blockMin(data) > after)
+        nb = scanChild(data, MW_LEFT, reqId, after, limit, entries);
+    for (int i = upperBound(data->block, data->nbEntries, after); i < data->nbEntries && nb < limit; i++)
+        entries[nb++] = data->block[i];
+    if (nb < limit)
+        nb += scanChild(data, MW_RIGHT, reqId, after, limit - nb, entries + nb);
+
+    writeHeaderToWorker(MW_ANSWER_SCAN, reqId, data->workerToParent[1]);
+    writeToWorker(nb, data->workerToParent[1]);
+    endEntriesToWorker(entries, nb, data->workerToParent[1]);
+    free(entries);
+}
+
+
+/************************************************************************
+ * Construction équilibrée à partir d'un instantané (cf. master_worker.h)
+ ************************************************************************/
+static void loadAction(Data *data, int reqId)
+{
+    TRACE3("    [worker (%d, %d) {%g}] : ordre load\n", getpid(), getppid(), blockMin(data));
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    char path[SN_PATH_SIZE];
+    readStringWorker(path, SN_PATH_SIZE, data->parentToWorker[0]);
+    int lo = readWorker(data->parentToWorker[0]);
+    int hi = readWorker(data->parentToWorker[0]);
+
+    const SnapshotHeader *snapshot = sn_map(path);
+    myassert(snapshot != NULL, "instantané absent ou invalide");
+    const ExportEntry *entries = sn_entries(snapshot);
+
+    // notre élément est au milieu de la tranche, notre bloc l'entoure
+    int mid = lo + (hi - lo) / 2;
+    myassert(entries[mid].elt == blockMin(data), "tranche incohérente");
+    int first = (mid - MW_BLOCK_SIZE / 2 > lo) ? mid - MW_BLOCK_SIZE / 2 : lo;
+    int last = first + MW_BLOCK_SIZE;
+    if (last > hi)
     {
-        // Envoyer ordre print au fils droit
-        writeToWorker(MW_ORDER_PRINT, data->workerToRightChild[1]);
+        last = hi;
+        first = (hi - MW_BLOCK_SIZE > lo) ? hi - MW_BLOCK_SIZE : lo;
+    }
+    memcpy(data->block, entries + first, (last - first) * sizeof(ExportEntry));
+    data->nbEntries = last - first;
+
+    // chaque fils part du milieu de son reste de tranche ; il commence à
+    // construire pendant qu'on crée l'autre
+    int slice[2][2] = { { lo, first }, { last, hi } };
+    bool pending[2];
+    for (int side = MW_LEFT; side <= MW_RIGHT; side++)
+    {
+        int childLo = slice[side][0];
+        int childHi = slice[side][1];
+        pending[side] = (childLo < childHi);
+        if (childLo >= childHi)
+            continue;
+        myassert(data->child[side].fd == -1, "chargement dans un arbre non vide");
+        const ExportEntry *childMid = &(entries[childLo + (childHi - childLo) / 2]);
+        createChild(data, side, childMid->elt, childMid->cardinality);
+
+        int fd = data->child[side].fd;
+        writeHeaderToWorker(MW_ORDER_LOAD, reqId, fd);
+        writeStringToWorker(path, fd);
+        writeToWorker(childLo, fd);
+        writeToWorker(childHi, fd);
+        endMessageToWorker(fd);
+        fr_flush(fd);
+    }
+    sn_unmap(snapshot);
 
-        // Recevoir accusé de réception du fils droit
-        ret = readWorker(data->rightChildToWorker[0]);
-        myassert(ret == sizeof(int), "Erreur");
+    while (pending[MW_LEFT] || pending[MW_RIGHT])
+    {
+        Child *child = &(data->child[gatherAnswer(data, pending, MW_ANSWER_LOAD)]);
+        readShape(child, child->fd);
     }
+    updateShape(data);
 
-    // Envoyer l'accusé de réception au père
-    writeToWorker(MW_ANSWER_PRINT, data->workerToMaster[1]);
+    writeHeaderToWorker(MW_ANSWER_LOAD, reqId, data->workerToParent[1]);
+    writeShape(data, data->workerToParent[1]);
+    endMessageToWorker(data->workerToParent[1]);
+}
+
+
+/************************************************************************
+ * Profondeur (hauteur du sous-arbre, connue localement)
+ ************************************************************************/
+static void depthAction(Data *data, int reqId)
+{
+    TRACE3("    [worker (%d, %d) {%g}] : ordre depth\n", getpid(), getppid(), blockMin(data));
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    writeHeaderToWorker(MW_ANSWER_DEPTH, reqId, data->workerToParent[1]);
+    writeToWorker(data->height, data->workerToParent[1]);
+    endMessageToWorker(data->workerToParent[1]);
 }
 
 
 /************************************************************************
  * Boucle principale de traitement
  ************************************************************************/
+// traitement d'un ordre du père ; renvoie true pour l'ordre de fin
+static bool orderAction(Data *data)
+{
+    int reqId;
+    int order = readHeaderWorker(data->parentToWorker[0], &reqId) ;  //TODO pour que ça ne boucle pas, mais recevoir l'ordre du père
+    myassert(order != -1, "clientToMaster n'est pas lu");
+
+    switch(order)
+    {
+      case MW_ORDER_STOP:
+        stopAction(data);
+        return true;
+      case MW_ORDER_HOW_MANY:
+        howManyAction(data, reqId);
+        break;
+      case MW_ORDER_MINIMUM:
+        minimumAction(data, reqId);
+        break;
+      case MW_ORDER_MAXIMUM:
+        maximumAction(data, reqId);
+        break;
+      case MW_ORDER_EXIST:
+        existAction(data, reqId);
+        break;
+      case MW_ORDER_SUM:
+        sumAction(data, reqId);
+        break;
+      case MW_ORDER_RANGE_COUNT:
+      case MW_ORDER_RANGE_SUM:
+        rangeAction(data, order, reqId);
+        break;
+      case MW_ORDER_KTH:
+        kthAction(data, reqId);
+        break;
+      case MW_ORDER_RANK:
+        rankAction(data, reqId);
+        break;
+      case MW_ORDER_INSERT:
+        insertAction(data, reqId);
+        break;
+      case MW_ORDER_INSERT_BATCH:
+        insertBatchAction(data, reqId);
+        break;
+      case MW_ORDER_DEPTH:
+        depthAction(data, reqId);
+        break;
+      case MW_ORDER_EXPORT:
+        exportAction(data, reqId);
+        break;
+      case MW_ORDER_SCAN:
+        scanAction(data, reqId);
+        break;
+      case MW_ORDER_LOAD:
+        loadAction(data, reqId);
+        break;
+      case MW_ORDER_ROTATE:
+        rotateAction(data);
+        break;
+      case MW_ORDER_HANDOVER:
+        handoverAction(data);
+        break;
+      case MW_ORDER_REBALANCE:
+        rebalanceAction(data);
+        break;
+      default:
+        myassert(false, "ordre inconnu");
+        exit(EXIT_FAILURE);
+        break;
+    }
+    return false;
+}
+
+// on écoute le père et les fils qui ont des insertions en cours ; les
+// réponses des fils passent en premier pour libérer les rotations
+// Les trames déjà reçues (tampons de frame.h) sont traitées avant d'attendre :
+// poll ne les signale pas. On n'attend qu'après avoir tout envoyé.
 void loop(Data *data)
 {
     bool end = false;
 
     while (! end)
     {
-        int order = readWorker(data->parentToWorker[0]) ;  //TODO pour que ça ne boucle pas, mais recevoir l'ordre du père
-        myassert(order != -1, "clientToMaster n'est pas lu");
+        struct pollfd fds[3];
+        fds[0].fd = data->parentToWorker[0];
+        for (int side = MW_LEFT; side <= MW_RIGHT; side++)
+        {
+            const Child *child = &(data->child[side]);
+            fds[1 + side].fd = (child->inFlight > 0) ? child->fd : -1;
+        }
+        bool ready = false;
+        for (int i = 0; i < 3; i++)
+        {
+            fds[i].events = POLLIN;
+            fds[i].revents = fr_hasData(fds[i].fd) ? POLLIN : 0;
+            ready = ready || (fds[i].revents != 0);
+        }
 
-        switch(order)
+        if (! ready)
         {
-          case MW_ORDER_STOP:
-            stopAction(data);
-            end = true;
-            break;
-          case MW_ORDER_HOW_MANY:
-            howManyAction(data);
-            break;
-          case MW_ORDER_MINIMUM:
-            minimumAction(data);
-            break;
-          case MW_ORDER_MAXIMUM:
-            maximumAction(data);
-            break;
-          case MW_ORDER_EXIST:
-            existAction(data);
-            break;
-          case MW_ORDER_SUM:
-            sumAction(data);
-            break;
-          case MW_ORDER_INSERT:
-            insertAction(data);
-            break;
-          case MW_ORDER_PRINT:
-            printAction(data);
-            break;
-          default:
-            myassert(false, "ordre inconnu");
-            exit(EXIT_FAILURE);
-            break;
+            fr_flushAll();
+            for (int i = 0; i < 3; i++)
+                ready = ready || ! fr_sleep(fds[i].fd);
+        }
+        if (! ready)
+        {
+            int ret = poll(fds, 3, -1);
+            myassert(ret > 0, "Erreur");
+
+            // un anneau peut réveiller sans trame (cf. frame.h)
+            for (int i = 0; i < 3; i++)
+                if (fds[i].revents != 0 && ! fr_ready(fds[i].fd))
+                    fds[i].revents = 0;
         }
 
-        TRACE3("    [worker (%d, %d) {%g}] : fin ordre\n", getpid(), getppid(), data->elt /*TODO élément*/);
+        for (int side = MW_LEFT; side <= MW_RIGHT; side++)
+            if (fds[1 + side].revents != 0)
+                childAnswerAction(data, side);
+
+        if (fds[0].revents != 0)
+        {
+            end = orderAction(data);
+            TRACE3("    [worker (%d, %d) {%g}] : fin ordre\n", getpid(), getppid(), data->block[0].elt /*TODO élément*/);
+        }
     }
 }
 
@@ -645,62 +1500,96 @@ void loop(Data *data)
 /************************************************************************
  * Programme principal
  ************************************************************************/
+static void closeIfOpen(int fd)
+{
+    if (fd != -1)
+        closeWorker(fd);
+}
 
-int main(int argc, char * argv[])
+// vie d'un worker, une fois initialisé
+static void run(Data *data)
 {
-    Data data;
-    parseArgs(argc, argv, &data);
-    TRACE3("    [worker (%d, %d) {%g}] : début worker\n", getpid(), getppid(), data.elt /*TODO élément*/);
+    TRACE3("    [worker (%d, %d) {%g}] : début worker\n", getpid(), getppid(), data->block[0].elt /*TODO élément*/);
 
-    //TODO envoyer au master l'accusé de réception d'insertion (cf. master_worker.h)
-    //TODO note : en effet si je suis créé c'est qu'on vient d'insérer un élément : moi
+    // note : pas d'accusé de réception d'insertion ici, c'est le père qui
+    // le renvoie (avec la forme de son sous-arbre) une fois le fils créé
 
-    int ret;
+    loop(data);
 
-    int ack = MW_ANSWER_INSERT;
-    ret = write(data.workerToMaster[1], &ack, sizeof(int));
-    myassert(ret == sizeof(int), "Erreur");
+    //TODO fermer les tubes
+    closeIfOpen(data->parentToWorker[0]);
+    if (data->workerToParent[1] != data->parentToWorker[0])
+        closeIfOpen(data->workerToParent[1]);
+    closeIfOpen(data->workerToMaster[1]);
+    closeIfOpen(data->poolOut);
+
+    // les processus fils (qui ne sont plus forcément nos fils dans l'arbre)
+    // ont tous reçu l'ordre de fin : on attend qu'ils se terminent
+    while (wait(NULL) != -1)
+        ;
+    myassert(errno == ECHILD, "Erreur");
+
+    TRACE3("    [worker (%d, %d) {%g}] : fin worker\n", getpid(), getppid(), blockMin(data));
+}
 
+// zygote (cf. MW_ZYGOTE) : un fork par demande de fils ; le fils, déjà
+// chargé, s'initialise avec la socket reçue au lieu d'un exec
+static void zygote(int argc, char * argv[])
+{
+    if (argc != 6)
+        usage(argv[0], "Nombre d'arguments incorrect");
+    int poolIn = atoi(argv[2]);
+    int poolOut = atoi(argv[3]);
+    int fdToMaster = atoi(argv[4]);
+    bool ring = parseTransport(argv[0], argv[5]);
+    setCloseOnExec(poolIn, true);
+    setCloseOnExec(poolOut, true);
+    setCloseOnExec(fdToMaster, true);
 
-    loop(&data);
+    float elt;
+    int cardinality, fd, fdRing;
+    while (receiveWorkerRequest(poolIn, &elt, &cardinality, &fd, &fdRing))
+    {
+        pid_t pid = fork();
+        myassert(pid != -1, "fork n'a pas fonctionné");
+        if (pid == 0)
+        {
+            int ret = close(poolIn);
+            myassert(ret == 0, "Erreur");
 
-    //TODO fermer les tubes
-    ret = close(data.parentToWorker[0]);
-    myassert(ret == 0, "tuben'est pas fermé");
-    ret = close(data.parentToWorker[1]);
-    myassert(ret == 0, "tuben'est pas fermé");
-
-    ret = close(data.workerToParent[0]);
-    myassert(ret == 0, "tuben'est pas fermé");
-    ret = close(data.workerToParent[1]);
-    myassert(ret == 0, "tuben'est pas fermé");
-
-    ret = close(data.workerToMaster[0]);
-    myassert(ret == 0, "tuben'est pas fermé");
-    ret = close(data.workerToMaster[1]);
-    myassert(ret == 0, "tuben'est pas fermé");
-
-    ret = close(data.leftChildToWorker[0]);
-    myassert(ret == 0, "tuben'est pas fermé");
-    ret = close(data.leftChildToWorker[1]);
-    myassert(ret == 0, "tuben'est pas fermé");
-
-    ret = close(data.workerToLeftChild[0]);
-    myassert(ret == 0, "tuben'est pas fermé");
-    ret = close(data.workerToLeftChild[1]);
-    myassert(ret == 0, "tuben'est pas fermé");
-
-    ret = close(data.rightChildToWorker[0]);
-    myassert(ret == 0, "tuben'est pas fermé");
-    ret = close(data.rightChildToWorker[1]);
-    myassert(ret == 0, "tuben'est pas fermé");
-
-    close(data.workerToRightChild[0]);
-    myassert(ret == 0, "tuben'est pas fermé");
-    close(data.workerToRightChild[1]);
-    myassert(ret == 0, "tuben'est pas fermé");
-
-
-    TRACE3("    [worker (%d, %d) {%g}] : fin worker\n", getpid(), getppid(), 3.14 /*TODO élément*/);
+            // même socket pour lire les ordres du père et lui répondre
+            Data data;
+            initData(&data, elt, cardinality, fd, fd, fdToMaster, ring, fdRing, poolOut);
+            run(&data);
+            exit(EXIT_SUCCESS);
+        }
+
+        // ces descripteurs sont au fils
+        int ret = close(fd);
+        myassert(ret == 0, "Erreur");
+        if (fdRing != -1)
+        {
+            ret = close(fdRing);
+            myassert(ret == 0, "Erreur");
+        }
+    }
+
+    closeIfOpen(poolIn);
+    closeIfOpen(poolOut);
+    closeIfOpen(fdToMaster);
+    while (wait(NULL) != -1)
+        ;
+    myassert(errno == ECHILD, "Erreur");
+    exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc > 1 && strcmp(argv[1], MW_ZYGOTE) == 0)
+        zygote(argc, argv);
+
+    Data data;
+    parseArgs(argc, argv, &data);
+    run(&data);
     return EXIT_SUCCESS;
 }